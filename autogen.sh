@@ -102,6 +102,7 @@ echo ""
 echo "    - openssl / libressl"
 echo "    - libevent"
 echo "    - libcurl"
+echo "    - zlib"
 echo "    - libmaxminddb"
 echo ""
 echo "If any of these dependencies is missing, the './configure' script"
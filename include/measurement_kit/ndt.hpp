@@ -12,7 +12,7 @@
 #define MK_NDT_SIMPLE_FIREWALL 8
 #define MK_NDT_STATUS 16
 #define MK_NDT_META 32
-#define MK_NDT_UPLOAD_EXT 64 // not implemented
+#define MK_NDT_UPLOAD_EXT 64
 #define MK_NDT_DOWNLOAD_EXT 128
 
 #endif
@@ -71,6 +71,36 @@ AC_DEFUN([MK_AM_LIBCURL], [
   fi
 ])
 
+AC_DEFUN([MK_AM_ZLIB], [
+  mk_not_needed=0
+  AC_ARG_WITH([zlib],
+              [AS_HELP_STRING([--with-zlib],
+                [zlib compression library @<:@default=check@:>@])
+              ],
+              [
+                if test "$withval" != "no"; then
+                  CPPFLAGS="$CPPFLAGS -I$withval/include"
+                  LDFLAGS="$LDFLAGS -L$withval/lib"
+                else
+                  mk_not_needed=1
+                fi
+              ],
+              [])
+  if test $mk_not_needed -eq 0; then
+    mk_not_found=""
+    AC_CHECK_HEADERS(zlib.h, [], [mk_not_found=1])
+    AC_CHECK_LIB(z, inflateInit2_, [], [mk_not_found=1])
+    if test "$mk_not_found" = "1"; then
+      AC_MSG_WARN([Failed to find dependency: zlib])
+      echo "    - to install on Debian: sudo apt-get install zlib1g-dev"
+      echo "    - to install on OSX: zlib is already installed"
+      AC_MSG_ERROR([Please, install zlib and run configure again])
+    fi
+  else
+    CPPFLAGS="$CPPFLAGS -DMK_WITHOUT_ZLIB"
+  fi
+])
+
 AC_DEFUN([MK_AM_LIBMAXMINDDB], [
   AC_ARG_WITH([libmaxminddb],
               [AS_HELP_STRING([--with-libmaxminddb],
@@ -0,0 +1,118 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/connection_governor.hpp"
+
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mk {
+
+ConnectionGovernor::Priority
+ConnectionGovernor::priority_from_string(const std::string &s) {
+    return (s == "control") ? Priority::control : Priority::measurement;
+}
+
+SharedPtr<ConnectionGovernor> ConnectionGovernor::make() {
+    return SharedPtr<ConnectionGovernor>{new ConnectionGovernor};
+}
+
+void ConnectionGovernor::Slot::connected() {
+    if (is_open) {
+        return;
+    }
+    is_open = true;
+    // We are no longer connecting, which may let someone else connect
+    {
+        std::unique_lock<std::mutex> _{governor->mutex_};
+        governor->stats_.connecting -= 1;
+        governor->stats_.open += 1;
+    }
+    governor->dispatch_();
+}
+
+ConnectionGovernor::Slot::~Slot() {
+    {
+        std::unique_lock<std::mutex> _{governor->mutex_};
+        if (is_open) {
+            governor->stats_.open -= 1;
+        } else {
+            governor->stats_.connecting -= 1;
+        }
+    }
+    governor->dispatch_();
+}
+
+void ConnectionGovernor::set_limits(size_t max_connecting, size_t max_open) {
+    {
+        std::unique_lock<std::mutex> _{mutex_};
+        max_connecting_ = max_connecting;
+        max_open_ = max_open;
+    }
+    dispatch_(); // Higher limits may let queued requests go
+}
+
+bool ConnectionGovernor::can_connect_() const {
+    return (max_connecting_ == 0 || stats_.connecting < max_connecting_) &&
+           (max_open_ == 0 || stats_.connecting + stats_.open < max_open_);
+}
+
+void ConnectionGovernor::acquire(Priority priority, SharedPtr<Reactor> reactor,
+                                 Callback<SharedPtr<Slot>> &&cb) {
+    {
+        std::unique_lock<std::mutex> _{mutex_};
+        bool queue_empty = queues_[0].empty() && queues_[1].empty();
+        if (!queue_empty || !can_connect_()) {
+            Waiter waiter;
+            waiter.reactor = reactor;
+            waiter.callback = std::move(cb);
+            waiter.since = time_now();
+            queues_[(int)priority].push_back(std::move(waiter));
+            stats_.queued += 1;
+            return;
+        }
+        stats_.connecting += 1;
+        stats_.granted += 1;
+    }
+    cb(SharedPtr<Slot>{new Slot(shared_from_this())});
+}
+
+void ConnectionGovernor::dispatch_() {
+    std::vector<Waiter> ready;
+    {
+        std::unique_lock<std::mutex> _{mutex_};
+        double now = time_now();
+        for (auto &queue : queues_) {
+            while (!queue.empty() && can_connect_()) {
+                Waiter waiter = std::move(queue.front());
+                queue.pop_front();
+                double wait = now - waiter.since;
+                stats_.queued -= 1;
+                stats_.connecting += 1;
+                stats_.granted += 1;
+                stats_.waited += 1;
+                stats_.total_wait += wait;
+                stats_.max_wait = std::max(stats_.max_wait, wait);
+                ready.push_back(std::move(waiter));
+            }
+        }
+    }
+    // Call back from the reactor, since we may be inside a destructor
+    for (auto &waiter : ready) {
+        SharedPtr<Slot> slot{new Slot(shared_from_this())};
+        auto callback = std::move(waiter.callback);
+        waiter.reactor->call_soon([callback, slot]() { callback(slot); });
+    }
+}
+
+ConnectionGovernor::Stats ConnectionGovernor::stats() {
+    std::unique_lock<std::mutex> _{mutex_};
+    return stats_;
+}
+
+} // namespace mk
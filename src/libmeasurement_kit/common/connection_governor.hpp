@@ -0,0 +1,105 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_CONNECTION_GOVERNOR_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_CONNECTION_GOVERNOR_HPP
+
+#include "src/libmeasurement_kit/common/callback.hpp"
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include <stdint.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace mk {
+
+class Reactor;
+
+/*
+ * Limits the connections opened by all the code running on a reactor, i.e.
+ * by all the measurements of the tests using it, so that their combined
+ * fan-out cannot exhaust file descriptors or the NAT table of the router.
+ *
+ * Who connects first acquires a slot, which counts as connecting until the
+ * connect completes and as open afterwards, until it is destroyed. When a
+ * limit is reached, requests wait in a queue, where control plane requests
+ * (bouncer, collector, test helpers) go before measurements. A zero limit
+ * means no limit, which is the default.
+ */
+class ConnectionGovernor : public NonCopyable,
+                           public NonMovable,
+                           public EnableSharedFromThis<ConnectionGovernor> {
+  public:
+    enum class Priority { control = 0, measurement = 1 };
+
+    // Parses the `net/connect_priority` setting, which may be "control"
+    // or "measurement" (the default)
+    static Priority priority_from_string(const std::string &s);
+
+    class Slot : public NonCopyable, public NonMovable {
+      public:
+        // Tells the governor that the connect succeeded, so that the slot
+        // counts as an open socket until it is destroyed
+        void connected();
+
+        ~Slot();
+
+      private:
+        friend class ConnectionGovernor;
+        explicit Slot(SharedPtr<ConnectionGovernor> g) : governor{g} {}
+
+        SharedPtr<ConnectionGovernor> governor;
+        bool is_open = false;
+    };
+
+    class Stats {
+      public:
+        size_t connecting = 0;
+        size_t open = 0;
+        size_t queued = 0;
+        uint64_t granted = 0;
+        uint64_t waited = 0;     /* Granted after waiting in the queue */
+        double total_wait = 0.0; /* Seconds spent in the queue overall */
+        double max_wait = 0.0;
+    };
+
+    static SharedPtr<ConnectionGovernor> make();
+
+    void set_limits(size_t max_connecting, size_t max_open);
+
+    // Calls `cb` with a slot as soon as the limits allow, i.e. immediately
+    // or later, from `reactor`, when another slot is released
+    void acquire(Priority priority, SharedPtr<Reactor> reactor,
+                 Callback<SharedPtr<Slot>> &&cb);
+
+    Stats stats();
+
+  private:
+    class Waiter {
+      public:
+        SharedPtr<Reactor> reactor;
+        Callback<SharedPtr<Slot>> callback;
+        double since = 0.0;
+    };
+
+    ConnectionGovernor() {}
+
+    // Must be called with the mutex held
+    bool can_connect_() const;
+
+    // Grants slots to the queued requests that the limits allow
+    void dispatch_();
+
+    std::mutex mutex_;
+    size_t max_connecting_ = 0;
+    size_t max_open_ = 0;
+    std::deque<Waiter> queues_[2]; /* Indexed by priority */
+    Stats stats_;
+};
+
+} // namespace mk
+#endif
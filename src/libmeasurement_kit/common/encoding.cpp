@@ -4,19 +4,101 @@
 
 #include "src/libmeasurement_kit/common/encoding.hpp"
 
-#include "measurement_kit/internal/vendor/mkdata.hpp"
+#include <stdint.h>
+#include <string.h>
 
 namespace mk {
 
+static constexpr uint64_t high_bits = 0x8080808080808080ULL;
+
+// Tells whether the eight bytes at `p` are all ASCII, testing them at
+// once rather than one at a time (SWAR)
+static bool eight_ascii_bytes(const uint8_t *p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return (word & high_bits) == 0;
+}
+
+// Validates as in RFC3629 Sect. 4, hence rejecting overlong sequences,
+// surrogates, and code points above U+10FFFF, like the DFA in mkdata, but
+// running on runs of ASCII bytes, which are most of the bytes in a page,
+// eight bytes at a time. Like the DFA, it accepts NUL bytes, so that bodies
+// containing them are still reported as strings rather than as base64.
 Error utf8_parse(const std::string &str) {
-  if (!mk::data::contains_valid_utf8(str)) {
-    return IllegalSequenceError();
+  const uint8_t *p = (const uint8_t *)str.data();
+  const uint8_t *end = p + str.size();
+  while (p < end) {
+    if (end - p >= 8 && eight_ascii_bytes(p)) {
+      p += 8;
+      continue;
+    }
+    uint8_t c = *p;
+    if (c < 0x80) {
+      p += 1;
+      continue;
+    }
+    size_t len = 0;
+    uint8_t lo = 0x80, hi = 0xbf; // Range of the second byte
+    if (c >= 0xc2 && c <= 0xdf) {
+      len = 2;
+    } else if (c == 0xe0) {
+      len = 3, lo = 0xa0;
+    } else if (c == 0xed) {
+      len = 3, hi = 0x9f;
+    } else if (c >= 0xe1 && c <= 0xef) {
+      len = 3;
+    } else if (c == 0xf0) {
+      len = 4, lo = 0x90;
+    } else if (c == 0xf4) {
+      len = 4, hi = 0x8f;
+    } else if (c >= 0xf1 && c <= 0xf3) {
+      len = 4;
+    } else {
+      return IllegalSequenceError();
+    }
+    for (size_t i = 1; i < len; ++i) {
+      if (p + i >= end) {
+        return IncompleteUtf8SequenceError();
+      }
+      if (p[i] < lo || p[i] > hi) {
+        return IllegalSequenceError();
+      }
+      lo = 0x80, hi = 0xbf;
+    }
+    p += len;
   }
   return NoError();
 }
 
 std::string base64_encode(std::string str) {
-  return mk::data::base64_encode(std::move(str));
+  static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                              "abcdefghijklmnopqrstuvwxyz"
+                              "0123456789+/";
+  const uint8_t *in = (const uint8_t *)str.data();
+  size_t len = str.size();
+  // Write into a buffer sized once, rather than appending char by char
+  std::string out((len + 2) / 3 * 4, '=');
+  char *o = &out[0];
+  size_t i = 0;
+  for (; i + 3 <= len; i += 3, o += 4) {
+    uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+    o[0] = table[(v >> 18) & 0x3f];
+    o[1] = table[(v >> 12) & 0x3f];
+    o[2] = table[(v >> 6) & 0x3f];
+    o[3] = table[v & 0x3f];
+  }
+  if (i < len) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len) {
+      v |= (uint32_t)in[i + 1] << 8;
+    }
+    o[0] = table[(v >> 18) & 0x3f];
+    o[1] = table[(v >> 12) & 0x3f];
+    if (i + 1 < len) {
+      o[2] = table[(v >> 6) & 0x3f];
+    }
+  }
+  return out;
 }
 
 std::string base64_encode_if_needed(std::string str) {
@@ -0,0 +1,236 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/file_writer.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <streambuf>
+#include <vector>
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mk {
+
+#ifdef _WIN32
+#define MK_FW_OPEN(path_, append_)                                             \
+    ::_open(path_, _O_WRONLY | _O_CREAT | _O_BINARY |                          \
+                       ((append_) ? _O_APPEND : _O_TRUNC),                     \
+            _S_IREAD | _S_IWRITE)
+#define MK_FW_WRITE(fd_, base_, count_) ::_write(fd_, base_, (unsigned)count_)
+#define MK_FW_FSYNC(fd_) ::_commit(fd_)
+#define MK_FW_CLOSE(fd_) ::_close(fd_)
+#else
+#define MK_FW_OPEN(path_, append_)                                             \
+    ::open(path_, O_WRONLY | O_CREAT | ((append_) ? O_APPEND : O_TRUNC), 0644)
+#define MK_FW_WRITE(fd_, base_, count_) ::write(fd_, base_, count_)
+#define MK_FW_FSYNC(fd_) ::fsync(fd_)
+#define MK_FW_CLOSE(fd_) ::close(fd_)
+#endif
+
+// Stream buffer writing into a file descriptor only when it is full or
+// when it is explicitly synced, unlike std::endl which syncs every line.
+class FileWriter::Buffer : public std::streambuf {
+  public:
+    int fd = -1;
+
+    Buffer() : data_(65536) { reset_(); }
+
+    ~Buffer() override { set_gzip(false); }
+
+    bool drain() {
+        const char *base = pbase();
+        size_t count = (size_t)(pptr() - pbase());
+        reset_();
+        return emit_(base, count);
+    }
+
+    Error set_gzip(bool enable) {
+#ifndef MK_WITHOUT_ZLIB
+        if (gzip_) {
+            deflateEnd(&stream_);
+            gzip_ = false;
+        }
+        if (enable) {
+            stream_ = z_stream{};
+            // Adding 16 to the window bits selects the gzip format
+            if (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                             MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return GenericError();
+            }
+            gzip_ = true;
+        }
+        return NoError();
+#else
+        if (enable) {
+            return NotImplementedError();
+        }
+        return NoError();
+#endif
+    }
+
+  protected:
+    int_type overflow(int_type ch) override {
+        if (!drain()) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        if (n > epptr() - pptr()) {
+            if (!drain()) {
+                return 0;
+            }
+            // Very large records bypass the buffer entirely
+            if ((size_t)n >= data_.size()) {
+                return emit_(s, (size_t)n) ? n : 0;
+            }
+        }
+        traits_type::copy(pptr(), s, (size_t)n);
+        pbump((int)n);
+        return n;
+    }
+
+    int sync() override { return drain() ? 0 : -1; }
+
+  private:
+    std::vector<char> data_;
+
+    void reset_() { setp(data_.data(), data_.data() + data_.size()); }
+
+    bool emit_(const char *base, size_t count) {
+#ifndef MK_WITHOUT_ZLIB
+        if (gzip_) {
+            return write_member_(base, count);
+        }
+#endif
+        return write_all_(base, count);
+    }
+
+#ifndef MK_WITHOUT_ZLIB
+    bool gzip_ = false;
+    z_stream stream_ = {};
+    std::vector<char> zdata_;
+
+    // Compresses the data as a complete gzip member in a single pass
+    bool write_member_(const char *base, size_t count) {
+        if (count == 0) {
+            return true;
+        }
+        if (deflateReset(&stream_) != Z_OK) {
+            return false;
+        }
+        // Also leave room for the gzip header and trailer
+        zdata_.resize(deflateBound(&stream_, (uLong)count) + 32);
+        stream_.next_in = (Bytef *)base;
+        stream_.avail_in = (uInt)count;
+        stream_.next_out = (Bytef *)zdata_.data();
+        stream_.avail_out = (uInt)zdata_.size();
+        if (deflate(&stream_, Z_FINISH) != Z_STREAM_END) {
+            return false;
+        }
+        return write_all_(zdata_.data(), zdata_.size() - stream_.avail_out);
+    }
+#endif
+
+    bool write_all_(const char *base, size_t count) {
+        while (count > 0) {
+            auto n = MK_FW_WRITE(fd, base, count);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            base += n;
+            count -= (size_t)n;
+        }
+        return true;
+    }
+};
+
+FileWriter::FileWriter() : std::ostream{nullptr}, buffer_{new Buffer} {
+    rdbuf(buffer_.get());
+    setstate(std::ios_base::badbit); // Until we open a file
+}
+
+FileWriter::~FileWriter() { close(); }
+
+Error FileWriter::open(std::string path) {
+    close();
+    Error err = buffer_->set_gzip(gzip);
+    if (err) {
+        return err;
+    }
+    buffer_->fd = MK_FW_OPEN(path.c_str(), append);
+    if (buffer_->fd < 0) {
+        return FileIoError();
+    }
+    clear();
+    last_commit_ = time_now();
+    pending_records_ = 0;
+    return NoError();
+}
+
+bool FileWriter::is_open() const { return buffer_->fd >= 0; }
+
+Error FileWriter::end_record() {
+    pending_records_ += 1;
+    if ((flush_every > 0 && pending_records_ >= flush_every) ||
+        (min_flush_interval > 0.0 &&
+         time_now() - last_commit_ >= min_flush_interval)) {
+        return commit();
+    }
+    if (!good()) {
+        return FileIoError();
+    }
+    return NoError();
+}
+
+Error FileWriter::commit() {
+    if (!is_open()) {
+        return FileIoError();
+    }
+    pending_records_ = 0;
+    last_commit_ = time_now();
+    if (!flush().good()) {
+        return FileIoError();
+    }
+    if (fsync && MK_FW_FSYNC(buffer_->fd) != 0) {
+        setstate(std::ios_base::badbit);
+        return FileIoError();
+    }
+    return NoError();
+}
+
+Error FileWriter::close() {
+    if (!is_open()) {
+        return NoError();
+    }
+    Error err = commit();
+    if (MK_FW_CLOSE(buffer_->fd) != 0 && !err) {
+        err = FileIoError();
+    }
+    buffer_->fd = -1;
+    setstate(std::ios_base::badbit);
+    return err;
+}
+
+} // namespace mk
@@ -0,0 +1,70 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_FILE_WRITER_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_FILE_WRITER_HPP
+
+#include "src/libmeasurement_kit/common/error.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace mk {
+
+/*
+ * Output stream writing into a file with group commit semantics. Records
+ * are written into a large buffer and the buffer is committed to the file
+ * after `flush_every` records, when a record ends at least
+ * `min_flush_interval` seconds after the previous commit, and on close.
+ * Zero disables the corresponding policy. If `fsync` is true, every commit
+ * also waits for data to reach the storage device.
+ *
+ * There is no timer: the interval is only checked by end_record(), hence
+ * an idle writer keeps its records buffered until commit() or close().
+ *
+ * If `gzip` is true when the file is opened, each commit is written as an
+ * independent gzip member. The concatenation of members is a valid gzip
+ * file, and a crash loses at most the records not yet committed. Since
+ * members do not share state, committing less often compresses better.
+ *
+ * Usage: write a record using the stream operators, then call end_record().
+ */
+class FileWriter : public std::ostream, public NonCopyable, public NonMovable {
+  public:
+    size_t flush_every = 1;
+    double min_flush_interval = 0.0;
+    bool fsync = false;
+    bool gzip = false;
+    bool append = false;
+
+    FileWriter();
+
+    // Commits and closes the file
+    ~FileWriter() override;
+
+    // Opens the file for writing, truncating it unless `append` is set. Fails
+    // with NotImplementedError if `gzip` is set and we lack zlib.
+    Error open(std::string path);
+
+    bool is_open() const;
+
+    // Tells us that a record has been written, possibly committing
+    Error end_record();
+
+    // Commits the buffered records
+    Error commit();
+
+    Error close();
+
+  private:
+    class Buffer;
+    std::unique_ptr<Buffer> buffer_;
+    double last_commit_ = 0.0;
+    size_t pending_records_ = 0;
+};
+
+} // namespace mk
+#endif
@@ -0,0 +1,155 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/json_writer.hpp"
+
+#include <utility>
+
+namespace mk {
+
+// Returns the length of the UTF-8 sequence at `s` or zero if it is not
+// valid, rejecting what the strict mode of nlohmann::json rejects.
+static size_t utf8_sequence_length(const unsigned char *s, size_t n) {
+    auto in = [](unsigned char c, unsigned char lo, unsigned char hi) {
+        return c >= lo && c <= hi;
+    };
+    unsigned char c = s[0];
+    if (in(c, 0xc2, 0xdf)) {
+        return (n >= 2 && in(s[1], 0x80, 0xbf)) ? 2 : 0;
+    }
+    if (in(c, 0xe0, 0xef)) {
+        unsigned char lo = (c == 0xe0) ? 0xa0 : 0x80;
+        unsigned char hi = (c == 0xed) ? 0x9f : 0xbf; /* No surrogates */
+        return (n >= 3 && in(s[1], lo, hi) && in(s[2], 0x80, 0xbf)) ? 3 : 0;
+    }
+    if (in(c, 0xf0, 0xf4)) {
+        unsigned char lo = (c == 0xf0) ? 0x90 : 0x80;
+        unsigned char hi = (c == 0xf4) ? 0x8f : 0xbf; /* Up to U+10FFFF */
+        return (n >= 4 && in(s[1], lo, hi) && in(s[2], 0x80, 0xbf) &&
+                in(s[3], 0x80, 0xbf)) ? 4 : 0;
+    }
+    return 0;
+}
+
+// Writes a DOM producing the same bytes that dump() would produce
+class JsonWriter {
+  public:
+    std::string out;
+
+    void write(const nlohmann::json &j);
+
+  private:
+    void write_string_(const std::string &s);
+    void escape_(const char *s, size_t n);
+};
+
+void JsonWriter::write(const nlohmann::json &j) {
+    switch (j.type()) {
+    case nlohmann::json::value_t::object: {
+        out += '{';
+        bool first = true;
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            if (!first) {
+                out += ',';
+            }
+            first = false;
+            write_string_(it.key());
+            out += ':';
+            write(it.value());
+        }
+        out += '}';
+        return;
+    }
+    case nlohmann::json::value_t::array: {
+        out += '[';
+        bool first = true;
+        for (auto &elem : j) {
+            if (!first) {
+                out += ',';
+            }
+            first = false;
+            write(elem);
+        }
+        out += ']';
+        return;
+    }
+    case nlohmann::json::value_t::string:
+        write_string_(j.get_ref<const std::string &>());
+        return;
+    default:
+        break;
+    }
+    // Numbers, booleans and null are short enough that dump() does not
+    // allocate
+    out += j.dump();
+}
+
+void JsonWriter::write_string_(const std::string &s) {
+    out.reserve(out.size() + s.size() + 2);
+    out += '"';
+    escape_(s.data(), s.size());
+    out += '"';
+}
+
+void JsonWriter::escape_(const char *s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p = (const unsigned char *)s;
+    size_t begin = 0;
+    size_t i = 0;
+    while (i < n) {
+        unsigned char c = p[i];
+        if (c >= 0x80) {
+            size_t len = utf8_sequence_length(p + i, n - i);
+            if (len == 0) {
+                throw JsonProcessingError();
+            }
+            i += len;
+            continue;
+        }
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            ++i;
+            continue;
+        }
+        // Copy the run of characters that need no escaping at once
+        out.append(s + begin, i - begin);
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0x0f];
+            break;
+        }
+        begin = ++i;
+    }
+    out.append(s + begin, n - begin);
+}
+
+std::string json_dump(const nlohmann::json &j) {
+    JsonWriter writer;
+    writer.write(j);
+    return std::move(writer.out);
+}
+
+} // namespace mk
@@ -0,0 +1,24 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_JSON_WRITER_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_JSON_WRITER_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include "src/libmeasurement_kit/common/error.hpp"
+
+#include <string>
+
+namespace mk {
+
+/*
+ * Same as nlohmann::json::dump() but faster with long strings, e.g. HTTP
+ * bodies, because runs of characters that need no escaping are copied at
+ * once, rather than one character at a time. Like dump(), it throws if a
+ * string is not valid UTF-8, except that it throws JsonProcessingError.
+ */
+std::string json_dump(const nlohmann::json &j);
+
+} // namespace mk
+#endif
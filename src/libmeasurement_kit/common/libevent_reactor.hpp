@@ -200,12 +200,19 @@ class LibeventReactor : public Reactor, public NonCopyable, public NonMovable {
         cb(data_usage);
     }
 
+    // ## Connection governor
+
+    SharedPtr<ConnectionGovernor> connection_governor() override {
+        return governor;
+    }
+
   private:
     // ## Private attributes
 
     UniquePtr<event_base, EventBaseDeleter> evbase;
     std::recursive_mutex data_usage_mutex;
     DataUsage data_usage;
+    SharedPtr<ConnectionGovernor> governor = ConnectionGovernor::make();
     Worker worker;
 };
 
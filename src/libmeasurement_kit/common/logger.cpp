@@ -10,14 +10,15 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#include <atomic>
 #include <cstdint>
-#include <fstream>
 #include <list>
 #include <mutex>
 
 #include "src/libmeasurement_kit/common/callback.hpp"
 #include "src/libmeasurement_kit/common/delegate.hpp"
 #include "src/libmeasurement_kit/common/error.hpp"
+#include "src/libmeasurement_kit/common/file_writer.hpp"
 #include "src/libmeasurement_kit/common/logger.hpp"
 #include "src/libmeasurement_kit/common/locked.hpp"
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
@@ -115,23 +116,32 @@ class DefaultLogger : public Logger, public NonCopyable, public NonMovable {
             }
         }
         if (ofile_) {
-            // FIX: use `std::endl` rather than `\n` to make sure we flush
-            // after each line. Fixes TheTorProject/ooniprobe-ios#80.
-            *ofile_ << s << std::endl;
+            // We used `std::endl` to flush after each line, which fixed
+            // TheTorProject/ooniprobe-ios#80 at the cost of one write per
+            // line. Now we flush warnings immediately and other lines when
+            // we write a line at least one second after the previous flush.
+            // FileWriter has no timer, so lines written right before going
+            // idle stay buffered until flush() or until we are destroyed.
+            *ofile_ << s << '\n';
+            if ((level & MK_LOG_VERBOSITY_MASK) <= MK_LOG_WARNING) {
+                ofile_->commit();
+            } else {
+                ofile_->end_record();
+            }
             // TODO: suppose here write fails... what do we want to do?
         }
     }
 
     void logs(uint32_t level, const char *s) override {
-        std::unique_lock<std::recursive_mutex> _{mutex_};
-        if ((level & MK_LOG_VERBOSITY_MASK) <= verbosity_) {
+        if ((level & MK_LOG_VERBOSITY_MASK) <= get_verbosity()) {
+            std::unique_lock<std::recursive_mutex> _{mutex_};
             logs_unlocked_(level, s);
         }
     }
 
     void logsv(uint32_t level, const std::vector<std::string> &v) override {
-        std::unique_lock<std::recursive_mutex> _{mutex_};
-        if ((level & MK_LOG_VERBOSITY_MASK) <= verbosity_) {
+        if ((level & MK_LOG_VERBOSITY_MASK) <= get_verbosity()) {
+            std::unique_lock<std::recursive_mutex> _{mutex_};
             for (auto &s : v) logs_unlocked_(level, s.c_str());
         }
     }
@@ -160,21 +170,20 @@ class DefaultLogger : public Logger, public NonCopyable, public NonMovable {
     void debug2(const char *fmt, ...) override { XX(this, MK_LOG_DEBUG2); }
 
     void set_verbosity(uint32_t v) override {
-        std::unique_lock<std::recursive_mutex> _{mutex_};
         verbosity_ = (v & MK_LOG_VERBOSITY_MASK);
     }
 
     void increase_verbosity() override {
-        std::unique_lock<std::recursive_mutex> _{mutex_};
-        if (verbosity_ < MK_LOG_VERBOSITY_MASK) {
-            ++verbosity_;
+        uint32_t cur = verbosity_;
+        while (cur < MK_LOG_VERBOSITY_MASK &&
+               !verbosity_.compare_exchange_weak(cur, cur + 1)) {
+            /* nothing */;
         }
     }
 
-    uint32_t get_verbosity() override {
-        std::unique_lock<std::recursive_mutex> _{mutex_};
-        return verbosity_;
-    }
+    // Not protected by the mutex, so that checking whether a message
+    // should be logged does not contend with threads that are logging.
+    uint32_t get_verbosity() override { return verbosity_; }
 
     void on_log(Callback<uint32_t, const char *> &&fn) override {
         std::unique_lock<std::recursive_mutex> _{mutex_};
@@ -204,10 +213,20 @@ class DefaultLogger : public Logger, public NonCopyable, public NonMovable {
 
     void set_logfile(std::string path) override {
         std::unique_lock<std::recursive_mutex> _{mutex_};
-        ofile_.reset(new std::ofstream(path));
+        ofile_.reset(new FileWriter);
+        ofile_->flush_every = 0;
+        ofile_->min_flush_interval = 1.0;
+        ofile_->open(path);
         // TODO: what to do if we cannot open the logfile? return error?
     }
 
+    void flush() override {
+        std::unique_lock<std::recursive_mutex> _{mutex_};
+        if (ofile_) {
+            ofile_->commit();
+        }
+    }
+
     void progress(double prog, const char *s) override {
         std::unique_lock<std::recursive_mutex> _{mutex_};
         prog = prog * progress_scale_ + progress_offset_;
@@ -289,14 +308,15 @@ class DefaultLogger : public Logger, public NonCopyable, public NonMovable {
                 /* Suppress */;
             }
         }
+        flush(); // Also done by ofile_ when destroyed, but be explicit
     }
 
   private:
     Delegate<uint32_t, const char *> consumer_;
-    uint32_t verbosity_ = MK_LOG_WARNING;
+    std::atomic<uint32_t> verbosity_{MK_LOG_WARNING};
     char buffer_[32768];
     std::recursive_mutex mutex_;
-    SharedPtr<std::ofstream> ofile_;
+    SharedPtr<FileWriter> ofile_;
     std::list<Delegate<>> eof_handlers_;
     Delegate<const char *> event_handler_;
     std::map<std::string, Delegate<nlohmann::json &&>> handlers_;
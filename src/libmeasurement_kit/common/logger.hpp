@@ -134,9 +134,27 @@ class Logger {
     /// will set as new verbosity MK_LOG_DEBUG.
     virtual void increase_verbosity() = 0;
 
-    /// `get_verbosity()` gets the current verbosity.
+    /// \brief `get_verbosity()` gets the current verbosity. In the default
+    /// logger this does not acquire the mutex, so it is cheap to call.
     virtual uint32_t get_verbosity() = 0;
 
+    /// \brief `log_lazy()` calls \p fn, which must return a std::string, and
+    /// logs the returned string with log() only when messages with \p level
+    /// would be emitted. Use it when computing the message is expensive, so
+    /// that nothing is computed when the message would be discarded.
+    ///
+    /// ```C++
+    /// logger->log_lazy(MK_LOG_DEBUG2, [&]() {
+    ///     return base64_encode_if_needed(body);
+    /// });
+    /// ```
+    template <typename Func> void log_lazy(uint32_t level, Func &&fn) {
+        if ((level & MK_LOG_VERBOSITY_MASK) <= get_verbosity()) {
+            std::string s = fn();
+            log(level, "%s", s.c_str());
+        }
+    }
+
     /// `on_log` allows to set the log handler.
     virtual void on_log(Callback<uint32_t, const char *> &&fn) = 0;
 
@@ -163,6 +181,10 @@ class Logger {
     /// `set_logfile()` sets the file where to write logs.
     virtual void set_logfile(std::string fpath) = 0;
 
+    /// \brief `flush()` writes into the logfile the lines that are still
+    /// buffered, if any. This also happens when the logger is destroyed.
+    virtual void flush() = 0;
+
     /// `emit_event_ex()` emits an event as a JSON.
     virtual void emit_event_ex(std::string key, nlohmann::json &&value) = 0;
 
@@ -7,6 +7,7 @@
 #include "src/libmeasurement_kit/common/socket.hpp"
 #include "src/libmeasurement_kit/common/logger.hpp"
 #include "src/libmeasurement_kit/common/callback.hpp"
+#include "src/libmeasurement_kit/common/connection_governor.hpp"
 #include "src/libmeasurement_kit/common/error.hpp"
 
 #include <measurement_kit/common/data_usage.hpp>
@@ -144,6 +145,10 @@ class Reactor {
     // see the real content of DNS queries, we cannot see retransmissions as
     // we're not the kernel, etc.
     virtual void with_current_data_usage(Callback<DataUsage &> &&cb) = 0;
+
+    // `connection_governor()` returns the governor limiting the connections
+    // of all the code running on this reactor. See net::connect().
+    virtual SharedPtr<ConnectionGovernor> connection_governor() = 0;
 };
 
 } // namespace mk
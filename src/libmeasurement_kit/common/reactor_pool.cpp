@@ -0,0 +1,67 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/reactor_pool.hpp"
+
+#include <event2/event.h>
+
+#include <new>
+#include <stdexcept>
+
+extern "C" {
+static void mk_keep_alive_cb(evutil_socket_t, short, void *) {}
+}
+
+namespace mk {
+
+KeepAlive::KeepAlive(SharedPtr<Reactor> reactor) : reactor_{reactor} {
+    // Persistent, so that it stays pending even if the day ever elapses
+    event *ev = event_new(reactor_->get_event_base(), -1, EV_PERSIST,
+                          mk_keep_alive_cb, nullptr);
+    if (ev == nullptr) {
+        throw std::bad_alloc();
+    }
+    timeval one_day{24 * 60 * 60, 0};
+    if (event_add(ev, &one_day) != 0) {
+        event_free(ev);
+        throw std::runtime_error("event_add");
+    }
+    event_ = ev;
+}
+
+void KeepAlive::release() {
+    event *ev = event_.exchange(nullptr);
+    if (ev != nullptr) {
+        event_free(ev);
+        // Deleting a timer does not wake up the reactor, which would then
+        // sleep until the day elapses. Scheduling a call does, after which
+        // the reactor notices that it has nothing left to do.
+        reactor_->call_soon([]() {});
+    }
+}
+
+ReactorPool::ReactorPool(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        reactors_.push_back(Reactor::make());
+        keep_alives_.emplace_back(new KeepAlive(reactors_.back()));
+    }
+    for (auto reactor : reactors_) {
+        threads_.emplace_back([reactor]() { reactor->run(); });
+    }
+}
+
+ReactorPool::~ReactorPool() {
+    stop();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ReactorPool::stop() {
+    for (auto &keep_alive : keep_alives_) {
+        keep_alive->release();
+    }
+}
+
+} // namespace mk
@@ -0,0 +1,68 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_REACTOR_POOL_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_REACTOR_POOL_HPP
+
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/unique_ptr.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct event;
+
+namespace mk {
+
+/*
+ * Keeps a reactor running, even when it has nothing to do, until released.
+ * It is a pending libevent event that is never due, so it does not wake up
+ * the reactor while idle. Both the constructor and release() may be called
+ * from any thread, and release() may be called more than once.
+ */
+class KeepAlive : public NonCopyable, public NonMovable {
+  public:
+    explicit KeepAlive(SharedPtr<Reactor> reactor);
+
+    ~KeepAlive() { release(); }
+
+    // Lets the reactor exit once idle, waking it up
+    void release();
+
+  private:
+    SharedPtr<Reactor> reactor_; /* Owns the event base of `event_` */
+    std::atomic<event *> event_{nullptr};
+};
+
+/*
+ * Pool of reactors, each running in its own thread, so that the code that
+ * we schedule on them can use more than one CPU. Use call_soon() to run code
+ * on a reactor of the pool, which is thread safe. Reactors keep running,
+ * even when idle, until the pool is stopped, after which they exit once
+ * they have no more pending events. The destructor stops the pool and waits
+ * for the threads to exit.
+ */
+class ReactorPool : public NonCopyable, public NonMovable {
+  public:
+    explicit ReactorPool(size_t count);
+
+    ~ReactorPool();
+
+    size_t size() const { return reactors_.size(); }
+
+    SharedPtr<Reactor> at(size_t index) const { return reactors_.at(index); }
+
+    // Lets the reactors exit once idle, without waiting for them
+    void stop();
+
+  private:
+    std::vector<SharedPtr<Reactor>> reactors_;
+    std::vector<UniquePtr<KeepAlive>> keep_alives_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace mk
+#endif
@@ -121,11 +121,14 @@ static bool is_event_key_valid(const std::string &str) {
         (str == "status.queued") ||
         (str == "status.measurement_start") ||
         (str == "status.measurement_submission") ||
+        (str == "status.measurement_spooled") ||
         (str == "status.measurement_done") ||
         (str == "status.report_close") ||
         (str == "status.report_create") ||
+        (str == "status.report_submit") ||
         (str == "status.resolver_lookup") ||
         (str == "status.started") ||
+        (str == "status.update.concurrency") ||
         (str == "status.update.performance") ||
         (str == "status.update.websites") ||
         (str == "task_terminated");
@@ -256,6 +259,11 @@ nlohmann::json possibly_validate_event(nlohmann::json &&event) {
             assert(event.at("value").at("idx").is_number_integer());
             break;
         }
+        if (event.at("key") == "status.measurement_spooled") {
+            assert(event.at("value").count("idx") == 1);
+            assert(event.at("value").at("idx").is_number_integer());
+            break;
+        }
         if (event.at("key") == "status.measurement_done") {
             assert(event.at("value").count("idx") == 1);
             assert(event.at("value").at("idx").is_number_integer());
@@ -271,11 +279,25 @@ nlohmann::json possibly_validate_event(nlohmann::json &&event) {
             assert(event.at("value").at("report_id").is_string());
             break;
         }
+        if (event.at("key") == "status.report_submit") {
+            assert(event.at("value").count("acked_entries") == 1);
+            assert(event.at("value").at("acked_entries").is_number_integer());
+            assert(event.at("value").count("acked_offset") == 1);
+            assert(event.at("value").at("acked_offset").is_number_integer());
+            assert(event.at("value").count("report_id") == 1);
+            assert(event.at("value").at("report_id").is_string());
+            break;
+        }
         if (event.at("key") == "status.resolver_lookup") {
             assert(event.at("value").count("ip_address") == 1);
             assert(event.at("value").at("ip_address").is_string());
             break;
         }
+        if (event.at("key") == "status.update.concurrency") {
+            assert(event.at("value").count("parallelism") == 1);
+            assert(event.at("value").at("parallelism").is_number_integer());
+            break;
+        }
         if (event.at("key") == "status.update.performance") {
             assert(event.at("value").count("direction") == 1);
             assert(event.at("value").at("direction").is_string());
@@ -319,11 +341,14 @@ static nlohmann::json known_events() {
     json.push_back("status.queued");
     json.push_back("status.measurement_start");
     json.push_back("status.measurement_submission");
+    json.push_back("status.measurement_spooled");
     json.push_back("status.measurement_done");
     json.push_back("status.report_close");
     json.push_back("status.report_create");
+    json.push_back("status.report_submit");
     json.push_back("status.resolver_lookup");
     json.push_back("status.started");
+    json.push_back("status.update.concurrency");
     json.push_back("status.update.performance");
     json.push_back("status.update.websites");
     json.push_back("task_terminated");
@@ -626,6 +651,30 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "backend_batch_delay") {
+                        found = true;
+                        if (!value.is_number_float()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_float)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "backend_batch_size") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "bouncer_base_url") {
                         found = true;
                         if (!value.is_string()) {
@@ -638,6 +687,18 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "checkpoint") {
+                        found = true;
+                        if (!value.is_boolean()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "boolean)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "collector_base_url") {
                         found = true;
                         if (!value.is_string()) {
@@ -650,6 +711,18 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "collector_outbox_dir") {
+                        found = true;
+                        if (!value.is_string()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "string)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "constant_bitrate") {
                         found = true;
                         if (!value.is_number_integer()) {
@@ -734,6 +807,18 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "html_title_scan_length") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "ignore_bouncer_error") {
                         found = true;
                         if (!value.is_boolean()) {
@@ -758,6 +843,66 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "max_connecting") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "max_open_sockets") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "max_parallelism") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "max_parallelism_per_host") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "max_queued_entries") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "max_runtime") {
                         found = true;
                         if (!value.is_number_integer()) {
@@ -770,6 +915,30 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "max_writing_entries") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "min_parallelism") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "mlabns/address_family") {
                         found = true;
                         if (!value.is_string()) {
@@ -926,6 +1095,18 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "parallelism") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "port") {
                         found = true;
                         if (!value.is_number_integer()) {
@@ -998,6 +1179,54 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "report_flush_every") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "report_flush_interval") {
+                        found = true;
+                        if (!value.is_number_float()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_float)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "report_fsync") {
+                        found = true;
+                        if (!value.is_boolean()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "boolean)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
+                    if (key == "report_gzip") {
+                        found = true;
+                        if (!value.is_boolean()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "boolean)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "save_real_probe_asn") {
                         found = true;
                         if (!value.is_boolean()) {
@@ -1070,6 +1299,18 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
                         }
                         break;
                     }
+                    if (key == "shards") {
+                        found = true;
+                        if (!value.is_number_integer()) {
+                            std::stringstream ss;
+                            ss << "Found " << key << " option which has the "
+                               << "wrong type (fyi: it should be a "
+                               << "number_integer)";
+                            emit_settings_warning(task, ss.str().data());
+                            // FALLTHROUGH
+                        }
+                        break;
+                    }
                     if (key == "software_name") {
                         found = true;
                         if (!value.is_string()) {
@@ -1329,6 +1570,9 @@ void task_run_legacy(Task *task, TaskImpl *pimpl, nlohmann::json &settings) {
     runnable->reactor->with_current_data_usage([&](DataUsage &x) {
         du = x;
     });
+    // The logger may outlive the task, so make sure the logfile is complete
+    // before telling the application that the task is over
+    runnable->logger->flush();
     runnable->logger->emit_event_ex("status.end", {
         {"downloaded_kb", du.down / 1024.0},
         {"failure", error.reason},
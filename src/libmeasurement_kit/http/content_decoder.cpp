@@ -0,0 +1,175 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/http/content_decoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mk {
+namespace http {
+
+#ifndef MK_WITHOUT_ZLIB
+
+class ContentDecoder::Impl {
+  public:
+    z_stream stream = {};
+    bool initialized = false;
+
+    // With `deflate` some servers send a raw deflate stream instead of
+    // a zlib stream, so we keep the first bytes around to retry.
+    bool is_deflate = false;
+    bool tried_raw = false;
+    std::string head;
+
+    // Whether we have seen the end of at least one gzip member.
+    bool ended = false;
+    // Whether we should ignore any further input.
+    bool done = false;
+
+    Error init(int window_bits) {
+        if (initialized) {
+            inflateEnd(&stream);
+            initialized = false;
+        }
+        stream = z_stream{};
+        if (inflateInit2(&stream, window_bits) != Z_OK) {
+            return ContentDecodingError();
+        }
+        initialized = true;
+        return NoError();
+    }
+
+    Error inflate_into(std::string &out) {
+        constexpr size_t chunk = 16384;
+        do {
+            // Inflate directly at the end of `out` to avoid copies.
+            size_t off = out.size();
+            out.resize(off + chunk);
+            stream.next_out = (Bytef *)&out[off];
+            stream.avail_out = chunk;
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            out.resize(off + chunk - stream.avail_out);
+            if (ret == Z_STREAM_END) {
+                // Possibly another gzip member follows (RFC 1952 Sect. 2.2)
+                ended = true;
+                if (inflateReset(&stream) != Z_OK) {
+                    return ContentDecodingError();
+                }
+                continue;
+            }
+            if (ret == Z_BUF_ERROR) {
+                break; // Needs more input to make progress
+            }
+            if (ret != Z_OK) {
+                return ContentDecodingError();
+            }
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+        return NoError();
+    }
+
+    ~Impl() {
+        if (initialized) {
+            inflateEnd(&stream);
+        }
+    }
+};
+
+/*static*/ std::string ContentDecoder::accept_encoding() {
+    return "gzip, deflate";
+}
+
+ContentDecoder::ContentDecoder(bool is_deflate) : impl_{new Impl} {
+    impl_->is_deflate = is_deflate;
+}
+
+Error ContentDecoder::decode(const char *p, size_t n, std::string &out) {
+    if (impl_->done || n == 0) {
+        return NoError();
+    }
+    if (!impl_->initialized) {
+        // Adding 32 to the window bits enables gzip and zlib auto detection
+        Error err = impl_->init(MAX_WBITS + 32);
+        if (err) {
+            return err;
+        }
+    }
+    bool may_retry_raw = impl_->is_deflate && !impl_->tried_raw &&
+                         impl_->stream.total_out == 0;
+    if (may_retry_raw) {
+        impl_->head.append(p, n);
+    }
+    impl_->stream.next_in = (Bytef *)p;
+    impl_->stream.avail_in = (uInt)n;
+    size_t off = out.size();
+    Error err = impl_->inflate_into(out);
+    if (err && may_retry_raw) {
+        out.resize(off);
+        impl_->tried_raw = true;
+        // Negative window bits means raw deflate
+        err = impl_->init(-MAX_WBITS);
+        if (err) {
+            return err;
+        }
+        std::string head;
+        std::swap(head, impl_->head);
+        impl_->stream.next_in = (Bytef *)head.data();
+        impl_->stream.avail_in = (uInt)head.size();
+        err = impl_->inflate_into(out);
+    }
+    if (impl_->stream.total_out > 0) {
+        impl_->head.clear();
+    }
+    if (err && impl_->ended) {
+        // Like browsers do, ignore trailing garbage after the stream end
+        impl_->done = true;
+        return NoError();
+    }
+    return err;
+}
+
+#else
+
+class ContentDecoder::Impl {};
+
+/*static*/ std::string ContentDecoder::accept_encoding() { return ""; }
+
+ContentDecoder::ContentDecoder(bool) : impl_{new Impl} {}
+
+Error ContentDecoder::decode(const char *, size_t, std::string &) {
+    return UnsupportedContentEncodingError();
+}
+
+#endif
+
+ContentDecoder::~ContentDecoder() {}
+
+/*static*/ ErrorOr<SharedPtr<ContentDecoder>>
+ContentDecoder::make(std::string encoding) {
+    encoding.erase(std::remove_if(encoding.begin(), encoding.end(),
+                                  [](char c) { return isspace(c) != 0; }),
+                   encoding.end());
+    std::transform(encoding.begin(), encoding.end(), encoding.begin(),
+                   [](char c) { return (char)tolower(c); });
+    if (encoding == "" || encoding == "identity") {
+        return {NoError(), {}};
+    }
+    if (accept_encoding() == "") {
+        return {UnsupportedContentEncodingError(), {}};
+    }
+    if (encoding == "gzip" || encoding == "x-gzip") {
+        return {NoError(), SharedPtr<ContentDecoder>::make(false)};
+    }
+    if (encoding == "deflate") {
+        return {NoError(), SharedPtr<ContentDecoder>::make(true)};
+    }
+    return {UnsupportedContentEncodingError(), {}};
+}
+
+} // namespace http
+} // namespace mk
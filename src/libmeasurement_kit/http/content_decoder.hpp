@@ -0,0 +1,44 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_HTTP_CONTENT_DECODER_HPP
+#define SRC_LIBMEASUREMENT_KIT_HTTP_CONTENT_DECODER_HPP
+
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/http/http.hpp"
+
+#include <memory>
+
+namespace mk {
+namespace http {
+
+/*
+ * Incrementally decodes a body sent with `Content-Encoding` gzip or
+ * deflate. Data is passed to decode() as soon as it is received, so we
+ * never need to keep the whole encoded body in memory.
+ */
+class ContentDecoder : public NonCopyable, public NonMovable {
+  public:
+    // Returns the value of the Accept-Encoding header that we should send
+    // when decoding is enabled, or the empty string without zlib.
+    static std::string accept_encoding();
+
+    // Returns a null pointer for the identity encoding and an error when
+    // the encoding is not supported.
+    static ErrorOr<SharedPtr<ContentDecoder>> make(std::string encoding);
+
+    // Appends to `out` the bytes that could be decoded from `p`.
+    Error decode(const char *p, size_t n, std::string &out);
+
+    ContentDecoder(bool is_deflate);
+    ~ContentDecoder();
+
+  private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace http
+} // namespace mk
+#endif
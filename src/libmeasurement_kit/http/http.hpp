@@ -56,6 +56,8 @@ MK_DEFINE_ERR(MK_ERR_HTTP(30), ParserInvalidInternalStateError, "http_parser_inv
 MK_DEFINE_ERR(MK_ERR_HTTP(31), ParserStrictModeAssertionError, "http_parser_strict_mode_assertion")
 MK_DEFINE_ERR(MK_ERR_HTTP(32), ParserPausedError, "http_parser_paused")
 MK_DEFINE_ERR(MK_ERR_HTTP(33), GenericParserError, "http_parser_generic_error")
+MK_DEFINE_ERR(MK_ERR_HTTP(34), ContentDecodingError, "http_content_decoding_error")
+MK_DEFINE_ERR(MK_ERR_HTTP(35), UnsupportedContentEncodingError, "http_unsupported_content_encoding")
 
 /*
  _   _      _
@@ -107,7 +109,7 @@ using Headers = std::vector<Header>;
 
 inline std::string
 headers_find_first(const Headers &headers, const std::string &key) {
-  for (auto h : headers) {
+  for (const auto &h : headers) {
     if (strcasecmp(h.key.c_str(), key.c_str()) == 0) {
       return h.value;
     }
@@ -149,6 +151,9 @@ struct Response {
     std::string reason;
     Headers headers;
     std::string body;
+    // Length of the body as received, i.e. before we decoded it
+    // according to its `Content-Encoding`; see `http/decode_content`.
+    size_t encoded_body_length = 0;
 };
 
 ErrorOr<Url> redirect(const Url &orig_url, const std::string &location);
@@ -184,8 +189,14 @@ void request_maybe_sendrecv(ErrorOr<SharedPtr<Request>>, SharedPtr<net::Transpor
  *       {"http/ignore_body", boolean},
  *       {"http/method", "GET|DELETE|PUT|POST|HEAD|..."},
  *       {"http/http_version", "HTTP/1.1"},
- *       {"http/path", by default is taken from the url}
+ *       {"http/path", by default is taken from the url},
+ *       {"http/decode_content", boolean (default is false)}
  *     }
+ *
+ * When `http/decode_content` is true and MK is compiled with zlib, we
+ * send `Accept-Encoding: gzip, deflate` (unless the caller already
+ * specified an Accept-Encoding header) and we decode the body while we
+ * receive it. The original body length is in `encoded_body_length`.
  */
 
 void request(Settings, Headers, std::string, Callback<Error, SharedPtr<Response>>,
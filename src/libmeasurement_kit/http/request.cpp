@@ -3,6 +3,7 @@
 // and LICENSE for more information on the copying conditions.
 
 #include "src/libmeasurement_kit/http/request_impl.hpp"
+#include "src/libmeasurement_kit/http/content_decoder.hpp"
 #include "src/libmeasurement_kit/common/encoding.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/net/error.hpp"
@@ -56,6 +57,16 @@ Error Request::init(Settings settings, Headers hdrs, std::string bd) {
     if (url_path != "" && url_path[0] != '/') {
         url_path = "/" + url_path;
     }
+    ErrorOr<bool> decode_content = settings.get_noexcept(
+            "http/decode_content", false);
+    if (!decode_content) {
+        return decode_content.as_error();
+    }
+    std::string accept_encoding = ContentDecoder::accept_encoding();
+    if (*decode_content && accept_encoding != "" &&
+        headers_find_first(headers, "Accept-Encoding") == "") {
+        headers_push_back(headers, "Accept-Encoding", accept_encoding);
+    }
     return NoError();
 }
 
@@ -67,7 +78,7 @@ void Request::serialize(net::Buffer &buff, SharedPtr<Logger> logger) {
         buff << url.pathquery;
     }
     buff << " " << protocol << "\r\n";
-    for (auto h : headers) {
+    for (auto &h : headers) {
         buff << h.key << ": " << h.value << "\r\n";
     }
     // if the host: header is passed explicitly,
@@ -85,12 +96,16 @@ void Request::serialize(net::Buffer &buff, SharedPtr<Logger> logger) {
         buff << "Content-Length: " << std::to_string(body.length()) << "\r\n";
     }
     buff << "\r\n";
-    for (auto s: mk::split(buff.peek(), "\r\n")) {
-        logger->debug("> %s", s.c_str());
+    if (logger->get_verbosity() >= MK_LOG_DEBUG) {
+        for (auto s: mk::split(buff.peek(), "\r\n")) {
+            logger->debug("> %s", s.c_str());
+        }
+        logger->debug(">");
     }
-    logger->debug(">");
     if (body != "") {
-        logger->debug2("%s", base64_encode_if_needed(body).c_str());
+        logger->log_lazy(MK_LOG_DEBUG2, [&]() {
+            return base64_encode_if_needed(body);
+        });
         buff << body;
     }
 }
@@ -136,6 +151,8 @@ class RequestRecvResponse {
   public:
     SharedPtr<Buffer> buff;
     Callback<Error, SharedPtr<Response>> cb;
+    SharedPtr<ContentDecoder> decoder;
+    Error decoder_error;
     SharedPtr<Logger> logger;
     SharedPtr<ResponseParserNg> parser;
     bool reached_end = false;
@@ -177,22 +194,54 @@ static void request_recv_response_start(SharedPtr<RequestRecvResponse> ctx) {
         ctx->cb(ValueError(), ctx->response);
         return;
     }
+    ErrorOr<bool> decode_content = ctx->settings.get_noexcept(
+            "http/decode_content", false);
+    if (!decode_content) {
+        ctx->cb(ValueError(), ctx->response);
+        return;
+    }
     if (*ignore_body == false) {
-        ctx->parser->on_body([ctx](std::string s) {
-            ctx->response->body += s;
+        ctx->parser->on_body_data([ctx](const char *s, size_t n) {
+            ctx->response->encoded_body_length += n;
+            if (!ctx->decoder) {
+                ctx->response->body.append(s, n);
+                return;
+            }
+            // We cannot throw across http-parser, hence we save the error,
+            // stop decoding and fail after feeding data to the parser.
+            Error err = ctx->decoder->decode(s, n, ctx->response->body);
+            if (err) {
+                ctx->decoder_error = err;
+                ctx->decoder.reset();
+            }
         });
     }
 
-    ctx->parser->on_response([ctx](Response r) {
-        *ctx->response = r;
+    ctx->parser->on_response([ctx, decode_content](Response r) {
+        if (*decode_content) {
+            size_t len = 0;
+            const char *p = ctx->parser->headers().find_first(
+                "Content-Encoding", &len);
+            if (p != nullptr) {
+                auto maybe_decoder = ContentDecoder::make(std::string(p, len));
+                if (!maybe_decoder) {
+                    // Keep the original body but make sure we fail
+                    ctx->decoder_error = maybe_decoder.as_error();
+                } else {
+                    ctx->decoder = *maybe_decoder;
+                }
+            }
+        }
+        *ctx->response = std::move(r);
         ctx->valid_response = true;
     });
 
     ctx->parser->on_end([ctx]() {
         ctx->reached_end = true;
         if (ctx->response->body.size() > 0) {
-            ctx->logger->debug2("%s", base64_encode_if_needed(
-                  ctx->response->body).c_str());
+            ctx->logger->log_lazy(MK_LOG_DEBUG2, [&]() {
+                return base64_encode_if_needed(ctx->response->body);
+            });
         }
     });
 
@@ -210,6 +259,9 @@ static void request_recv_response_loop(SharedPtr<RequestRecvResponse> ctx) {
                 err = second_error;
                 // FALLTHRU
             }
+            if (err == NoError() && ctx->decoder_error) {
+                err = ctx->decoder_error;
+            }
         }
         if (err == NoError() && ctx->reached_end == false) {
             ctx->logger->debug("http: continue reading for the response");
@@ -236,6 +288,7 @@ static void request_recv_response_loop(SharedPtr<RequestRecvResponse> ctx) {
             // we don't need in this context so to avoid reference loops.
             ctx->buff.reset();
             auto cb = std::move(ctx->cb);
+            ctx->decoder.reset();
             ctx->logger.reset();
             ctx->parser.reset();
             ctx->reactor.reset();
@@ -44,6 +44,96 @@ static int cb_message_complete(http_parser *p) {
 namespace mk {
 namespace http {
 
+static inline char ascii_tolower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+void HeaderArena::append(HeaderParserState prev, HeaderParserState cur,
+                         const char *s, size_t n) {
+    using HPS = HeaderParserState;
+    //
+    // This implements the finite state machine described by the
+    // documentation of joyent/http-parser.
+    //
+    // See github.com/joyent/http-parser/blob/master/README.md#callbacks
+    //
+    // Since we always append to the end of the arena, the fragments of
+    // the current field (or value) are stored contiguously.
+    //
+    if ((prev == HPS::NOTHING || prev == HPS::VALUE) && cur == HPS::FIELD) {
+        Entry entry;
+        entry.key_off = bytes_.size();
+        entry.key_len = n;
+        entries_.push_back(entry);
+    } else if (prev == HPS::FIELD && cur == HPS::FIELD) {
+        entries_.back().key_len += n;
+    } else if (prev == HPS::FIELD && cur == HPS::VALUE) {
+        entries_.back().value_off = bytes_.size();
+        entries_.back().value_len = n;
+    } else if (prev == HPS::VALUE && cur == HPS::VALUE) {
+        entries_.back().value_len += n;
+    } else {
+        throw HeaderParserInternalError();
+    }
+    bytes_.append(s, n);
+}
+
+void HeaderArena::finish() {
+    for (auto &entry : entries_) {
+        entry.key_hash = hash(bytes_.data() + entry.key_off, entry.key_len);
+    }
+}
+
+const char *HeaderArena::key(size_t idx, size_t *len) const {
+    *len = entries_.at(idx).key_len;
+    return bytes_.data() + entries_[idx].key_off;
+}
+
+const char *HeaderArena::value(size_t idx, size_t *len) const {
+    *len = entries_.at(idx).value_len;
+    return bytes_.data() + entries_[idx].value_off;
+}
+
+const char *HeaderArena::find_first(const std::string &key, size_t *len) const {
+    uint32_t key_hash = hash(key.data(), key.size());
+    for (auto &entry : entries_) {
+        if (entry.key_hash != key_hash || entry.key_len != key.size()) {
+            continue;
+        }
+        const char *p = bytes_.data() + entry.key_off;
+        size_t i = 0;
+        while (i < key.size() && ascii_tolower(p[i]) == ascii_tolower(key[i])) {
+            ++i;
+        }
+        if (i == key.size()) {
+            *len = entry.value_len;
+            return bytes_.data() + entry.value_off;
+        }
+    }
+    *len = 0;
+    return nullptr;
+}
+
+void HeaderArena::copy_to(Headers &headers) const {
+    headers.reserve(headers.size() + entries_.size());
+    for (auto &entry : entries_) {
+        Header header;
+        header.key.assign(bytes_.data() + entry.key_off, entry.key_len);
+        header.value.assign(bytes_.data() + entry.value_off, entry.value_len);
+        headers.push_back(std::move(header));
+    }
+}
+
+/*static*/ uint32_t HeaderArena::hash(const char *s, size_t n) {
+    // FNV-1a of the lowercase key, so that lookup is case insensitive
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (uint8_t)ascii_tolower(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
 ResponseParserNg::ResponseParserNg(SharedPtr<Logger> logger) {
     logger_ = logger;
     http_parser_settings_init(&settings_);
@@ -11,7 +11,10 @@
 #include "src/libmeasurement_kit/common/non_movable.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
 
+#include <stdint.h>
+
 #include <type_traits>
+#include <vector>
 
 namespace mk {
 namespace http {
@@ -23,6 +26,52 @@ enum class HeaderParserState {
     VALUE = 2,
 };
 
+/*
+ * Stores the headers of the response being parsed one after the other into
+ * a single string, so that parsing headers does not allocate a string per
+ * field and value. Lookup is case insensitive and compares precomputed
+ * hashes of the keys before comparing the keys themselves.
+ */
+class HeaderArena {
+  public:
+    void clear() {
+        bytes_.clear();
+        entries_.clear();
+    }
+
+    void append(HeaderParserState prev, HeaderParserState cur, const char *s,
+                size_t n);
+
+    void finish();
+
+    size_t size() const { return entries_.size(); }
+
+    /*
+     * The returned pointers point into the arena and are only valid until
+     * the arena is modified. Values are not zero terminated.
+     */
+    const char *key(size_t idx, size_t *len) const;
+    const char *value(size_t idx, size_t *len) const;
+    const char *find_first(const std::string &key, size_t *len) const;
+
+    void copy_to(Headers &headers) const;
+
+    static uint32_t hash(const char *s, size_t n);
+
+  private:
+    class Entry {
+      public:
+        size_t key_off = 0;
+        size_t key_len = 0;
+        size_t value_off = 0;
+        size_t value_len = 0;
+        uint32_t key_hash = 0;
+    };
+
+    std::string bytes_;
+    std::vector<Entry> entries_;
+};
+
 class ResponseParserNg : public NonCopyable, public NonMovable {
   public:
     ResponseParserNg(SharedPtr<Logger>);
@@ -33,22 +82,41 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
 
     void on_body(std::function<void(std::string)> fn) { body_fn_ = fn; }
 
+    /*
+     * Like on_body() but passes the consumer a pointer into the data that
+     * is being parsed, which is only valid during the callback, instead of
+     * copying each body fragment into a string.
+     */
+    void on_body_data(std::function<void(const char *, size_t)> fn) {
+        body_data_fn_ = fn;
+    }
+
     void on_end(std::function<void()> fn) { end_fn_ = fn; }
 
+    /*
+     * Headers of the current response. They are complete when the function
+     * passed to on_response() is called and are cleared when a new message
+     * begins. Allows to inspect headers without copying them.
+     */
+    const HeaderArena &headers() const { return headers_; }
+
+    // Parses the extents of `data` in place and then drains `data`.
     void feed(Buffer &data) {
-        buffer_ << data;
-        parse();
+        try {
+            data.for_each([this](const void *p, size_t n) {
+                parser_execute(p, n);
+                return true;
+            });
+        } catch (...) {
+            data.discard();
+            throw;
+        }
+        data.discard();
     }
 
-    void feed(std::string data) {
-        buffer_ << data;
-        parse();
-    }
+    void feed(std::string data) { parser_execute(data.data(), data.size()); }
 
-    void feed(const char c) {
-        buffer_.write((const void *)&c, 1);
-        parse();
-    }
+    void feed(const char c) { parser_execute(&c, 1); }
 
     void eof() { parser_execute(nullptr, 0); }
 
@@ -56,8 +124,7 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
         logger_->debug2("http: BEGIN");
         response_ = Response();
         prev_ = HeaderParserState::NOTHING;
-        field_ = "";
-        value_ = "";
+        headers_.clear();
         if (begin_fn_) {
             begin_fn_();
         }
@@ -84,9 +151,8 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
 
     int do_headers_complete_() {
         logger_->debug2("http: HEADERS_COMPLETE");
-        if (field_ != "") { // Also copy last header
-            headers_push_back(response_.headers, field_, value_);
-        }
+        headers_.finish();
+        headers_.copy_to(response_.headers);
         response_.http_major = parser_.http_major;
         response_.status_code = parser_.status_code;
         response_.http_minor = parser_.http_minor;
@@ -94,11 +160,13 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
         sst << "HTTP/" << response_.http_major << "." << response_.http_minor
             << " " << response_.status_code << " " << response_.reason;
         response_.response_line = sst.str();
-        logger_->debug("< %s", response_.response_line.c_str());
-        for (auto h : response_.headers) {
-            logger_->debug("< %s: %s", h.key.c_str(), h.value.c_str());
+        if (logger_->get_verbosity() >= MK_LOG_DEBUG) {
+            logger_->debug("< %s", response_.response_line.c_str());
+            for (auto &h : response_.headers) {
+                logger_->debug("< %s: %s", h.key.c_str(), h.value.c_str());
+            }
+            logger_->debug("<");
         }
-        logger_->debug("<");
         if (response_fn_) {
             response_fn_(response_);
         }
@@ -107,6 +175,9 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
 
     int do_body_(const char *s, size_t n) {
         logger_->debug2("http: BODY");
+        if (body_data_fn_) {
+            body_data_fn_(s, n);
+        }
         if (body_fn_) {
             body_fn_(std::string(s, n));
         }
@@ -133,53 +204,24 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
     Delegate<> begin_fn_;
     Delegate<Response> response_fn_;
     Delegate<std::string> body_fn_;
+    // Not a Delegate because Delegate copies the closure on each call
+    std::function<void(const char *, size_t)> body_data_fn_;
     Delegate<> end_fn_;
 
     SharedPtr<Logger> logger_;
     http_parser parser_;
     http_parser_settings settings_;
-    Buffer buffer_;
 
     // Variables used during parsing
     Response response_;
     HeaderParserState prev_ = HeaderParserState::NOTHING;
-    std::string field_;
-    std::string value_;
+    HeaderArena headers_;
 
     void do_header_internal(HeaderParserState cur, const char *s, size_t n) {
-        using HPS = HeaderParserState;
-        //
-        // This implements the finite state machine described by the
-        // documentation of joyent/http-parser.
-        //
-        // See github.com/joyent/http-parser/blob/master/README.md#callbacks
-        //
-        if (prev_ == HPS::NOTHING && cur == HPS::FIELD) {
-            field_ = std::string(s, n);
-        } else if (prev_ == HPS::VALUE && cur == HPS::FIELD) {
-            headers_push_back(response_.headers, field_, value_);
-            field_ = std::string(s, n);
-        } else if (prev_ == HPS::FIELD && cur == HPS::FIELD) {
-            field_.append(s, n);
-        } else if (prev_ == HPS::FIELD && cur == HPS::VALUE) {
-            value_ = std::string(s, n);
-        } else if (prev_ == HPS::VALUE && cur == HPS::VALUE) {
-            value_.append(s, n);
-        } else {
-            throw HeaderParserInternalError();
-        }
+        headers_.append(prev_, cur, s, n);
         prev_ = cur;
     }
 
-    void parse() {
-        size_t total = 0;
-        buffer_.for_each([&](const void *p, size_t n) {
-            total += parser_execute(p, n);
-            return true;
-        });
-        buffer_.discard(total);
-    }
-
     size_t parser_execute(const void *p, size_t n) {
         size_t x =
             http_parser_execute(&parser_, &settings_, (const char *)p, n);
@@ -132,6 +132,23 @@ struct Context {
     SharedPtr<Transport> txp;
 };
 
+// Parameters of a C2S or S2C test, sent by the server along with the
+// TEST_PREPARE message. Only the port is sent for the non extended tests.
+struct Params {
+    int port = -1;
+    double duration = 10.0;      // only used by C2S
+    bool snaps_enabled = false;  // we always take snaps, never report them
+    double snaps_delay = 0.5;    // we ignore what is sent by the server
+    double snaps_offeset = 0.0;  // ignored by our implementation
+    int num_streams = 1;
+
+    Params(){}
+
+    // This constructor only sets the port and all the other settings
+    // instead remain at their default value
+    Params(int port) : port(port) {}
+};
+
 /*
  __  __
 |  \/  | ___  ___ ___  __ _  __ _  ___  ___
@@ -151,6 +168,8 @@ void read_json(SharedPtr<Context> ctx, Callback<Error, uint8_t, nlohmann::json>
 void read_msg(SharedPtr<Context> ctx, Callback<Error, uint8_t, std::string> callback,
               SharedPtr<Reactor> reactor);
 
+Error parse_test_prepare(std::string s, Params &params, SharedPtr<Logger> logger);
+
 ErrorOr<Buffer> format_msg_extended_login(unsigned char tests);
 ErrorOr<Buffer> format_test_msg(std::string s);
 ErrorOr<Buffer> format_msg_waiting();
@@ -197,7 +216,7 @@ void disconnect_and_callback(SharedPtr<Context> ctx, Error err);
 */
 namespace test_c2s {
 
-void coroutine(SharedPtr<nlohmann::json>, std::string address, int port, double runtime,
+void coroutine(SharedPtr<nlohmann::json>, std::string address, Params params,
                Callback<Error, Continuation<Error>> cb, double timeout,
                Settings settings, SharedPtr<Reactor> reactor,
                SharedPtr<Logger> logger);
@@ -233,20 +252,7 @@ void run(SharedPtr<Context> ctx, Callback<Error> callback);
 */
 namespace test_s2c {
 
-struct Params {
-    int port = -1;
-    double duration = 10.0;      // ignored by our implementation
-    bool snaps_enabled = false;  // we always take snaps, never report them
-    double snaps_delay = 0.5;    // we ignore what is sent by the server
-    double snaps_offeset = 0.0;  // ignored by our implementation
-    int num_streams = 1;
-
-    Params(){}
-
-    // This constructor only sets the port and all the other settings
-    // instead remain at their default value
-    Params(int port) : port(port) {}
-};
+using ndt::Params;
 
 void coroutine(SharedPtr<nlohmann::json> report_entry, std::string address, Params params,
                Callback<Error, Continuation<Error, double>> cb,
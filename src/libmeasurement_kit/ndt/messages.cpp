@@ -26,6 +26,48 @@ void read_msg(SharedPtr<Context> ctx, Callback<Error, uint8_t, std::string> cb,
     read_msg_impl(ctx, cb, reactor);
 }
 
+Error parse_test_prepare(std::string s, Params &params, SharedPtr<Logger> logger) {
+    std::vector<std::string> vec = split<std::vector<std::string>>(s);
+    ErrorOr<int> port = lexical_cast_noexcept<int>(vec[0]);
+    if (!port || *port < 0 || *port > 65535) {
+        logger->warn("Received invalid port: %s", vec[0].c_str());
+        return InvalidPortError();
+    }
+    params.port = *port;
+    // Here we are being liberal; in theory we should only accept these
+    // extra parameters when the test is S2C_EXT or C2S_EXT
+    if (vec.size() >= 2) {
+        ErrorOr<double> duration = lexical_cast_noexcept<double>(vec[1]);
+        if (!duration or *duration < 0 or *duration > 60000.0) {
+            logger->warn("Received invalid duration: %s", vec[1].c_str());
+            return InvalidDurationError();
+        }
+        params.duration = *duration / 1000.0;
+    }
+    logger->debug("Duration: %f s", params.duration);
+    logger->debug("Snaps-enabled: /* ignored */"); // TODO: implement
+    if (vec.size() >= 4) {
+        ErrorOr<double> snaps_delay = lexical_cast_noexcept<double>(vec[3]);
+        if (!snaps_delay or *snaps_delay < 250.0) {
+            logger->warn("Received invalid snaps-delay: %s", vec[3].c_str());
+            return InvalidSnapsDelayError();
+        }
+        params.snaps_delay = *snaps_delay / 1000.0;
+    }
+    logger->debug("Snaps-delay: %f s", params.snaps_delay);
+    logger->debug("Snaps-offset: /* ignored */"); // TODO: implement
+    if (vec.size() >= 6) {
+        ErrorOr<int> num_streams = lexical_cast_noexcept<int>(vec[5]);
+        if (!num_streams or *num_streams < 1 or *num_streams > 8) {
+            logger->warn("Received invalid num-streams: %s", vec[5].c_str());
+            return InvalidNumStreamsError();
+        }
+        params.num_streams = *num_streams;
+    }
+    logger->debug("Num-streams: %d", params.num_streams);
+    return NoError();
+}
+
 ErrorOr<Buffer> format_msg_extended_login(unsigned char tests) {
     return format_any(MSG_EXTENDED_LOGIN, nlohmann::json{
                           {"msg", MSG_NDT_VERSION},
@@ -197,7 +197,7 @@ void run_tests_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
     }
 
     std::function<void(SharedPtr<Context>, Callback<Error>)> func;
-    if (*num == TEST_C2S) {
+    if (*num == TEST_C2S or *num == TEST_C2S_EXT) {
         func = test_c2s_run;
     } else if (*num == TEST_META) {
         func = test_meta_run;
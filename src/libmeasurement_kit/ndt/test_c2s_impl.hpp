@@ -8,76 +8,126 @@
 
 #include "../ndt/internal.hpp"
 
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+
 namespace mk {
 namespace ndt {
 namespace test_c2s {
 
-template <MK_MOCK_AS(net::connect, net_connect)>
-void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address, int port, double runtime,
+// Size of the random data that all the streams send over and over. Each
+// stream keeps between one and two references to it in its output queue, so
+// that the kernel always has data to send and we are woken up once per
+// chunk rather than once every few kilobytes.
+constexpr size_t chunk_size = 1 << 16;
+
+// Tells libevent to call the flush callback as soon as there is less than
+// `low` bytes left to send, instead of when there is nothing left to send
+static inline void set_write_low_watermark(SharedPtr<Transport> txp,
+                                           size_t low) {
+    bufferevent *bev = nullptr;
+    try {
+        bev = txp->get_bufferevent();
+    } catch (const std::runtime_error &) {
+        return; // Not a libevent transport (e.g. in regress tests)
+    }
+    if (bev != nullptr) {
+        bufferevent_setwatermark(bev, EV_WRITE, low, 0);
+    }
+}
+
+static inline void write_chunk(SharedPtr<Transport> txp,
+                               SharedPtr<std::string> chunk) {
+    Buffer buff;
+    buff.write_reference(chunk);
+    txp->write(buff);
+}
+
+template <MK_MOCK_AS(net::connect_many, net_connect_many)>
+void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address, Params params,
                     Callback<Error, Continuation<Error>> cb, double timeout,
                     Settings settings, SharedPtr<Reactor> reactor,
                     SharedPtr<Logger> logger) {
 
-    // Performance note: This implementation does some string copies
-    // when sending but in localhost testing this does not seem to be
-    // a problem when sending against a MK based discard server.
-    //
-    // Otherwise, a possible improvement would be to have a fixed
-    // size buffer and bypass bufferevent's output logic.
-    //
-    // In my tests (where speed of course depends on the computer you
-    // use), I was able to send at over 1.1 GiB/s and similar speeds
-    // were achieved using stripped down NDT code from `test_c2s_clt.c`.
+    // Performance note: all streams share the same chunk of random data
+    // and queue references to it, so we never copy data when sending. In
+    // my tests (where speed of course depends on the computer you use), I
+    // was able to send at over 1.1 GiB/s with a single stream and copies of
+    // an 8 KiB buffer, hence the bottleneck was the number of wakeups.
 
     dump_settings(settings, "ndt/c2s", logger);
 
-    std::string str = random_printable(8192);
+    SharedPtr<std::string> chunk{
+        std::make_shared<std::string>(random_printable(chunk_size))};
 
     logger->debug("ndt: connect ...");
-    net_connect(address, port,
-                [=](Error err, SharedPtr<Transport> txp) {
-                    logger->debug("ndt: connect ... %d", (int)err);
-                    if (err) {
-                        cb(err, nullptr);
-                        return;
-                    }
-                    (*report_entry)["connect_times"].push_back(txp->connect_time());
-                    logger->info("Connected to %s:%d", address.c_str(), port);
-                    logger->debug("ndt: suspend coroutine");
-                    cb(NoError(), [=](Callback<Error> cb) {
-                        double begin = time_now();
-                        SharedPtr<MeasureSpeed> snap{std::make_shared<MeasureSpeed>(0.5)};
-                        logger->debug("ndt: resume coroutine");
-                        logger->info("Starting upload");
-                        txp->set_timeout(timeout);
-                        txp->on_flush([=]() {
-                            double now = time_now();
+    net_connect_many(
+        address, params.port, params.num_streams,
+        [=](Error err, std::vector<SharedPtr<Transport>> txp_list) {
+            logger->debug("ndt: connect ... %d", (int)err);
+            if (err) {
+                cb(err, nullptr);
+                return;
+            }
+            for (auto &txp : txp_list) {
+                (*report_entry)["connect_times"].push_back(txp->connect_time());
+            }
+            logger->info("Connected to %s:%d", address.c_str(), params.port);
+            logger->debug("ndt: suspend coroutine");
+            cb(NoError(), [=](Callback<Error> cb) {
+                double begin = time_now();
+                // Snapshots aggregate what all the streams have sent
+                SharedPtr<MeasureSpeed> snap{std::make_shared<MeasureSpeed>(0.5)};
+                SharedPtr<size_t> num_completed{std::make_shared<size_t>(0)};
+                size_t num_flows = txp_list.size();
+                logger->debug("ndt: resume coroutine");
+                logger->info("Starting upload");
+                (*report_entry)["params"]["num_streams"] = params.num_streams;
+
+                for (auto txp : txp_list) {
+                    txp->set_timeout(timeout);
+                    set_write_low_watermark(txp, chunk->size());
+                    txp->on_flush([=]() {
+                        // We get here when less than a chunk is left in
+                        // the queue, i.e. at least a chunk has been sent
+                        snap->total += chunk->size();
+                        double now = time_now();
+                        if (*num_completed == 0) {
                             snap->maybe_speed(now, [&](double el, double x) {
-                                log_speed(logger, "upload-speed", 1, el, x);
+                                log_speed(logger, "upload-speed",
+                                          params.num_streams, el, x);
                                 (*report_entry)["sender_data"].push_back({
                                     el, x
                                 });
                             });
-                            if (now - begin > runtime) {
-                                logger->info("Elapsed enough time");
-                                txp->emit_error(NoError());
+                        }
+                        if (now - begin > params.duration) {
+                            logger->info("Elapsed enough time");
+                            txp->emit_error(NoError());
+                            return;
+                        }
+                        write_chunk(txp, chunk);
+                    });
+                    txp->on_error([=](Error err) {
+                        logger->info("Ending upload (%d)", (int)err);
+                        txp->close([=]() {
+                            logger->info("Connection to %s:%d closed",
+                                         address.c_str(), params.port);
+                            ++(*num_completed);
+                            // See test_s2c_impl.hpp on why here we use
+                            // num_flows rather than txp_list.size()
+                            if (*num_completed < num_flows) {
                                 return;
                             }
-                            txp->write(str.data(), str.size());
-                            snap->total += str.size();
+                            cb((num_flows == 1) ? err : NoError());
                         });
-                        txp->on_error([=](Error err) {
-                            logger->info("Ending upload (%d)", (int)err);
-                            txp->close([=]() {
-                                logger->info("Connection to %s:%d closed",
-                                             address.c_str(), port);
-                                cb(err);
-                            });
-                        });
-                        txp->write(str.data(), str.size());
                     });
-                },
-                settings, reactor, logger);
+                    write_chunk(txp, chunk);
+                    write_chunk(txp, chunk);
+                }
+            });
+        },
+        settings, reactor, logger);
 }
 
 template <MK_MOCK_AS(messages::read_msg, messages_read_msg_first),
@@ -99,22 +149,26 @@ void run_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
             callback(NotTestPrepareError());
             return;
         }
-        ErrorOr<int> port = lexical_cast_noexcept<int>(s);
-        if (!port || *port < 0 || *port > 65535) {
-            callback(InvalidPortError());
+        // The duration and the number of streams are only sent by the
+        // server when the test is C2S_EXT
+        Params params;
+        params.duration = TEST_C2S_DURATION;
+        err = messages::parse_test_prepare(s, params, ctx->logger);
+        if (err) {
+            callback(err);
             return;
         }
 
         SharedPtr<nlohmann::json> cur_entry{std::make_shared<nlohmann::json>()};
         (*cur_entry)["connect_times"] = nlohmann::json::array();
-        (*cur_entry)["params"] = {{"num_streams", 1}};
+        (*cur_entry)["params"] = {{"num_streams", params.num_streams}};
         (*cur_entry)["receiver_data"] = {{"avg_speed", nullptr}};
         (*cur_entry)["sender_data"] = nlohmann::json::array();
 
         // We connect to the port and wait for coroutine to pause
         ctx->logger->debug("ndt: start c2s coroutine ...");
         coroutine(
-            cur_entry, ctx->address, *port, TEST_C2S_DURATION,
+            cur_entry, ctx->address, params,
             [=](Error err, Continuation<Error> cc) {
                 ctx->logger->debug("ndt: start c2s coroutine ... %d", (int)err);
                 if (err) {
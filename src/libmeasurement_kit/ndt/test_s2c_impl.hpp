@@ -157,51 +157,11 @@ void run_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
             return;
         }
         Params params;
-        std::vector<std::string> vec = split<std::vector<std::string>>(s);
-        ErrorOr<int> port = lexical_cast_noexcept<int>(vec[0]);
-        if (!port || *port < 0 || *port > 65535) {
-            ctx->logger->warn("Received invalid port: %s", vec[0].c_str());
-            callback(InvalidPortError());
+        err = messages::parse_test_prepare(s, params, ctx->logger);
+        if (err) {
+            callback(err);
             return;
         }
-        params.port = *port;
-        // Here we are being liberal; in theory we should only accept these
-        // extra parameters when the test is S2C_EXT
-        if (vec.size() >= 2) {
-            ErrorOr<double> duration = lexical_cast_noexcept<double>(vec[1]);
-            if (!duration or *duration < 0 or *duration > 60000.0) {
-                ctx->logger->warn("Received invalid duration: %s",
-                                  vec[1].c_str());
-                callback(InvalidDurationError());
-                return;
-            }
-            params.duration = *duration / 1000.0;
-        }
-        ctx->logger->debug("Duration: %f s", params.duration);
-        ctx->logger->debug("Snaps-enabled: /* ignored */"); // TODO: implement
-        if (vec.size() >= 4) {
-            ErrorOr<double> snaps_delay = lexical_cast_noexcept<double>(vec[3]);
-            if (!snaps_delay or *snaps_delay < 250.0) {
-                ctx->logger->warn("Received invalid snaps-delay: %s",
-                                  vec[3].c_str());
-                callback(InvalidSnapsDelayError());
-                return;
-            }
-            params.snaps_delay = *snaps_delay / 1000.0;
-        }
-        ctx->logger->debug("Snaps-delay: %f s", params.snaps_delay);
-        ctx->logger->debug("Snaps-offset: /* ignored */"); // TODO: implement
-        if (vec.size() >= 6) {
-            ErrorOr<int> num_streams = lexical_cast_noexcept<int>(vec[5]);
-            if (!num_streams or *num_streams < 1 or *num_streams > 8) {
-                ctx->logger->warn("Received invalid num-streams: %s",
-                                  vec[5].c_str());
-                callback(InvalidNumStreamsError());
-                return;
-            }
-            params.num_streams = *num_streams;
-        }
-        ctx->logger->debug("Num-streams: %d", params.num_streams);
 
         SharedPtr<nlohmann::json> cur_entry{std::make_shared<nlohmann::json>()};
         (*cur_entry)["web100_data"] = nlohmann::json::object();
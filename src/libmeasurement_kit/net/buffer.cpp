@@ -60,16 +60,36 @@ Buffer &Buffer::operator>>(Buffer &dest) {
 size_t Buffer::length() { return evbuffer_get_length(evbuf.get()); }
 
 void Buffer::for_each(std::function<bool(const void *, size_t)> fn) {
-    auto required = evbuffer_peek(evbuf.get(), -1, nullptr, nullptr, 0);
-    if (required < 0) throw std::runtime_error("unexpected error");
-    if (required == 0) return;
-    std::unique_ptr<evbuffer_iovec[]> raii;
-    raii.reset(new evbuffer_iovec[required]); // Guarantee cleanup
-    auto iov = raii.get();
-    auto used = evbuffer_peek(evbuf.get(), -1, nullptr, iov, required);
-    if (used != required) throw std::runtime_error("unexpected error");
-    for (auto i = 0; i < required && fn(iov[i].iov_base, iov[i].iov_len); ++i) {
-        /* nothing */;
+    /*
+     * Walk the extents in batches using an array on the stack rather than
+     * allocating an array as large as the number of extents, so that feeding
+     * a parser does not cost one allocation per received chunk.
+     */
+    constexpr int batch = 16;
+    evbuffer_iovec iov[batch];
+    evbuffer_ptr ptr;
+    evbuffer_ptr *start_at = nullptr;
+    size_t offset = 0;
+    for (;;) {
+        // Note: when `len` is negative, evbuffer_peek() returns at most
+        // `batch` even if there are more extents to walk through.
+        auto used = evbuffer_peek(evbuf.get(), -1, start_at, iov, batch);
+        if (used < 0 || used > batch) {
+            throw std::runtime_error("unexpected error");
+        }
+        for (auto i = 0; i < used; ++i) {
+            if (!fn(iov[i].iov_base, iov[i].iov_len)) {
+                return;
+            }
+            offset += iov[i].iov_len;
+        }
+        if (used < batch || offset >= length()) {
+            return;
+        }
+        if (evbuffer_ptr_set(evbuf.get(), &ptr, offset, EVBUFFER_PTR_SET) != 0) {
+            throw std::runtime_error("evbuffer_ptr_set failed");
+        }
+        start_at = &ptr;
     }
 }
 
@@ -202,5 +222,19 @@ void Buffer::write(size_t count, std::function<size_t(void *, size_t)> func) {
     if (ctrl != 0) throw std::runtime_error("evbuffer_add_reference");
 }
 
+void Buffer::write_reference(SharedPtr<std::string> data) {
+    if (data->empty()) return;
+    auto holder = new SharedPtr<std::string>(data);
+    auto ctrl = evbuffer_add_reference(
+        evbuf.get(), data->data(), data->size(),
+        [](const void *, size_t, void *p) {
+            delete static_cast<SharedPtr<std::string> *>(p);
+        }, holder);
+    if (ctrl != 0) {
+        delete holder;
+        throw std::runtime_error("evbuffer_add_reference");
+    }
+}
+
 } // namespace net
 } // namespace mk
@@ -117,6 +117,13 @@ class Buffer {
 
     void write(size_t count, std::function<size_t(void *, size_t)> func);
 
+    /*
+     * Appends a reference to `data` rather than a copy of it, so that many
+     * buffers may share the same bytes, which are kept alive until all the
+     * buffers referencing them have been drained.
+     */
+    void write_reference(SharedPtr<std::string> data);
+
     SharedPtr<evbuffer> evbuf;
 };
 
@@ -175,18 +175,10 @@ void connect_many(std::string address, int port, int num,
         address, port, num, callback, settings, reactor, logger));
 }
 
-void connect(std::string address, int port,
+static void connect_with_slot(std::string address, int port,
              Callback<Error, SharedPtr<Transport>> callback, Settings settings,
-             SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
-    if (settings.find("net/dumb_transport") != settings.end()) {
-        callback(NoError(), make_txp<Emitter>(
-            0.0, nullptr, reactor, logger));
-        return;
-    }
-    if (settings.find("net/socks5_proxy") != settings.end()) {
-        socks5_connect(address, port, settings, callback, reactor, logger);
-        return;
-    }
+             SharedPtr<Reactor> reactor, SharedPtr<Logger> logger,
+             SharedPtr<ConnectionGovernor::Slot> slot) {
     if (settings.find("net/timeout") == settings.end()) {
         settings["net/timeout"] = 30.0;
     }
@@ -199,6 +191,8 @@ void connect(std::string address, int port,
                     timeout, r, reactor, logger));
                 return;
             }
+            r->governor_slot = slot;
+            slot->connected();
             if (settings.find("net/ssl") != settings.end()) {
                 std::string cbp;
                 if (settings.find("net/ca_bundle_path") == settings.end()) {
@@ -277,5 +271,27 @@ void connect(std::string address, int port,
         settings, reactor, logger);
 }
 
+void connect(std::string address, int port,
+             Callback<Error, SharedPtr<Transport>> callback, Settings settings,
+             SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    if (settings.find("net/dumb_transport") != settings.end()) {
+        callback(NoError(), make_txp<Emitter>(
+            0.0, nullptr, reactor, logger));
+        return;
+    }
+    // Not governed, since the proxy (i.e. Tor) usually runs locally
+    if (settings.find("net/socks5_proxy") != settings.end()) {
+        socks5_connect(address, port, settings, callback, reactor, logger);
+        return;
+    }
+    auto priority = ConnectionGovernor::priority_from_string(
+        settings.get("net/connect_priority", std::string{}));
+    reactor->connection_governor()->acquire(priority, reactor,
+        [=](SharedPtr<ConnectionGovernor::Slot> slot) {
+            connect_with_slot(address, port, callback, settings, reactor,
+                              logger, slot);
+        });
+}
+
 } // namespace net
 } // namespace mk
@@ -4,6 +4,7 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_NET_CONNECT_HPP
 #define SRC_LIBMEASUREMENT_KIT_NET_CONNECT_HPP
 
+#include "src/libmeasurement_kit/common/connection_governor.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/dns/resolve_hostname.hpp"
 #include "src/libmeasurement_kit/net/transport.hpp"
@@ -28,6 +29,8 @@ class ConnectResult {
     std::vector<Error> connect_result;
     double connect_time = 0.0;
     bufferevent *connected_bev = nullptr;
+    // Handed over by make_txp() to the transport, which owns the socket
+    SharedPtr<ConnectionGovernor::Slot> governor_slot;
 };
 
 typedef std::function<void(std::vector<Error>, bufferevent *)> ConnectFirstOfCb;
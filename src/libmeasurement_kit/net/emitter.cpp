@@ -27,6 +27,7 @@ void EmitterBase::close(Callback<> cb) {
         throw std::runtime_error("close already pending");
     }
     close_pending = true;
+    governor_slot = nullptr; // Let another connect proceed
     shutdown();
     on_connect(nullptr);
     on_data(nullptr);
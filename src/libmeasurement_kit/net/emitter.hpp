@@ -238,6 +238,10 @@ class EmitterBase : public Transport {
         saved_dns_result = x;
     }
 
+    void set_governor_slot_(SharedPtr<ConnectionGovernor::Slot> x) override {
+        governor_slot = x;
+    }
+
     Endpoint sockname() override { return {}; }
     Endpoint peername() override { return {}; }
 
@@ -261,6 +265,7 @@ class EmitterBase : public Transport {
     double saved_connect_time = 0.0;
     std::vector<Error> saved_connect_errors;
     dns::ResolveHostnameResult saved_dns_result;
+    SharedPtr<ConnectionGovernor::Slot> governor_slot; /* Released on close */
 };
 
 class Emitter : public EmitterBase {
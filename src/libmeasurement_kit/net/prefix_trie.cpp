@@ -0,0 +1,90 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/net/prefix_trie.hpp"
+
+#include <measurement_kit/common/aaa_base.h>
+
+namespace mk {
+namespace net {
+
+// Parses `ip` into `addr`, which must be 16 bytes long, and returns the
+// number of bits of the address (32 or 128), or zero if `ip` is not valid.
+static int parse_address(const char *ip, uint8_t *addr) {
+    if (inet_pton(AF_INET, ip, addr) == 1) {
+        return 32;
+    }
+    if (inet_pton(AF_INET6, ip, addr) == 1) {
+        return 128;
+    }
+    return 0;
+}
+
+static int bit_at(const uint8_t *addr, int index) {
+    return (addr[index / 8] >> (7 - index % 8)) & 1;
+}
+
+PrefixTrie::PrefixTrie() : ipv4_(1), ipv6_(1) {}
+
+Error PrefixTrie::add(const std::string &cidr) {
+    std::string address = cidr;
+    int prefix = -1;
+    size_t slash = cidr.find('/');
+    if (slash != std::string::npos) {
+        address = cidr.substr(0, slash);
+        std::string digits = cidr.substr(slash + 1);
+        if (digits.empty() || digits.size() > 3 ||
+            digits.find_first_not_of("0123456789") != std::string::npos) {
+            return ValueError();
+        }
+        prefix = std::stoi(digits);
+    }
+    uint8_t addr[16];
+    int bits = parse_address(address.c_str(), addr);
+    if (bits == 0 || prefix > bits) {
+        return ValueError();
+    }
+    if (prefix < 0) {
+        prefix = bits;
+    }
+    std::vector<Node> &nodes = (bits == 32) ? ipv4_ : ipv6_;
+    uint32_t cur = 0;
+    for (int i = 0; i < prefix; ++i) {
+        int bit = bit_at(addr, i);
+        if (nodes[cur].child[bit] == 0) {
+            nodes[cur].child[bit] = (uint32_t)nodes.size();
+            nodes.emplace_back(); // Invalidates references into `nodes`
+        }
+        cur = nodes[cur].child[bit];
+    }
+    if (!nodes[cur].terminal) {
+        nodes[cur].terminal = true;
+        count_ += 1;
+    }
+    return NoError();
+}
+
+int PrefixTrie::longest_prefix(const std::string &ip) const {
+    uint8_t addr[16];
+    int bits = parse_address(ip.c_str(), addr);
+    if (bits == 0) {
+        return -1;
+    }
+    const std::vector<Node> &nodes = (bits == 32) ? ipv4_ : ipv6_;
+    int longest = nodes[0].terminal ? 0 : -1;
+    uint32_t cur = 0;
+    for (int i = 0; i < bits; ++i) {
+        cur = nodes[cur].child[bit_at(addr, i)];
+        if (cur == 0) {
+            break;
+        }
+        if (nodes[cur].terminal) {
+            longest = i + 1;
+        }
+    }
+    return longest;
+}
+
+} // namespace net
+} // namespace mk
@@ -0,0 +1,57 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NET_PREFIX_TRIE_HPP
+#define SRC_LIBMEASUREMENT_KIT_NET_PREFIX_TRIE_HPP
+
+#include "src/libmeasurement_kit/common/error.hpp"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace mk {
+namespace net {
+
+/*
+ * Set of IPv4 and IPv6 networks in CIDR notation that tells which network
+ * contains an address by walking a binary trie, one bit of the address at
+ * a time. Build it once with add(), then each lookup costs at most one step
+ * per bit of the longest matching prefix and does not allocate.
+ */
+class PrefixTrie {
+  public:
+    PrefixTrie();
+
+    // Adds `cidr` (e.g. "10.0.0.0/8", "2a03:2880::/32" or a bare address,
+    // which is a host network), returning ValueError if it is not valid
+    Error add(const std::string &cidr);
+
+    // Returns the length of the longest prefix in the set containing `ip`,
+    // or -1 if no prefix contains it or `ip` is not a valid address
+    int longest_prefix(const std::string &ip) const;
+
+    bool contains(const std::string &ip) const {
+        return longest_prefix(ip) >= 0;
+    }
+
+    // Number of networks that have been added
+    size_t size() const { return count_; }
+
+  private:
+    class Node {
+      public:
+        uint32_t child[2] = {0, 0}; /* Zero means no child */
+        bool terminal = false;
+    };
+
+    // Separate tries for the two families, whose root is at index zero
+    std::vector<Node> ipv4_;
+    std::vector<Node> ipv6_;
+    size_t count_ = 0;
+};
+
+} // namespace net
+} // namespace mk
+#endif
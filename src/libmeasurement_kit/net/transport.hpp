@@ -4,6 +4,7 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_NET_TRANSPORT_HPP
 #define SRC_LIBMEASUREMENT_KIT_NET_TRANSPORT_HPP
 
+#include "src/libmeasurement_kit/common/connection_governor.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
 #include "src/libmeasurement_kit/net/buffer.hpp"
 #include "src/libmeasurement_kit/net/utils.hpp"
@@ -112,6 +113,8 @@ class TransportConnectable {
     virtual void set_connect_errors_(std::vector<Error>) = 0;
     virtual dns::ResolveHostnameResult dns_result() = 0;
     virtual void set_dns_result_(dns::ResolveHostnameResult) = 0;
+    // Keeps the slot, which counts the socket as open, until closed
+    virtual void set_governor_slot_(SharedPtr<ConnectionGovernor::Slot>) = 0;
 };
 
 class TransportSockNamePeerName {
@@ -0,0 +1,103 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/nettests/checkpoint.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+namespace mk {
+namespace nettests {
+
+/* static */ std::string Checkpoint::path_for(
+        const std::string &output_filepath) {
+    return output_filepath + ".checkpoint";
+}
+
+bool Checkpoint::load(const std::string &path, const std::string &test_name,
+                      SharedPtr<Logger> logger) {
+    resumed = false;
+    done_.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    bool has_header = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line == "") {
+            continue; // See open()
+        }
+        nlohmann::json record;
+        try {
+            record = nlohmann::json::parse(line);
+            if (record.count("done") > 0) {
+                done_.insert(record.at("done").get<size_t>());
+                continue;
+            }
+            if (record.at("test_name").get<std::string>() != test_name) {
+                logger->warn("checkpoint: ignoring checkpoint of another test");
+                done_.clear();
+                return false;
+            }
+            report_id = record.at("report_id").get<std::string>();
+            seed = record.at("seed").get<uint32_t>();
+            has_header = true;
+        } catch (const std::exception &) {
+            logger->warn("checkpoint: skipping invalid line");
+        }
+    }
+    if (!has_header) {
+        done_.clear();
+        return false;
+    }
+    logger->info("Resuming from checkpoint: %lu inputs already measured",
+                 (unsigned long)done_.size());
+    resumed = true;
+    return true;
+}
+
+Error Checkpoint::open(const std::string &path, const std::string &test_name,
+                       bool fsync) {
+    path_ = path;
+    file_.fsync = fsync;
+    file_.append = resumed;
+    Error err = file_.open(path);
+    if (err) {
+        return err;
+    }
+    if (resumed) {
+        // Terminate the line that may have been truncated by a crash
+        file_ << '\n';
+    }
+    return write_({
+        {"report_id", report_id},
+        {"seed", seed},
+        {"test_name", test_name},
+    });
+}
+
+Error Checkpoint::mark_done(size_t index) {
+    done_.insert(index);
+    return write_({{"done", index}});
+}
+
+Error Checkpoint::remove() {
+    Error err = file_.close();
+    if (std::remove(path_.c_str()) != 0 && !err) {
+        err = FileIoError();
+    }
+    return err;
+}
+
+Error Checkpoint::write_(const nlohmann::json &line) {
+    if (!file_.is_open()) {
+        return FileIoError();
+    }
+    file_ << line.dump() << '\n';
+    return file_.end_record();
+}
+
+} // namespace nettests
+} // namespace mk
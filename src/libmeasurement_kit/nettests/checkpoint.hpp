@@ -0,0 +1,68 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_CHECKPOINT_HPP
+#define SRC_LIBMEASUREMENT_KIT_NETTESTS_CHECKPOINT_HPP
+
+#include "src/libmeasurement_kit/common/file_writer.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+namespace mk {
+namespace nettests {
+
+/*
+    Checkpoint of a test run, saved next to the report so that we can resume
+    an interrupted run. It's an append-only file containing one JSON object
+    per line. Lines like
+
+        {"report_id": "", "seed": 0, "test_name": "web_connectivity"}
+
+    tell us about the run, and the last one wins. Lines like `{"done": 17}`
+    mean that the entry of the input with index 17 has been written. A
+    truncated last line, as left by a crash, is ignored. Since indexes refer
+    to the order in which inputs are read, resuming only makes sense with the
+    same inputs and the same shuffle seed.
+*/
+class Checkpoint : public NonCopyable, public NonMovable {
+  public:
+    bool resumed = false; /* Whether load() found a checkpoint */
+    std::string report_id;
+    uint32_t seed = 0;
+
+    static std::string path_for(const std::string &output_filepath);
+
+    // Loads the checkpoint at `path`, if any. A checkpoint of another test
+    // is ignored. Returns whether we have a checkpoint to resume from.
+    bool load(const std::string &path, const std::string &test_name,
+              SharedPtr<Logger> logger);
+
+    // Starts saving the checkpoint, appending to the one that we loaded, if
+    // any. With `fsync` set, each line is on the storage device when we
+    // return from writing it.
+    Error open(const std::string &path, const std::string &test_name,
+               bool fsync);
+
+    bool is_done(size_t index) const { return done_.count(index) > 0; }
+
+    size_t done_count() const { return done_.size(); }
+
+    Error mark_done(size_t index);
+
+    // Closes and removes the checkpoint, once it's no longer needed
+    Error remove();
+
+  private:
+    std::string path_;
+    std::unordered_set<size_t> done_;
+    FileWriter file_;
+
+    Error write_(const nlohmann::json &line);
+};
+
+} // namespace nettests
+} // namespace mk
+#endif
@@ -0,0 +1,91 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/nettests/concurrency.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/http/http.hpp"
+#include "src/libmeasurement_kit/net/utils.hpp"
+
+#include <algorithm>
+
+namespace mk {
+namespace nettests {
+
+ConcurrencyController::ConcurrencyController(size_t parallelism,
+                                             size_t min_parallelism,
+                                             size_t max_parallelism,
+                                             size_t max_parallelism_per_host)
+    : min_{std::max(min_parallelism, (size_t)1)},
+      max_{std::max(max_parallelism, min_)},
+      per_host_{max_parallelism_per_host} {
+    window_ = std::min(std::max(parallelism, min_), max_);
+}
+
+bool ConcurrencyController::can_start(const std::string &host) const {
+    if (per_host_ <= 0 || host == "") {
+        return true;
+    }
+    auto it = hosts_.find(host);
+    return it == hosts_.end() || it->second < per_host_;
+}
+
+void ConcurrencyController::started(const std::string &host) {
+    in_flight_ += 1;
+    if (host != "") {
+        hosts_[host] += 1;
+    }
+}
+
+bool ConcurrencyController::completed(const std::string &host,
+                                      bool timed_out) {
+    if (in_flight_ > 0) {
+        in_flight_ -= 1;
+    }
+    auto it = hosts_.find(host);
+    if (it != hosts_.end() && --it->second <= 0) {
+        hosts_.erase(it);
+    }
+    size_t before = window_;
+    if (recovery_ > 0) {
+        recovery_ -= 1;
+    } else if (timed_out) {
+        window_ = std::max(window_ / 2, min_);
+        successes_ = 0;
+        recovery_ = in_flight_;
+    } else if (++successes_ >= window_) {
+        window_ = std::min(window_ + 1, max_);
+        successes_ = 0;
+    }
+    return window_ != before;
+}
+
+std::string input_host(const std::string &input) {
+    if (input == "") {
+        return "";
+    }
+    if (input.find("://") != std::string::npos) {
+        ErrorOr<http::Url> url = http::parse_url_noexcept(input);
+        return (!!url) ? url->address : input;
+    }
+    ErrorOr<net::Endpoint> epnt = net::parse_endpoint(input, 80);
+    return (!!epnt) ? epnt->hostname : input;
+}
+
+bool measurement_timed_out(const nlohmann::json &test_keys) {
+    if (!test_keys.is_object()) {
+        return false;
+    }
+    for (auto it = test_keys.begin(); it != test_keys.end(); ++it) {
+        if (endswith(it.key(), "failure") && it->is_string() &&
+            it->get_ref<const std::string &>().find("timeout") !=
+                std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace nettests
+} // namespace mk
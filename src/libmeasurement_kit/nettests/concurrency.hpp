@@ -0,0 +1,67 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_CONCURRENCY_HPP
+#define SRC_LIBMEASUREMENT_KIT_NETTESTS_CONCURRENCY_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <map>
+#include <string>
+
+namespace mk {
+namespace nettests {
+
+/*
+ * Decides how many measurements we run in parallel. The limit follows an
+ * AIMD policy: it grows by one after a limit's worth of measurements end
+ * without timing out, and it is halved when a measurement times out, which
+ * we take as a sign of congestion. After halving, we ignore the timeouts
+ * of the measurements that were already running, like TCP does within a
+ * round trip. The limit is always between `min_parallelism` and
+ * `max_parallelism`. We also never run more than `max_parallelism_per_host`
+ * measurements of the same host in parallel, unless it is zero.
+ */
+class ConcurrencyController {
+  public:
+    ConcurrencyController(size_t parallelism, size_t min_parallelism,
+                          size_t max_parallelism,
+                          size_t max_parallelism_per_host);
+
+    // Current limit to the number of measurements in flight
+    size_t limit() const { return window_; }
+
+    size_t in_flight() const { return in_flight_; }
+
+    // Whether we are below the limit of measurements in flight
+    bool can_start() const { return in_flight_ < limit(); }
+
+    // Whether we can start a measurement of `host` without being rude
+    bool can_start(const std::string &host) const;
+
+    void started(const std::string &host);
+
+    // Returns true if the limit has changed as a consequence
+    bool completed(const std::string &host, bool timed_out);
+
+  private:
+    size_t window_;
+    size_t min_;
+    size_t max_;
+    size_t per_host_;
+    size_t in_flight_ = 0;
+    size_t successes_ = 0;
+    size_t recovery_ = 0; /* Completions to ignore after halving */
+    std::map<std::string, size_t> hosts_;
+};
+
+// Returns the host measured with `input`, which may be an URL, an endpoint
+// or a domain name, or the empty string when there is no input
+std::string input_host(const std::string &input);
+
+// Whether any top level failure of `test_keys` is a timeout
+bool measurement_timed_out(const nlohmann::json &test_keys);
+
+} // namespace nettests
+} // namespace mk
+#endif
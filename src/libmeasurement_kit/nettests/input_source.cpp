@@ -0,0 +1,150 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
+#include "src/libmeasurement_kit/nettests/utils_impl.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+namespace mk {
+namespace nettests {
+
+Error InputSource::open(std::deque<std::string> &inputs, bool needs_input,
+                        const std::list<std::string> &input_filepaths,
+                        const std::string &probe_cc, const Settings &options,
+                        SharedPtr<Logger> logger) {
+    logger_ = logger;
+    if (!needs_input) {
+        // See process_input_filepaths_impl() for why we do this
+        if (inputs.size() != 0) {
+            logger->warn("Manually passed input for a test that requires no "
+                         "input; fixing by clearing the input vector");
+            inputs.clear();
+        }
+        window_.push_back("");
+        return NoError();
+    }
+    if (input_filepaths.size() <= 0 && inputs.size() == 0) {
+        logger->warn("at least an input file is required");
+        return ooni::MissingRequiredInputFileError();
+    }
+    std::string probe_cc_lowercase = "";
+    for (auto c : probe_cc) {
+        probe_cc_lowercase += std::tolower(c);
+    }
+
+    // Just make sure that we can open the files and learn their size
+    for (auto input_filepath : input_filepaths) {
+        input_filepath = regexp::replace_probe_cc(std::move(input_filepath),
+                                                  probe_cc_lowercase);
+        SharedPtr<std::istream> input_generator = open_file_(input_filepath);
+        if (!input_generator->good()) {
+            logger->warn("cannot open input file");
+            continue;
+        }
+        input_generator->seekg(0, std::ios_base::end);
+        std::streamoff size = input_generator->tellg();
+        if (size > 0) {
+            total_bytes_ += (uint64_t)size;
+        }
+        paths_.push_back(input_filepath);
+    }
+    manual_ = std::move(inputs);
+    inputs.clear();
+
+    ErrorOr<bool> shuffle = options.get_noexcept<bool>("randomize_input", true);
+    shuffle_ = !!shuffle && *shuffle;
+    if (!has_seed_) {
+        std::random_device rd;
+        set_seed(rd());
+    }
+    rng_.seed(seed_);
+    fill_();
+    if (window_.size() <= 0) {
+        logger->warn("no specified input file could be read");
+        return ooni::CannotReadAnyInputFileError();
+    }
+    if (!shuffle) {
+        logger->warn("invalid 'randomize_input' option");
+        return shuffle.as_error();
+    }
+    return NoError();
+}
+
+bool InputSource::next(std::string &input) {
+    if (window_.size() <= 0) {
+        return false;
+    }
+    if (shuffle_) {
+        std::uniform_int_distribution<size_t> dist(0, window_.size() - 1);
+        std::swap(window_.front(), window_[dist(rng_)]);
+    }
+    input = std::move(window_.front());
+    window_.pop_front();
+    returned_ += 1;
+    fill_();
+    return true;
+}
+
+void InputSource::set_seed(uint32_t seed) {
+    seed_ = seed;
+    has_seed_ = true;
+}
+
+size_t InputSource::estimated_total() const {
+    size_t known = returned_ + window_.size() + manual_.size();
+    if (read_lines_ <= 0 || read_bytes_ >= total_bytes_) {
+        return known;
+    }
+    double average = read_bytes_ / (double)read_lines_;
+    return known + (size_t)((total_bytes_ - read_bytes_) / average);
+}
+
+void InputSource::fill_() {
+    // When not shuffling, we only need to read one line ahead
+    size_t capacity = shuffle_ ? std::max(shuffle_window, (size_t)1) : 1;
+    std::string line;
+    while (window_.size() < capacity) {
+        if (manual_.size() > 0) {
+            window_.push_back(std::move(manual_.front()));
+            manual_.pop_front();
+            continue;
+        }
+        if (!read_line_(line)) {
+            break;
+        }
+        window_.push_back(std::move(line));
+    }
+}
+
+bool InputSource::read_line_(std::string &line) {
+    for (;;) {
+        if (!file_) {
+            if (paths_.size() <= 0) {
+                return false;
+            }
+            file_ = open_file_(paths_.front());
+            paths_.pop_front();
+            if (!file_->good()) {
+                logger_->warn("cannot open input file");
+                file_.reset();
+                continue;
+            }
+        }
+        if (readline_(*file_, line)) {
+            read_bytes_ += line.size() + 1;
+            read_lines_ += 1;
+            return true;
+        }
+        if (!file_->eof()) {
+            logger_->warn("I/O error reading input file");
+        }
+        file_.reset();
+    }
+}
+
+} // namespace nettests
+} // namespace mk
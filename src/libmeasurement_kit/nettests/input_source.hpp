@@ -0,0 +1,78 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_INPUT_SOURCE_HPP
+#define SRC_LIBMEASUREMENT_KIT_NETTESTS_INPUT_SOURCE_HPP
+
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <list>
+#include <random>
+#include <string>
+
+namespace mk {
+namespace nettests {
+
+/*
+ * Source of the inputs of a test that reads the input files lazily, one
+ * line at a time, rather than loading them all before starting.
+ *
+ * When shuffling, the source keeps a window of `shuffle_window` inputs and
+ * returns a random input of the window, which is then refilled with the
+ * next line. Lists not larger than the window are thus shuffled uniformly,
+ * as before, while larger lists are shuffled using bounded memory. Since
+ * we do not know the number of lines in advance, the total number of
+ * inputs is estimated from the size of the files and the average length
+ * of the lines read so far.
+ */
+class InputSource : public NonCopyable, public NonMovable {
+  public:
+    size_t shuffle_window = 16384;
+
+    // Same arguments, semantics and errors of process_input_filepaths(),
+    // except that the files are read as needed by next(). The manually
+    // specified `inputs` are moved into the source.
+    Error open(std::deque<std::string> &inputs, bool needs_input,
+               const std::list<std::string> &input_filepaths,
+               const std::string &probe_cc, const Settings &options,
+               SharedPtr<Logger> logger);
+
+    // Returns false when there is no more input
+    bool next(std::string &input);
+
+    // Estimated number of inputs, including the ones already returned
+    size_t estimated_total() const;
+
+    // Seed used to shuffle the inputs, chosen at random by open() unless it
+    // has been set before. The same seed and inputs yield the same order.
+    uint32_t seed() const { return seed_; }
+    void set_seed(uint32_t seed);
+
+  private:
+    SharedPtr<Logger> logger_ = Logger::make();
+    std::deque<std::string> manual_;
+    std::list<std::string> paths_;
+    SharedPtr<std::istream> file_;
+    std::deque<std::string> window_;
+    std::mt19937 rng_;
+    uint32_t seed_ = 0;
+    bool has_seed_ = false;
+    bool shuffle_ = false;
+    size_t returned_ = 0;
+    uint64_t total_bytes_ = 0;
+    uint64_t read_bytes_ = 0;
+    uint64_t read_lines_ = 0;
+
+    void fill_();
+    bool read_line_(std::string &line);
+};
+
+} // namespace nettests
+} // namespace mk
+#endif
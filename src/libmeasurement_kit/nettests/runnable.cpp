@@ -2,16 +2,15 @@
 // Measurement Kit is free software under the BSD license. See AUTHORS
 // and LICENSE for more information on the copying conditions.
 
-#include "src/libmeasurement_kit/common/fmap.hpp"
-#include "src/libmeasurement_kit/common/parallel.hpp"
-#include "src/libmeasurement_kit/common/range.hpp"
 #include "src/libmeasurement_kit/nettests/runnable.hpp"
 
+#include "src/libmeasurement_kit/common/json_writer.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/bouncer.hpp"
+#include "src/libmeasurement_kit/ooni/collector_outbox.hpp"
 #include "src/libmeasurement_kit/ooni/utils.hpp"
-#include "src/libmeasurement_kit/nettests/utils.hpp"
 
+#include "src/libmeasurement_kit/report/error.hpp"
 #include "src/libmeasurement_kit/report/file_reporter.hpp"
 #include "src/libmeasurement_kit/report/ooni_reporter.hpp"
 
@@ -22,13 +21,19 @@
 #include <measurement_kit/internal/vendor/mkiplookup.hpp>
 #endif
 
+#include <algorithm>
+#include <fstream>
+
 namespace mk {
 namespace nettests {
 
 using namespace mk::report;
 using namespace mk::ooni;
 
-Runnable::~Runnable() {}
+Runnable::~Runnable() {
+    // Wait for the shards to be idle before destroying them
+    shard_pool.reset();
+}
 
 void Runnable::setup(std::string) {}
 void Runnable::teardown(std::string) {}
@@ -39,43 +44,242 @@ void Runnable::main(std::string, Settings, Callback<SharedPtr<nlohmann::json>> c
         [=]() { cb(SharedPtr<nlohmann::json>{new nlohmann::json}); });
 }
 void Runnable::fixup_entry(nlohmann::json &) {}
+SharedPtr<Runnable> Runnable::make_shard() const { return {}; }
 
-void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
-                                    size_t num_entries,
-                                    SharedPtr<size_t> current_entry) {
-    logger->debug("net_test: running next measurement");
+// How many inputs we may skip because their host is busy
+static constexpr size_t max_deferred_inputs = 64;
 
-    double max_rt = options.get("max_runtime", -1.0);
-    double max_rt_tolerance = max_rt / 10.0;
-    double delta = mk::time_now() - beginning;
-    if (max_rt >= 0.0 && delta > max_rt - max_rt_tolerance) {
-        logger->info("Exceeded test maximum runtime");
-        cb(NoError());
+// Bounds the connections that all the code running on `reactor` may have
+// connecting and open at once, where zero means no bound
+static void limit_connections(SharedPtr<Reactor> reactor, Settings &options) {
+    reactor->connection_governor()->set_limits(
+        (size_t)std::max(options.get("max_connecting", 0), 0),
+        (size_t)std::max(options.get("max_open_sockets", 0), 0));
+}
+
+void Runnable::run_measurements(Callback<Error> cb) {
+    int parallelism = options.get("parallelism", 3);
+    int max_parallelism = options.get("max_parallelism", 0);
+    if (max_parallelism <= 0) {
+        max_parallelism = parallelism; // By default we can only slow down
+    }
+    concurrency.reset(new ConcurrencyController(
+        (size_t)std::max(parallelism, 1),
+        (size_t)std::max(options.get("min_parallelism", 1), 1),
+        (size_t)std::max(max_parallelism, 1),
+        (size_t)std::max(options.get("max_parallelism_per_host", 1), 0)));
+    measurements_done = cb;
+    start_shards();
+    emit_concurrency();
+    schedule_measurements();
+}
+
+void Runnable::start_shards() {
+    int count = options.get("shards", 1);
+    if (count <= 1) {
         return;
     }
+    if (!make_shard()) {
+        logger->warn("This test cannot run in shards; using a single thread");
+        return;
+    }
+    logger->debug("net_test: running measurements in %d shards", count);
+    shard_pool.reset(new ReactorPool((size_t)count));
+    for (size_t i = 0; i < shard_pool->size(); ++i) {
+        // Shards share what we learned from the bouncer and GeoIP
+        SharedPtr<Runnable> shard = make_shard();
+        shard->reactor = shard_pool->at(i);
+        limit_connections(shard->reactor, options);
+        shard->logger = logger;
+        shard->options = options;
+        shard->test_helpers_data = test_helpers_data;
+        shard->annotations = annotations;
+        shard->probe_ip = probe_ip;
+        shard->probe_asn = probe_asn;
+        shard->probe_cc = probe_cc;
+        shard->probe_network_name = probe_network_name;
+        shard->resolver_ip = resolver_ip;
+        shards.push_back(shard);
+    }
+    // Shards read the report header concurrently, so compute it now
+    nlohmann::json unused;
+    report.fill_entry(unused);
+    // Our reactor may have nothing to do while shards are measuring
+    keep_alive.reset(new KeepAlive(reactor));
+}
 
-    if (inputs.size() <= 0) {
+void Runnable::schedule_measurements() {
+    double max_rt = options.get("max_runtime", -1.0);
+    double max_rt_tolerance = max_rt / 10.0;
+    while (!measurements_error && !stop_measuring &&
+           concurrency->can_start()) {
+        double delta = mk::time_now() - beginning;
+        if (max_rt >= 0.0 && delta > max_rt - max_rt_tolerance) {
+            logger->info("Exceeded test maximum runtime");
+            stop_measuring = true;
+            break;
+        }
+        size_t index = 0;
+        std::string next_input;
+        if (!next_input_for_free_host(index, next_input)) {
+            break;
+        }
+        run_next_measurement(index, next_input);
+    }
+    if (concurrency->in_flight() <= 0 && !!measurements_done) {
         logger->debug("net_test: reached end of input");
-        cb(NoError());
-        return;
+        measured_all_inputs = !measurements_error && !stop_measuring;
+        Callback<Error> cb = measurements_done;
+        measurements_done = nullptr;
+        if (shard_pool) {
+            shard_pool->stop();
+            keep_alive->release();
+        }
+        cb(measurements_error);
     }
-    std::string next_input = inputs.front();
-    inputs.pop_front();
+}
 
+bool Runnable::next_input_for_free_host(size_t &index, std::string &input) {
+    for (auto it = deferred_inputs.begin(); it != deferred_inputs.end(); ++it) {
+        if (concurrency->can_start(input_host(it->second))) {
+            index = it->first;
+            input = std::move(it->second);
+            deferred_inputs.erase(it);
+            return true;
+        }
+    }
+    while (deferred_inputs.size() < max_deferred_inputs &&
+           input_source.next(input)) {
+        index = next_input_index++;
+        if (checkpoint.is_done(index)) {
+            current_entry += 1; // So that progress accounts for it
+            continue;
+        }
+        if (concurrency->can_start(input_host(input))) {
+            return true;
+        }
+        deferred_inputs.emplace_back(index, std::move(input));
+    }
+    return false;
+}
+
+void Runnable::emit_concurrency() {
+    logger->debug("net_test: running up to %lu measurements in parallel",
+                  (unsigned long)concurrency->limit());
+    logger->emit_event_ex("status.update.concurrency", {
+        {"parallelism", concurrency->limit()},
+    });
+}
+
+void Runnable::run_next_measurement(size_t index, std::string next_input) {
+    logger->debug("net_test: running next measurement");
+
+    double max_rt = options.get("max_runtime", -1.0);
+    double delta = mk::time_now() - beginning;
     double prog = 0.0;
+    size_t num_entries = input_source.estimated_total();
     if (max_rt > 0.0) {
         prog = delta / max_rt;
     } else if (num_entries > 0) {
-        prog = *current_entry / (double)num_entries;
+        prog = current_entry / (double)num_entries;
     }
-    auto saved_current_entry = *current_entry; // used for emitting events
-    *current_entry += 1;
+    auto saved_current_entry = current_entry; // used for emitting events
+    current_entry += 1;
     if (next_input != "") {
         std::string description;
         description += "Processing input: ";
         description += next_input;
         logger->progress(prog, description.c_str());
     }
+    std::string host = input_host(next_input);
+    concurrency->started(host);
+
+    logger->emit_event_ex("status.measurement_start", nlohmann::json::object({
+        {"idx", saved_current_entry},
+        {"input", next_input},
+    }));
+
+    auto finish = [=](bool timed_out, SerializedEntry serialized) {
+        // TODO(bassosimone): make sure that this entry contains the report ID
+        // which probably is currently not the case.
+        logger->emit_event_ex("measurement", nlohmann::json::object({
+            {"idx", saved_current_entry},
+            {"json_str", *serialized},
+        }));
+        // The entry is written in the background, so we can start the next
+        // measurement as soon as the entry has been queued. See open_report().
+        SharedPtr<Error> write_error{std::make_shared<Error>()};
+        report.enqueue_entry(serialized, [=]() {
+            if (concurrency->completed(host, timed_out)) {
+                emit_concurrency();
+            }
+            if (*write_error && !measurements_error) {
+                measurements_error = *write_error;
+            }
+            reactor->call_soon([=]() { schedule_measurements(); });
+        }, [=](Error error) {
+            if (error) {
+                logger->warn("cannot write entry");
+                if (!options.get("no_collector", false)) {
+                    // We should only emit submission related events when
+                    // the collector is enabled. Otherwise we confuse OONI.
+                    logger->emit_event_ex("failure.measurement_submission", {
+                        {"idx", saved_current_entry},
+                        {"json_str", *serialized},
+                        {"failure", error.reason},
+                    });
+                }
+                if (not options.get("ignore_write_entry_error", true)) {
+                    *write_error = error;
+                    return;
+                }
+            } else {
+                logger->debug("net_test: written entry");
+                if (!options.get("no_collector", false)) {
+                    // Like above, emit this event only if the collector
+                    // has been enabled by the user. Entries saved into the
+                    // outbox are only submitted later, hence a distinct event.
+                    logger->emit_event_ex(report::is_entry_spooled(error)
+                                                ? "status.measurement_spooled"
+                                                : "status.measurement_submission",
+                                          {{"idx", saved_current_entry}});
+                }
+            }
+            // Entries we failed to write but ignored are not measured again
+            if (use_checkpoint) {
+                Error err = checkpoint.mark_done(index);
+                if (err) {
+                    logger->warn("Cannot update checkpoint: %s", err.what());
+                }
+            }
+            logger->emit_event_ex("status.measurement_done", {
+                {"idx", saved_current_entry}
+            });
+        }, logger);
+    };
+
+    if (shards.size() <= 0) {
+        measure(*this, next_input, finish);
+        return;
+    }
+    // Shards are used in turn and hand us back the serialized entry
+    Runnable *runner = shards[next_shard++ % shards.size()].get();
+    runner->reactor->call_soon([=]() {
+        measure(*runner, next_input,
+                [=](bool timed_out, SerializedEntry serialized) {
+                    reactor->call_soon(
+                        [=]() { finish(timed_out, serialized); });
+                });
+    });
+}
+
+// Runs the test using `runner`, which is either us or one of our shards, on
+// the thread of its reactor, and builds the entry. The runner only reads our
+// report header, which does not change once we start measuring.
+void Runnable::measure(Runnable &runner, std::string next_input,
+                       Callback<bool, SerializedEntry> cb) {
+    SharedPtr<Logger> logger = runner.logger;
+    Settings &options = runner.options;
 
     logger->debug("net_test: creating entry");
     struct tm measurement_start_time;
@@ -84,23 +288,22 @@ void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
     start_time = mk::time_now();
 
     logger->debug("net_test: calling setup");
-    setup(next_input);
+    runner.setup(next_input);
 
     logger->debug("net_test: running with input %s", next_input.c_str());
-    logger->emit_event_ex("status.measurement_start", nlohmann::json::object({
-        {"idx", saved_current_entry},
-        {"input", next_input},
-    }));
-
-    main(next_input, options, [=](SharedPtr<nlohmann::json> test_keys) {
+    runner.main(next_input, options, [=, &runner](
+                                         SharedPtr<nlohmann::json> test_keys) {
+        Settings &options = runner.options;
+        bool timed_out = measurement_timed_out(*test_keys);
         nlohmann::json entry;
         entry["input"] = next_input;
         // Make sure the input is `null` rather than empty string
         if (entry["input"] == "") {
             entry["input"] = nullptr;
         }
-        entry["test_keys"] = *test_keys;
-        entry["test_keys"]["client_resolver"] = resolver_ip;
+        // The test is done with its keys, so we move rather than copy them
+        entry["test_keys"] = std::move(*test_keys);
+        entry["test_keys"]["client_resolver"] = runner.resolver_ip;
         entry["measurement_start_time"] =
             *mk::timestamp(&measurement_start_time);
         entry["test_runtime"] = mk::time_now() - start_time;
@@ -114,7 +317,7 @@ void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
 
         // Add test helpers
         entry["test_helpers"] = nlohmann::json::object();
-        for (auto &name : test_helpers_option_names()) {
+        for (auto &name : runner.test_helpers_option_names()) {
             if (options.count(name) != 0) {
                 entry["test_helpers"][name] = options[name];
             }
@@ -124,69 +327,33 @@ void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
         entry["input_hashes"] = nlohmann::json::array();
 
         logger->debug("net_test: tearing down");
-        teardown(next_input);
+        runner.teardown(next_input);
 
         // Note: annotations must be added before fill_entry because in the
         // latter we will add additional annotations.
-        entry["annotations"] = annotations;
+        entry["annotations"] = runner.annotations;
         report.fill_entry(entry);
-        fixup_entry(entry); // Let drivers possibly fix-up the entry
+        runner.fixup_entry(entry); // Let drivers possibly fix-up the entry
 
         // We should not dump without checking. See #1823.
         std::string dumped;
         try {
-          dumped = entry.dump();
+          dumped = json_dump(entry);
         } catch (const std::exception &exc) {
           logger->warn("net_test: cannot dump entry");
           entry["test_keys"] = nullptr;
           entry["test_keys"]["failure"] = "json_processing_error";
           try {
-            dumped = entry.dump();
+            dumped = json_dump(entry);
           } catch (const std::exception &exc) {
             logger->warn("net_test: cannot really dump entry");
             dumped = R"({"test_keys":{"failure":"json_processing_error"}})";
           }
         }
 
-        // TODO(bassosimone): make sure that this entry contains the report ID
-        // which probably is currently not the case.
-        logger->emit_event_ex("measurement", nlohmann::json::object({
-            {"idx", saved_current_entry},
-            {"json_str", dumped},
-        }));
-        report.write_entry(entry, [=](Error error) {
-            if (error) {
-                logger->warn("cannot write entry");
-                if (!options.get("no_collector", false)) {
-                    // We should only emit submission related events when
-                    // the collector is enabled. Otherwise we confuse OONI.
-                    logger->emit_event_ex("failure.measurement_submission", {
-                        {"idx", saved_current_entry},
-                        {"json_str", dumped},
-                        {"failure", error.reason},
-                    });
-                }
-                if (not options.get("ignore_write_entry_error", true)) {
-                    cb(error);
-                    return;
-                }
-            } else {
-                logger->debug("net_test: written entry");
-                if (!options.get("no_collector", false)) {
-                    // Like above, emit this event only if the collector
-                    // has been enabled by the user.
-                    logger->emit_event_ex("status.measurement_submission", {
-                        {"idx", saved_current_entry}
-                    });
-                }
-            }
-            logger->emit_event_ex("status.measurement_done", {
-                {"idx", saved_current_entry}
-            });
-            reactor->call_soon([=]() {
-                run_next_measurement(thread_id, cb, num_entries, current_entry);
-            });
-        }, logger);
+        // We serialize the entry only once and the report shares these
+        // bytes among all the reporters, including the collector one.
+        cb(timed_out, SerializedEntry{new std::string{std::move(dumped)}});
     });
 }
 
@@ -353,6 +520,18 @@ void Runnable::open_report(Callback<Error> callback) {
 
     report.options = options;
 
+    /*
+     * Entries are written in the background, so that measuring does not
+     * need to wait for the collector. When we should stop on write errors,
+     * we need to know the result before continuing, so we don't queue.
+     */
+    if (options.get("ignore_write_entry_error", true)) {
+        report.max_queued_entries = (size_t)std::max(
+            0, options.get("max_queued_entries", 8));
+        report.max_writing_entries = (size_t)std::max(
+            1, options.get("max_writing_entries", 1));
+    }
+
     report.probe_ip = probe_ip;
     report.probe_cc = probe_cc;
     report.probe_asn = probe_asn;
@@ -360,6 +539,7 @@ void Runnable::open_report(Callback<Error> callback) {
     if (output_filepath == "") {
         output_filepath = generate_output_filepath();
     }
+    load_checkpoint();
     if (!options.get("no_file_report", false)) {
         report.add_reporter(FileReporter::make(output_filepath));
     }
@@ -369,6 +549,66 @@ void Runnable::open_report(Callback<Error> callback) {
     report.open(callback);
 }
 
+void Runnable::load_checkpoint() {
+    use_checkpoint = options.get("checkpoint", false);
+    if (!use_checkpoint ||
+        !checkpoint.load(Checkpoint::path_for(output_filepath), test_name,
+                         logger)) {
+        return;
+    }
+    report.resume = true;
+    input_source.set_seed(checkpoint.seed);
+}
+
+void Runnable::open_checkpoint() {
+    if (!use_checkpoint) {
+        return;
+    }
+    // When resuming, this is the ID of the new report (see OoniReporter)
+    checkpoint.report_id = report.report_id;
+    checkpoint.seed = input_source.seed();
+    Error err = checkpoint.open(Checkpoint::path_for(output_filepath),
+                                test_name, options.get("report_fsync", false));
+    if (err) {
+        logger->warn("Cannot open checkpoint: %s", err.what());
+        use_checkpoint = false;
+    }
+}
+
+void Runnable::submit_outbox() {
+    std::string dir = options.get("collector_outbox_dir", std::string{});
+    if (dir == "" || options.get("no_collector", false)) {
+        return;
+    }
+    logger->info("Submitting the outbox in the background");
+    submitting_outbox = true;
+    collector::outbox_submit(
+        dir,
+        options.get("collector_base_url",
+                    collector::production_collector_url()),
+        [=](Error error) {
+            if (error) {
+                logger->warn("Cannot submit the outbox: %s", error.what());
+            }
+            submitting_outbox = false;
+            Callback<> cb;
+            std::swap(cb, outbox_submitted);
+            if (cb) {
+                cb();
+            }
+        },
+        options, reactor, logger);
+}
+
+void Runnable::wait_outbox(Callback<> cb) {
+    if (!submitting_outbox) {
+        cb();
+        return;
+    }
+    logger->info("Waiting for the outbox to be submitted");
+    outbox_submitted = cb;
+}
+
 std::string Runnable::generate_output_filepath() {
     int idx = 0;
     std::stringstream filename;
@@ -380,6 +620,9 @@ std::string Runnable::generate_output_filepath() {
         strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H%M%SZ", &test_start_time);
         filename << "report-" << test_name << "-";
         filename << timestamp << "-" << idx << ".njson";
+        if (options.get("report_gzip", false)) {
+            filename << ".gz";
+        }
 
         std::ifstream output_file(filename.str().c_str());
         // If a file called this way already exists we increment the counter
@@ -469,6 +712,7 @@ void Runnable::query_bouncer(Callback<Error> cb) {
 void Runnable::begin(Callback<Error> cb) {
     mk::utc_time_now(&test_start_time);
     beginning = mk::time_now();
+    limit_connections(reactor, options);
     query_bouncer([=](Error error) {
         if (error) {
             cb(error);
@@ -494,33 +738,23 @@ void Runnable::begin(Callback<Error> cb) {
                             cb(error);
                             return;
                         }
+                        submit_outbox();
                         logger->progress(0.1, "starting the test");
                         logger->set_progress_offset(0.1);
                         logger->set_progress_scale(0.8);
 
-                        error = process_input_filepaths(inputs,
-                                needs_input, input_filepaths, probe_cc, options,
-                                logger, nullptr, nullptr);
+                        // Input files are read while we measure
+                        error = input_source.open(inputs, needs_input,
+                                input_filepaths, probe_cc, options, logger);
                         if (error) {
                             cb(error);
                             return;
                         }
-                        size_t num_entries = inputs.size();
-
-                        // Run `parallelism` measurements in parallel
-                        SharedPtr<size_t> current_entry(new size_t(0));
-                        mk::parallel(mk::fmap<size_t, Continuation<Error>>(
-                                         mk::range<size_t>(
-                                             options.get("parallelism", 3)),
-                                         [=](size_t thread_id) {
-                                             return [=](Callback<Error> cb) {
-                                                 run_next_measurement(
-                                                     thread_id, cb, num_entries,
-                                                     current_entry);
-                                             };
-                                         }),
-                                     cb);
+                        open_checkpoint();
 
+                        // The number of measurements in parallel adapts
+                        // to how the network is doing
+                        run_measurements(cb);
                     });
                 },
                 options, reactor, logger);
@@ -532,12 +766,42 @@ void Runnable::end(Callback<Error> cb) {
     logger->set_progress_offset(0.0);
     logger->set_progress_scale(1.0);
     logger->progress(0.95, "ending the test");
+    log_connection_stats();
     report.close([=](Error err) {
-        logger->progress(1.00, "test complete");
-        cb(err);
+        if (use_checkpoint && measured_all_inputs) {
+            // Nothing left to resume, even if we could not close the report
+            Error error = checkpoint.remove();
+            if (error) {
+                logger->warn("Cannot remove checkpoint: %s", error.what());
+            }
+        }
+        wait_outbox([=]() {
+            logger->progress(1.00, "test complete");
+            cb(err);
+        });
     });
 }
 
+void Runnable::log_connection_stats() {
+    std::vector<SharedPtr<Reactor>> reactors{reactor};
+    for (auto &shard : shards) {
+        reactors.push_back(shard->reactor);
+    }
+    uint64_t granted = 0, waited = 0;
+    double total_wait = 0.0, max_wait = 0.0;
+    for (auto &r : reactors) {
+        ConnectionGovernor::Stats stats = r->connection_governor()->stats();
+        granted += stats.granted;
+        waited += stats.waited;
+        total_wait += stats.total_wait;
+        max_wait = std::max(max_wait, stats.max_wait);
+    }
+    logger->debug("net_test: %llu connects, %llu waited for a slot "
+                  "(avg %.3f s, max %.3f s)", (unsigned long long)granted,
+                  (unsigned long long)waited,
+                  (waited > 0) ? total_wait / waited : 0.0, max_wait);
+}
+
 std::list<std::string> Runnable::test_helpers_option_names() {
     std::list<std::string> values;
     for (auto &kv : test_helpers_data) {
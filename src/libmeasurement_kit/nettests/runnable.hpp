@@ -8,14 +8,20 @@
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
 #include "src/libmeasurement_kit/common/non_movable.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/reactor_pool.hpp"
 #include "src/libmeasurement_kit/common/settings.hpp"
 
+#include "src/libmeasurement_kit/nettests/checkpoint.hpp"
+#include "src/libmeasurement_kit/nettests/concurrency.hpp"
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
+#include "src/libmeasurement_kit/ooni/control_batcher.hpp"
 #include "src/libmeasurement_kit/report/report_legacy.hpp"
 
 #include <ctime>
 #include <deque>
 #include <list>
 #include <sstream>
+#include <vector>
 
 namespace mk {
 namespace nettests {
@@ -53,19 +59,61 @@ class Runnable : public NonCopyable, public NonMovable {
     virtual void main(std::string, Settings, Callback<SharedPtr<nlohmann::json>>);
     virtual void fixup_entry(nlohmann::json &);
 
+    // Returns a new instance of the same test, or nothing if the test does
+    // not support running in shards (see the `shards` option)
+    virtual SharedPtr<Runnable> make_shard() const;
+
     // Functions that derived classes should access
     std::list<std::string> test_helpers_option_names();
     std::list<std::string> test_helpers_bouncer_names();
 
   private:
     report::ReportLegacy report;
+    InputSource input_source;
     tm test_start_time;
     double beginning = 0.0;
 
-    void run_next_measurement(size_t, Callback<Error>, size_t, SharedPtr<size_t>);
+    // Measurements are started as long as the concurrency controller says
+    // so, deferring the inputs of hosts that already have measurements
+    SharedPtr<ConcurrencyController> concurrency;
+    std::deque<std::pair<size_t, std::string>> deferred_inputs;
+    size_t next_input_index = 0;
+    size_t current_entry = 0;
+    bool stop_measuring = false;
+    bool measured_all_inputs = false;
+    Error measurements_error;
+    Callback<Error> measurements_done;
+    void run_measurements(Callback<Error>);
+    void schedule_measurements();
+    bool next_input_for_free_host(size_t &, std::string &);
+    void emit_concurrency();
+    void run_next_measurement(size_t, std::string);
+    void measure(Runnable &runner, std::string input,
+                 Callback<bool, report::SerializedEntry> cb);
+
+    // With shards, measurements run on other threads, each with a copy of
+    // this test, while entries are still written from our reactor
+    SharedPtr<ReactorPool> shard_pool;
+    UniquePtr<KeepAlive> keep_alive; /* Of our reactor, while shards measure */
+    std::vector<SharedPtr<Runnable>> shards;
+    size_t next_shard = 0;
+    void start_shards();
+    void log_connection_stats();
+
+    // Inputs measured before an interruption are skipped when resuming
+    bool use_checkpoint = false;
+    Checkpoint checkpoint;
+    void load_checkpoint();
+    void open_checkpoint();
     void query_bouncer(Callback<Error>);
     void geoip_lookup(Callback<>);
     void open_report(Callback<Error>);
+
+    // The outbox is submitted in the background while we measure
+    bool submitting_outbox = false;
+    Callback<> outbox_submitted;
+    void submit_outbox();
+    void wait_outbox(Callback<>);
     std::string generate_output_filepath();
 };
 
@@ -78,16 +126,30 @@ class Runnable : public NonCopyable, public NonMovable {
                   Callback<SharedPtr<nlohmann::json>>) override;                \
     }
 
+// Like above, for tests taking input, which may run in shards
+#define MK_DECLARE_RUNNABLE_WITH_SHARDS(_name_)                                \
+    class _name_ : public Runnable {                                           \
+      public:                                                                  \
+        _name_() noexcept;                                                     \
+                                                                               \
+        void main(std::string, Settings,                                       \
+                  Callback<SharedPtr<nlohmann::json>>) override;                \
+                                                                               \
+        SharedPtr<Runnable> make_shard() const override {                      \
+            return SharedPtr<Runnable>{new _name_};                            \
+        }                                                                      \
+    }
+
 MK_DECLARE_RUNNABLE(DashRunnable);
 MK_DECLARE_RUNNABLE(CaptivePortalRunnable);
-MK_DECLARE_RUNNABLE(DnsInjectionRunnable);
+MK_DECLARE_RUNNABLE_WITH_SHARDS(DnsInjectionRunnable);
 MK_DECLARE_RUNNABLE(FacebookMessengerRunnable);
 MK_DECLARE_RUNNABLE(HttpHeaderFieldManipulationRunnable);
 MK_DECLARE_RUNNABLE(HttpInvalidRequestLineRunnable);
-MK_DECLARE_RUNNABLE(MeekFrontedRequestsRunnable);
+MK_DECLARE_RUNNABLE_WITH_SHARDS(MeekFrontedRequestsRunnable);
 MK_DECLARE_RUNNABLE(MultiNdtRunnable);
 MK_DECLARE_RUNNABLE(NdtRunnable);
-MK_DECLARE_RUNNABLE(TcpConnectRunnable);
+MK_DECLARE_RUNNABLE_WITH_SHARDS(TcpConnectRunnable);
 MK_DECLARE_RUNNABLE(TelegramRunnable);
 MK_DECLARE_RUNNABLE(WhatsappRunnable);
 
@@ -98,6 +160,10 @@ class WebConnectivityRunnable : public Runnable {
     void main(
             std::string, Settings, Callback<SharedPtr<nlohmann::json>>) override;
     void fixup_entry(nlohmann::json &) override;
+    SharedPtr<Runnable> make_shard() const override;
+
+  private:
+    SharedPtr<ooni::ControlBatcher> control_batcher; /* If batching */
 };
 
 } // namespace nettests
@@ -17,6 +17,9 @@ namespace nettests {
 /**
  * @brief Generates the list of entries to be tested.
  *
+ * Note that Runnable uses InputSource instead, which reads the input
+ * files lazily and thus does not keep all entries in memory.
+ *
  * @param input The input deque containing input. Note that it may already
  * contain input that has been manually specified by the user.
  *
@@ -19,7 +19,20 @@ WebConnectivityRunnable::WebConnectivityRunnable() noexcept {
 
 void WebConnectivityRunnable::main(std::string input, Settings options,
                                    Callback<SharedPtr<nlohmann::json>> cb) {
-    ooni::web_connectivity(input, options, cb, reactor, logger);
+    int batch_size = options.get("backend_batch_size", 1);
+    if (batch_size > 1 && !control_batcher) {
+        logger->warn("Batching control requests, which the OONI test "
+                     "helpers do not support");
+        control_batcher = ooni::ControlBatcherImpl<>::make(
+            (size_t)batch_size, options.get("backend_batch_delay", 0.25),
+            options, reactor, logger).as<ooni::ControlBatcher>();
+    }
+    ooni::web_connectivity(input, options, cb, control_batcher, reactor,
+                           logger);
+}
+
+SharedPtr<Runnable> WebConnectivityRunnable::make_shard() const {
+    return SharedPtr<Runnable>{new WebConnectivityRunnable};
 }
 
 void WebConnectivityRunnable::fixup_entry(nlohmann::json &entry) {
@@ -217,7 +217,8 @@ void run_loop_(SharedPtr<DashLoopCtx> ctx) {
           (*use_fixed_rates == true)
                 ? dash_rates()[select_lower_rate_index(ctx->speed_kbit)]
                 : (*constant_bitrate > 0) ? *constant_bitrate : ctx->speed_kbit;
-    int count = ((rate_kbit * 1000) / 8) * (*elapsed_target);
+    // Use 64 bit, since with int the count overflows above 2 Gbit/s
+    int64_t count = (((int64_t)rate_kbit * 1000) / 8) * (*elapsed_target);
     std::string path = "/dash/download/";
     path += std::to_string(count);
     Settings settings = ctx->settings; /* Make a local copy */
@@ -67,6 +67,8 @@ void post_net_tests_impl(std::string base_bouncer_url, std::string test_name,
     std::string bm = "POST";
     settings["http/url"] = bbu;
     settings["http/method"] = bm;
+    settings["http/decode_content"] = true;
+    settings["net/connect_priority"] = "control";
 
     http_request(settings, {{"Content-Type", "application/json"}},
                  request.dump(),
@@ -5,6 +5,13 @@
 #include "src/libmeasurement_kit/ooni/collector_client_impl.hpp"
 #include "src/libmeasurement_kit/regexp/regexp.hpp"
 
+#include <stdexcept>
+#include <vector>
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
 namespace mk {
 namespace ooni {
 namespace collector {
@@ -71,6 +78,14 @@ void update_report(SharedPtr<Transport> transport, std::string report_id, nlohma
                        logger);
 }
 
+void update_report_raw(SharedPtr<Transport> transport, std::string report_id,
+                       std::string entry, Callback<Error> callback,
+                       Settings settings, SharedPtr<Reactor> reactor,
+                       SharedPtr<Logger> logger) {
+    update_report_raw_impl(transport, report_id, entry, callback, settings,
+                           reactor, logger);
+}
+
 void connect_and_update_report(std::string report_id, nlohmann::json entry,
                                Callback<Error> callback, Settings settings,
                                SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
@@ -78,6 +93,14 @@ void connect_and_update_report(std::string report_id, nlohmann::json entry,
                                    reactor, logger);
 }
 
+void connect_and_update_report_raw(std::string report_id, std::string entry,
+                                   Callback<Error> callback, Settings settings,
+                                   SharedPtr<Reactor> reactor,
+                                   SharedPtr<Logger> logger) {
+    connect_and_update_report_raw_impl(report_id, std::move(entry), callback,
+                                       settings, reactor, logger);
+}
+
 void close_report(SharedPtr<Transport> transport, std::string report_id,
                   Callback<Error> callback, Settings settings,
                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
@@ -92,7 +115,216 @@ void connect_and_close_report(std::string report_id, Callback<Error> callback,
                                   logger);
 }
 
-ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<Logger> logger) {
+/*
+ * Parser events handler saving the top level values of an entry, except for
+ * nested objects and arrays, which we only mark as such. This allows us to
+ * validate an entry and to find its `report_id` without building its DOM.
+ */
+class TopLevelValues : public nlohmann::json_sax<nlohmann::json> {
+  public:
+    nlohmann::json values = nlohmann::json::object();
+    bool is_object = false;
+
+    bool null() override { return save(nullptr); }
+
+    bool boolean(bool val) override { return save(val); }
+
+    bool number_integer(number_integer_t val) override { return save(val); }
+
+    bool number_unsigned(number_unsigned_t val) override { return save(val); }
+
+    bool number_float(number_float_t val, const string_t &) override {
+        return save(val);
+    }
+
+    bool string(string_t &val) override { return save(std::move(val)); }
+
+    bool binary(binary_t &) override { return save(nullptr); }
+
+    bool start_object(std::size_t) override {
+        if (depth_ == 0) {
+            is_object = true;
+        } else {
+            save(nlohmann::json::object());
+        }
+        depth_ += 1;
+        return true;
+    }
+
+    bool key(string_t &val) override {
+        if (depth_ == 1) {
+            std::swap(key_, val);
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        depth_ -= 1;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        save(nlohmann::json::array());
+        depth_ += 1;
+        return true;
+    }
+
+    bool end_array() override {
+        depth_ -= 1;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &,
+                     const nlohmann::detail::exception &) override {
+        return false;
+    }
+
+  private:
+    size_t depth_ = 0;
+    std::string key_;
+
+    bool save(nlohmann::json &&value) {
+        if (depth_ == 1) {
+            values[key_] = std::move(value);
+        }
+        return true;
+    }
+};
+
+ErrorOr<std::string> add_report_id_raw(std::string entry, std::string report_id,
+                                       SharedPtr<Logger> logger, bool replace) {
+    TopLevelValues top;
+    if (!nlohmann::json::sax_parse(entry, &top) || !top.is_object) {
+        return {JsonProcessingError(), {}};
+    }
+    Error err = valid_entry(top.values);
+    if (err) {
+        return {err, {}};
+    }
+    auto current = top.values.find("report_id");
+    if (current != top.values.end() && current->is_string() &&
+        *current != "" && (!replace || *current == report_id)) {
+        return {NoError(), std::move(entry)};
+    }
+    logger->warn("collector: forcing report_id which was not set or stale");
+    if (current != top.values.end()) {
+        // Unlikely case where we need to parse the entry, e.g., when it has
+        // been saved before the report was created and its ID is empty, or
+        // when we move it into a new report because the old one was closed
+        nlohmann::json json = nlohmann::json::parse(entry);
+        json["report_id"] = report_id;
+        return {NoError(), json.dump()};
+    }
+    // Since the entry is an object, we can add the key after its first brace
+    size_t brace = entry.find('{');
+    std::string key = "\"report_id\":" + nlohmann::json(report_id).dump();
+    if (top.values.size() > 0) {
+        key += ",";
+    }
+    entry.insert(brace + 1, key);
+    return {NoError(), std::move(entry)};
+}
+
+#ifndef MK_WITHOUT_ZLIB
+
+// Note that zlib transparently reads files not compressed with gzip
+class ReportFile::Buffer : public std::streambuf {
+  public:
+    explicit Buffer(const std::string &path) : data_(buffer_size) {
+        file_ = gzopen(path.c_str(), "rb");
+        if (file_ != nullptr) {
+            gzbuffer(file_, buffer_size);
+        }
+    }
+
+    ~Buffer() override {
+        if (file_ != nullptr) {
+            gzclose(file_);
+        }
+    }
+
+    bool is_open() const { return file_ != nullptr; }
+
+  protected:
+    // Offsets refer to the decompressed data; seeking a gzip file means
+    // decompressing it up to the wanted offset, which zlib does for us
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) override {
+        if (dir == std::ios_base::cur && off == 0) {
+            z_off_t pos = gztell(file_);
+            if (pos < 0) {
+                return pos_type(off_type(-1));
+            }
+            return pos_type(off_type(pos - (egptr() - gptr())));
+        }
+        if (dir != std::ios_base::beg) {
+            return pos_type(off_type(-1));
+        }
+        return seekpos(pos_type(off), which);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode) override {
+        setg(data_.data(), data_.data(), data_.data());
+        if (gzseek(file_, (z_off_t)off_type(pos), SEEK_SET) < 0) {
+            return pos_type(off_type(-1));
+        }
+        return pos;
+    }
+
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        int n = gzread(file_, data_.data(), (unsigned)data_.size());
+        if (n <= 0) {
+            int errnum = Z_OK;
+            (void)gzerror(file_, &errnum);
+            // Z_BUF_ERROR means that the last gzip member is truncated,
+            // which happens when the writer crashed; treat it as EOF
+            if (errnum != Z_OK && errnum != Z_BUF_ERROR) {
+                // The istream will catch this and set its badbit
+                throw std::runtime_error("cannot decompress report");
+            }
+            return traits_type::eof();
+        }
+        setg(data_.data(), data_.data(), data_.data() + n);
+        return traits_type::to_int_type(*gptr());
+    }
+
+  private:
+    static constexpr unsigned buffer_size = 1 << 16;
+    std::vector<char> data_;
+    gzFile file_ = nullptr;
+};
+
+#else
+
+class ReportFile::Buffer : public std::filebuf {
+  public:
+    explicit Buffer(const std::string &path) : data_(buffer_size) {
+        // Must be called before open() to have any effect
+        pubsetbuf(data_.data(), buffer_size);
+        open(path, std::ios::in | std::ios::binary);
+    }
+
+  private:
+    static constexpr size_t buffer_size = 1 << 16;
+    std::vector<char> data_;
+};
+
+#endif
+
+ReportFile::ReportFile(const std::string &path)
+    : std::istream{nullptr}, buffer_{new Buffer(path)} {
+    rdbuf(buffer_.get());
+    if (!buffer_->is_open()) {
+        setstate(std::ios_base::failbit);
+    }
+}
+
+ReportFile::~ReportFile() {}
+
+ErrorOr<std::string> get_next_line(SharedPtr<std::istream> file, SharedPtr<Logger> logger) {
     std::string line;
     std::getline(*file, line);
     if (file->eof()) {
@@ -104,10 +336,18 @@ ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<L
         return {FileIoError(), {}};
     }
     logger->debug("Read line from report: %s", line.c_str());
+    return {NoError(), std::move(line)};
+}
+
+ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<Logger> logger) {
+    ErrorOr<std::string> line = get_next_line(file, logger);
+    if (!line) {
+        return {line.as_error(), {}};
+    }
     nlohmann::json entry;
     Error e = NoError();
     try {
-        entry = nlohmann::json::parse(line);
+        entry = nlohmann::json::parse(*line);
     } catch (const std::exception &) {
         e = JsonProcessingError();
     }
@@ -21,6 +21,47 @@ namespace collector {
 std::string production_collector_url();
 std::string testing_collector_url();
 
+/*
+    `submit_report()` honours the following settings:
+
+    - `collector/max_inflight_entries` (int, default 1): number of entries
+      uploaded in parallel, each using its own connection;
+
+    - `collector/report_id` (string, default ""): when set, the entries are
+      appended to this existing report rather than to a new report;
+
+    - `collector/acked_entries` (int, default 0): when resuming a report,
+      the number of entries at the beginning of the file to skip; if
+      `collector/report_id` is not set, the remaining entries are submitted
+      into a new report, e.g. because the collector closed the old one;
+
+    - `collector/acked_offset` (int64, default 0): when resuming a report,
+      the offset in the file where to continue, which allows to resume
+      without reading the entries to skip; zero means unknown;
+
+    - `collector/raw_entries` (bool, default false): send the lines of the
+      file as they are, without parsing and validating them, which is much
+      cheaper for large entries and is safe for reports written by us;
+
+    - `collector/replace_report_id` (bool, default false): with raw entries,
+      replace the `report_id` of the entries that have a different one, which
+      is needed when moving them into a new report.
+
+    When the collector replies that the report does not exist or has been
+    closed, e.g. because it was idle for too long, we fail with
+    CollectorReportNotFoundError.
+
+    The report file may be compressed with gzip, as FileWriter does when
+    `gzip` is true. If the last gzip member is truncated, e.g. because the
+    writer crashed, the truncated entries are not submitted.
+
+    Each time the number of entries acknowledged by the collector grows
+    (counting only entries acknowledged along with all the previous ones),
+    the `status.report_submit` event is emitted with the `report_id`, the
+    `acked_entries`, and the `acked_offset` fields, which can be used to
+    resume. See also the outbox in collector_outbox.hpp.
+*/
+
 void submit_report(std::string filepath, std::string collector_base_url,
                    Callback<Error> callback, Settings conf,
                    SharedPtr<Reactor>, SharedPtr<Logger>);
@@ -51,10 +92,19 @@ void update_report(SharedPtr<net::Transport>, std::string report_id, nlohmann::j
                    Callback<Error>, Settings,
                    SharedPtr<Reactor>, SharedPtr<Logger>);
 
+// Like update_report() but `entry` is sent without parsing it
+void update_report_raw(SharedPtr<net::Transport>, std::string report_id,
+                       std::string entry, Callback<Error>, Settings,
+                       SharedPtr<Reactor>, SharedPtr<Logger>);
+
 void connect_and_update_report(std::string report_id, nlohmann::json,
                                Callback<Error>, Settings,
                                SharedPtr<Reactor>, SharedPtr<Logger>);
 
+void connect_and_update_report_raw(std::string report_id, std::string entry,
+                                   Callback<Error>, Settings,
+                                   SharedPtr<Reactor>, SharedPtr<Logger>);
+
 void close_report(SharedPtr<net::Transport>, std::string report_id, Callback<Error>,
                   Settings, SharedPtr<Reactor>, SharedPtr<Logger>);
 
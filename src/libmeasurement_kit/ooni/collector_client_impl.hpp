@@ -16,6 +16,11 @@
 #include "src/libmeasurement_kit/report/error.hpp"
 
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
 
 namespace mk {
 namespace ooni {
@@ -59,6 +64,7 @@ void post_impl(SharedPtr<Transport> transport, std::string append_to_url,
     url += append_to_url;
     settings["http/url"] = url;
     settings["http/method"] = "POST";
+    settings["http/decode_content"] = true;
     if (body != "") {
         headers_push_back(headers, "Content-Type", "application/json");
     }
@@ -68,6 +74,13 @@ void post_impl(SharedPtr<Transport> transport, std::string append_to_url,
                                   callback(err, nullptr);
                                   return;
                               }
+                              // This is how the collector tells us that the
+                              // report does not exist or has been closed
+                              if (response->status_code == 404) {
+                                  callback(CollectorReportNotFoundError(),
+                                           nullptr);
+                                  return;
+                              }
                               if (response->status_code / 100 != 2) {
                                   callback(HttpRequestFailedError(), nullptr);
                                   return;
@@ -117,6 +130,7 @@ void connect_impl(Settings settings, Callback<Error, SharedPtr<Transport>> callb
         url = settings["collector_base_url"];
     }
     settings["http/url"] = url;
+    settings["net/connect_priority"] = "control";
     http_request_connect(settings, callback, reactor, logger);
 }
 
@@ -232,6 +246,43 @@ void update_report_impl(SharedPtr<Transport> transport, std::string report_id,
                    settings, reactor, logger);
 }
 
+ErrorOr<std::string> add_report_id_raw(std::string entry, std::string report_id,
+                                       SharedPtr<Logger> logger,
+                                       bool replace = false);
+
+/*
+ * Like update_report_impl() but `entry` is the serialized entry, as written
+ * by our reporters, which is sent as is. We validate the entry while parsing
+ * it without building its DOM and we only add `report_id` when it is missing
+ * or, if `collector/replace_report_id` is true, when it is different.
+ */
+template <MK_MOCK_AS(collector::post, collector_post)>
+void update_report_raw_impl(SharedPtr<Transport> transport, std::string report_id,
+                            std::string entry, Callback<Error> callback,
+                            Settings settings, SharedPtr<Reactor> reactor,
+                            SharedPtr<Logger> logger) {
+    ErrorOr<std::string> content = add_report_id_raw(
+        std::move(entry), report_id, logger,
+        settings.get("collector/replace_report_id", false));
+    if (!content) {
+        logger->warn("collector: you passed me an invalid entry");
+        callback(content.as_error());
+        return;
+    }
+    // Same as `request.dump()` in update_report_impl() but we do not need
+    // to parse and serialize again the (possibly large) entry.
+    std::string body;
+    body.reserve(content->size() + 32);
+    body += "{\"content\":";
+    body += *content;
+    body += ",\"format\":\"json\"}";
+    collector_post(transport, "/report/" + report_id, std::move(body),
+                   [=](Error err, nlohmann::json) {
+                       callback(err);
+                   },
+                   settings, reactor, logger);
+}
+
 template <MK_MOCK_AS(collector::connect, collector_connect),
           MK_MOCK_AS(collector::update_report, collector_update_report)>
 void connect_and_update_report_impl(std::string report_id, nlohmann::json entry,
@@ -251,6 +302,27 @@ void connect_and_update_report_impl(std::string report_id, nlohmann::json entry,
     }, reactor, logger);
 }
 
+template <MK_MOCK_AS(collector::connect, collector_connect),
+          MK_MOCK_AS(collector::update_report_raw, collector_update_report_raw)>
+void connect_and_update_report_raw_impl(std::string report_id,
+                                        std::string entry,
+                                        Callback<Error> callback,
+                                        Settings settings,
+                                        SharedPtr<Reactor> reactor,
+                                        SharedPtr<Logger> logger) {
+    collector_connect(settings, [=](Error error, SharedPtr<Transport> txp) {
+        if (error) {
+            callback(error);
+            return;
+        }
+        collector_update_report_raw(txp, report_id, entry, [=](Error error) {
+            txp->close([=]() {
+                callback(error);
+            });
+        }, settings, reactor, logger);
+    }, reactor, logger);
+}
+
 template <MK_MOCK_AS(collector::post, collector_post)>
 void close_report_impl(SharedPtr<Transport> transport, std::string report_id,
                        Callback<Error> callback, Settings settings,
@@ -281,68 +353,369 @@ void connect_and_close_report_impl(std::string report_id,
     }, reactor, logger);
 }
 
+ErrorOr<std::string> get_next_line(SharedPtr<std::istream> file, SharedPtr<Logger> logger);
+
 ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<Logger> logger);
 
+// Reads a report using a larger buffer than the default one. Reports
+// compressed with gzip, possibly truncated by a crash, are decompressed.
+class ReportFile : public std::istream {
+  public:
+    explicit ReportFile(const std::string &path);
+    ~ReportFile() override;
+
+  private:
+    class Buffer;
+    std::unique_ptr<Buffer> buffer_;
+};
+
+/*
+ * State shared by the connections used to submit a report. With more than
+ * one entry in flight, entries may be acknowledged out of order. Hence we
+ * keep the out of order acks in `acked` and we only move `last_acked` when
+ * all the entries before it have been acknowledged as well.
+ */
+class SubmitContext {
+  public:
+    int active = 0;
+    std::set<int> acked;
+    int64_t acked_offset = 0;
+    Callback<Error> callback;
+    Error error;
+    SharedPtr<std::istream> file;
+    int last_acked = 0;
+    int next_line = 1;
+    std::map<int, int64_t> offsets;
+    bool raw_entries = false;
+    bool reached_eof = false;
+    std::string report_id;
+
+    // Remembers where the line that we've just read ends in the file
+    void read_line(int line) {
+        std::streamoff offset = file->tellg();
+        if (offset >= 0) {
+            offsets[line] = (int64_t)offset;
+        }
+    }
+
+    void ack(int line, SharedPtr<Logger> logger) {
+        acked.insert(line);
+        int previous = last_acked;
+        while (acked.count(last_acked + 1) > 0) {
+            acked.erase(++last_acked);
+        }
+        if (last_acked != previous) {
+            // Zero means that we don't know the offset, see submit_report()
+            auto end = offsets.upper_bound(last_acked);
+            acked_offset = 0;
+            if (end != offsets.begin() && std::prev(end)->first == last_acked) {
+                acked_offset = std::prev(end)->second;
+            }
+            offsets.erase(offsets.begin(), end);
+            logger->emit_event_ex("status.report_submit",
+                nlohmann::json::object({
+                    {"report_id", report_id},
+                    {"acked_entries", last_acked},
+                    {"acked_offset", acked_offset}
+                }));
+        }
+    }
+};
+
+template <MK_MOCK_AS(collector::close_report, collector_close_report)>
+void submit_done_impl(SharedPtr<SubmitContext> ctx, SharedPtr<Transport> txp,
+                      Error err, Settings settings, SharedPtr<Reactor> reactor,
+                      SharedPtr<Logger> logger) {
+    if (err && !ctx->error) {
+        ctx->error = err;
+    }
+    if (--ctx->active > 0) {
+        txp->close([]() {});
+        return;
+    }
+    if (ctx->error) {
+        logger->warn("collector: entries acknowledged before error: %d",
+                     ctx->last_acked);
+        txp->close([=]() { ctx->callback(ctx->error); });
+        return;
+    }
+    // We are the last connection standing, so all the other entries have
+    // been acknowledged and we can close the report.
+    collector_close_report(
+        txp, ctx->report_id,
+        [=](Error err) {
+            txp->close([=]() { ctx->callback(err); });
+        },
+        settings, reactor, logger);
+}
+
+template <MK_MOCK_AS(collector::update_report, collector_update_report),
+          MK_MOCK_AS(collector::get_next_entry, collector_get_next_entry),
+          MK_MOCK_AS(collector::close_report, collector_close_report),
+          MK_MOCK_AS(collector::update_report_raw, collector_update_report_raw)>
+void update_and_fetch_next_impl(SharedPtr<SubmitContext> ctx,
+                                SharedPtr<Transport> txp, int line,
+                                nlohmann::json entry, std::string raw_entry,
+                                Settings settings, SharedPtr<Reactor> reactor,
+                                SharedPtr<Logger> logger);
+
 template <MK_MOCK_AS(collector::update_report, collector_update_report),
-          MK_MOCK_AS(collector::get_next_entry, collector_get_next_entry)>
-void update_and_fetch_next_impl(SharedPtr<std::istream> file, SharedPtr<Transport> txp,
-                                std::string report_id, int line, nlohmann::json entry,
-                                Callback<Error> callback, Settings settings,
-                                SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+          MK_MOCK_AS(collector::get_next_entry, collector_get_next_entry),
+          MK_MOCK_AS(collector::close_report, collector_close_report),
+          MK_MOCK_AS(collector::update_report_raw, collector_update_report_raw)>
+void fetch_next_and_update_impl(SharedPtr<SubmitContext> ctx,
+                                SharedPtr<Transport> txp, Settings settings,
+                                SharedPtr<Reactor> reactor,
+                                SharedPtr<Logger> logger) {
+    if (ctx->error || ctx->reached_eof) {
+        submit_done_impl<collector_close_report>(ctx, txp, NoError(), settings,
+                                                 reactor, logger);
+        return;
+    }
+    logger->debug("reading next entry");
+    nlohmann::json entry;
+    std::string raw_entry;
+    Error err = NoError();
+    if (ctx->raw_entries) {
+        ErrorOr<std::string> maybe_line = get_next_line(ctx->file, logger);
+        if (!!maybe_line) {
+            std::swap(raw_entry, *maybe_line);
+        }
+        err = maybe_line.as_error();
+    } else {
+        ErrorOr<nlohmann::json> maybe_entry = collector_get_next_entry(
+            ctx->file, logger);
+        if (!!maybe_entry) {
+            std::swap(entry, *maybe_entry);
+        }
+        err = maybe_entry.as_error();
+    }
+    if (err) {
+        if (err == FileEofError()) {
+            ctx->reached_eof = true;
+            err = NoError();
+        }
+        submit_done_impl<collector_close_report>(ctx, txp, err, settings,
+                                                 reactor, logger);
+        return;
+    }
+    int line = ctx->next_line++;
+    ctx->read_line(line);
+    update_and_fetch_next_impl<collector_update_report,
+                               collector_get_next_entry,
+                               collector_close_report,
+                               collector_update_report_raw>(
+        ctx, txp, line, std::move(entry), std::move(raw_entry), settings,
+        reactor, logger);
+}
+
+// Note: default template arguments are in the above declaration
+template <decltype(collector::update_report) collector_update_report,
+          decltype(collector::get_next_entry) collector_get_next_entry,
+          decltype(collector::close_report) collector_close_report,
+          decltype(collector::update_report_raw) collector_update_report_raw>
+void update_and_fetch_next_impl(SharedPtr<SubmitContext> ctx,
+                                SharedPtr<Transport> txp, int line,
+                                nlohmann::json entry, std::string raw_entry,
+                                Settings settings, SharedPtr<Reactor> reactor,
+                                SharedPtr<Logger> logger) {
     logger->info("adding entry report #%d...", line);
-    collector_update_report(
-        txp, report_id, entry,
-        [=](Error err) {
-            logger->info("adding entry report #%d... %d", line, err.code);
-            if (err) {
-                txp->close([=]() { callback(err); });
-                return;
+    auto callback = [=](Error err) {
+        logger->info("adding entry report #%d... %d", line, err.code);
+        if (err) {
+            submit_done_impl<collector_close_report>(ctx, txp, err, settings,
+                                                     reactor, logger);
+            return;
+        }
+        ctx->ack(line, logger);
+        // After #644 bug and fix, I prefer to always break explicit
+        // recursion by using the call_soon() pattern
+        logger->debug("scheduling read of next entry...");
+        reactor->call_soon([=]() {
+            fetch_next_and_update_impl<collector_update_report,
+                                       collector_get_next_entry,
+                                       collector_close_report,
+                                       collector_update_report_raw>(
+                ctx, txp, settings, reactor, logger);
+        });
+    };
+    if (ctx->raw_entries) {
+        collector_update_report_raw(txp, ctx->report_id, std::move(raw_entry),
+                                    callback, settings, reactor, logger);
+        return;
+    }
+    collector_update_report(txp, ctx->report_id, std::move(entry), callback,
+                            settings, reactor, logger);
+}
+
+/*
+ * Entries are uploaded using up to `collector/max_inflight_entries` parallel
+ * connections, each one with a single request in flight. The first connection
+ * is also used to create the report. If we cannot open more connections, we
+ * continue with the connections we have.
+ */
+template <MK_MOCK_AS(collector::connect, collector_connect),
+          MK_MOCK_AS(collector::update_report, collector_update_report),
+          MK_MOCK_AS(collector::get_next_entry, collector_get_next_entry),
+          MK_MOCK_AS(collector::close_report, collector_close_report),
+          MK_MOCK_AS(collector::update_report_raw, collector_update_report_raw)>
+void submit_entries_impl(SharedPtr<SubmitContext> ctx, SharedPtr<Transport> txp,
+                         int first_line, nlohmann::json first_entry,
+                         std::string first_raw_entry,
+                         int max_inflight, Settings settings,
+                         SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    SharedPtr<std::vector<SharedPtr<Transport>>> txps{
+        std::make_shared<std::vector<SharedPtr<Transport>>>()};
+    txps->push_back(txp);
+    SharedPtr<int> pending{std::make_shared<int>(max_inflight - 1)};
+    auto start = [=]() {
+        logger->info("uploading entries using %d connection(s)",
+                     (int)txps->size());
+        ctx->active = (int)txps->size();
+        for (size_t i = 0; i < txps->size(); ++i) {
+            if (i == 0 && first_line > 0) {
+                update_and_fetch_next_impl<collector_update_report,
+                                           collector_get_next_entry,
+                                           collector_close_report,
+                                           collector_update_report_raw>(
+                    ctx, (*txps)[i], first_line, first_entry, first_raw_entry,
+                    settings, reactor, logger);
+                continue;
             }
-            // After #644 bug and fix, I prefer to always break explicit
-            // recursion by using the call_soon() pattern
-            logger->debug("scheduling read of next entry...");
-            reactor->call_soon([=]() {
-                logger->debug("reading next entry");
-                ErrorOr<nlohmann::json> entry = collector_get_next_entry(file, logger);
-                if (!entry) {
-                    if (entry.as_error() != FileEofError()) {
-                        txp->close([=]() { callback(entry.as_error()); });
-                        return;
-                    }
-                    close_report(
-                        txp, report_id,
-                        [=](Error err) {
-                            txp->close([=]() { callback(err); });
-                        },
-                        settings, reactor, logger);
-                    return;
+            fetch_next_and_update_impl<collector_update_report,
+                                       collector_get_next_entry,
+                                       collector_close_report,
+                                       collector_update_report_raw>(
+                ctx, (*txps)[i], settings, reactor, logger);
+        }
+    };
+    if (*pending <= 0) {
+        start();
+        return;
+    }
+    for (int i = 1; i < max_inflight; ++i) {
+        collector_connect(
+            settings,
+            [=](Error err, SharedPtr<Transport> txp) {
+                if (err) {
+                    logger->warn("collector: cannot open connection: %s",
+                                 err.what());
+                } else {
+                    txps->push_back(txp);
                 }
-                update_and_fetch_next_impl<collector_update_report,
-                                           collector_get_next_entry>(
-                    file, txp, report_id, line + 1, *entry, callback, settings,
-                    reactor, logger);
-            });
-        },
-        settings, reactor, logger);
+                if (--*pending == 0) {
+                    start();
+                }
+            },
+            reactor, logger);
+    }
 }
 
+/*
+ * We skip the first `collector/acked_entries` entries of the file. When
+ * `collector/report_id` is set, we do not create a new report and we append
+ * the remaining entries to such report. This allows to resume after a failure
+ * using the `acked_entries` of the last `status.report_submit` event. If such
+ * report has been closed, we can instead leave `collector/report_id` empty to
+ * submit the remaining entries into a new report.
+ * When `collector/acked_offset` is also set, we seek directly to such offset
+ * rather than reading the entries to skip them.
+ * Note that, with more than one entry in flight, some entries after the
+ * last acknowledged one may have already been received by the collector.
+ */
 template <MK_MOCK_AS(collector::get_next_entry, collector_get_next_entry),
           MK_MOCK_AS(collector::connect, collector_connect),
-          MK_MOCK_AS(collector::create_report, collector_create_report)>
+          MK_MOCK_AS(collector::create_report, collector_create_report),
+          MK_MOCK_AS(collector::update_report, collector_update_report),
+          MK_MOCK_AS(collector::close_report, collector_close_report),
+          MK_MOCK_AS(collector::update_report_raw, collector_update_report_raw)>
 void submit_report_impl(std::string filepath, std::string collector_base_url,
                         std::string collector_front_domain,
                         Callback<Error> callback, Settings settings,
                         SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
 
-    SharedPtr<std::istream> file(new std::ifstream(filepath));
+    ErrorOr<int> max_inflight = settings.get_noexcept(
+        "collector/max_inflight_entries", 1);
+    if (!max_inflight || *max_inflight < 1) {
+        callback(ValueError());
+        return;
+    }
+    ErrorOr<int> acked_entries = settings.get_noexcept(
+        "collector/acked_entries", 0);
+    if (!acked_entries || *acked_entries < 0) {
+        callback(ValueError());
+        return;
+    }
+    ErrorOr<bool> raw_entries = settings.get_noexcept(
+        "collector/raw_entries", false);
+    if (!raw_entries) {
+        callback(ValueError());
+        return;
+    }
+    ErrorOr<int64_t> acked_offset = settings.get_noexcept(
+        "collector/acked_offset", (int64_t)0);
+    if (!acked_offset || *acked_offset < 0) {
+        callback(ValueError());
+        return;
+    }
+    std::string report_id = settings.get("collector/report_id", std::string{});
+
+    SharedPtr<std::istream> file(new ReportFile(filepath));
     if (!file->good()) {
         callback(CannotOpenReportError());
         return;
     }
-    ErrorOr<nlohmann::json> entry = collector_get_next_entry(file, logger);
-    if (!entry) {
-        callback(entry.as_error());
-        return;
+    SharedPtr<SubmitContext> ctx{std::make_shared<SubmitContext>()};
+    ctx->callback = callback;
+    ctx->file = file;
+    ctx->raw_entries = *raw_entries;
+    if (*acked_entries > 0 || *acked_offset > 0) {
+        logger->info("resuming report %s after entry #%d",
+                     (report_id != "") ? report_id.c_str() : "(new)",
+                     *acked_entries);
+        if (*acked_offset > 0) {
+            if (!file->seekg((std::streamoff)*acked_offset)) {
+                callback(CannotOpenReportError());
+                return;
+            }
+        } else {
+            for (int i = 0; i < *acked_entries && file->good(); ++i) {
+                file->ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+        }
+        ctx->last_acked = *acked_entries;
+        ctx->acked_offset = *acked_offset;
+        ctx->next_line = *acked_entries + 1;
+    }
+    ErrorOr<nlohmann::json> entry{NoError(), nullptr};
+    std::string raw_entry;
+    int first_line = 0;
+    if (report_id == "") {
+        // We always need to parse the first entry to create the report
+        if (ctx->raw_entries) {
+            ErrorOr<std::string> line = get_next_line(file, logger);
+            if (!line) {
+                callback(line.as_error());
+                return;
+            }
+            std::swap(raw_entry, *line);
+            try {
+                entry = {NoError(), nlohmann::json::parse(raw_entry)};
+            } catch (const std::exception &) {
+                callback(JsonProcessingError());
+                return;
+            }
+        } else {
+            entry = collector_get_next_entry(file, logger);
+            if (!entry) {
+                callback(entry.as_error());
+                return;
+            }
+        }
+        first_line = ctx->next_line++;
+        ctx->read_line(first_line);
+    } else {
+        ctx->report_id = report_id;
     }
 
     settings["collector_base_url"] = collector_base_url;
@@ -359,6 +732,15 @@ void submit_report_impl(std::string filepath, std::string collector_base_url,
                 callback(err);
                 return;
             }
+            if (ctx->report_id != "") {
+                submit_entries_impl<collector_connect, collector_update_report,
+                                    collector_get_next_entry,
+                                    collector_close_report,
+                                    collector_update_report_raw>(
+                    ctx, txp, 0, nullptr, "", *max_inflight, settings,
+                    reactor, logger);
+                return;
+            }
             logger->info("creating report...");
             collector_create_report(
                 txp, *entry,
@@ -368,9 +750,14 @@ void submit_report_impl(std::string filepath, std::string collector_base_url,
                         txp->close([=]() { callback(err); });
                         return;
                     }
-                    update_and_fetch_next_impl(file, txp, report_id, 1, *entry,
-                                               callback, settings, reactor,
-                                               logger);
+                    ctx->report_id = report_id;
+                    submit_entries_impl<collector_connect,
+                                        collector_update_report,
+                                        collector_get_next_entry,
+                                        collector_close_report,
+                                        collector_update_report_raw>(
+                        ctx, txp, first_line, *entry, raw_entry,
+                        *max_inflight, settings, reactor, logger);
                 },
                 settings, reactor, logger);
         },
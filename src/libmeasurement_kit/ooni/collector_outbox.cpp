@@ -0,0 +1,183 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/file_writer.hpp"
+#include "src/libmeasurement_kit/ooni/collector_outbox_impl.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+namespace mk {
+namespace ooni {
+namespace collector {
+
+static std::string index_path(std::string dir) { return dir + "/outbox.json"; }
+
+std::string outbox_path(std::string dir, std::string name) {
+    return dir + "/" + name + ".njson";
+}
+
+ErrorOr<nlohmann::json> outbox_read_index(std::string dir) {
+    std::ifstream file(index_path(dir));
+    if (!file.is_open()) {
+        return {NoError(), nlohmann::json::object()};
+    }
+    nlohmann::json index;
+    try {
+        file >> index;
+    } catch (const std::exception &) {
+        return {JsonProcessingError(), {}};
+    }
+    if (!index.is_object()) {
+        return {JsonProcessingError(), {}};
+    }
+    return {NoError(), std::move(index)};
+}
+
+Error outbox_write_index(std::string dir, const nlohmann::json &index) {
+    // Write a new index and rename it, so that we never see a partial index
+    std::string path = index_path(dir);
+    std::string temp = path + ".tmp";
+    {
+        FileWriter file;
+        file.fsync = true;
+        Error err = file.open(temp);
+        if (err) {
+            return err;
+        }
+        file << index << '\n';
+        err = file.close();
+        if (err) {
+            return err;
+        }
+    }
+#ifdef _WIN32
+    // On Windows rename() fails if the destination exists
+    (void)std::remove(path.c_str());
+#endif
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        return FileIoError();
+    }
+    return NoError();
+}
+
+Error outbox_append(std::string dir, std::string name, std::string report_id,
+                    const std::string &entry, SharedPtr<Logger> logger) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        return index.as_error();
+    }
+    // Note: we add the report to the index before saving the entry, so
+    // we never have files not in the index (see outbox_submit())
+    bool is_new = index->count(name) == 0;
+    if (is_new) {
+        logger->debug("outbox: adding %s", name.c_str());
+        (*index)[name] = {
+            {"report_id", report_id},
+            {"acked_entries", 0},
+            {"acked_offset", 0},
+            {"failures", 0},
+        };
+        Error err = outbox_write_index(dir, *index);
+        if (err) {
+            return err;
+        }
+    }
+    FileWriter file;
+    file.append = !is_new; // Drop leftovers of a removed report
+    file.fsync = true;
+    Error err = file.open(outbox_path(dir, name));
+    if (err) {
+        return err;
+    }
+    file << entry << '\n';
+    return file.close();
+}
+
+Error outbox_update_index(std::string dir, std::string name,
+                          const nlohmann::json &progress) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        return index.as_error();
+    }
+    try {
+        // Since the collector acknowledged an entry, we reset the failures
+        (*index)[name] = {
+            {"report_id", progress.at("report_id")},
+            {"acked_entries", progress.at("acked_entries")},
+            {"acked_offset", progress.at("acked_offset")},
+            {"failures", 0},
+        };
+    } catch (const std::exception &) {
+        return JsonProcessingError();
+    }
+    return outbox_write_index(dir, *index);
+}
+
+ErrorOr<int> outbox_count_failure(std::string dir, std::string name) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        return {index.as_error(), 0};
+    }
+    int failures = 0;
+    try {
+        nlohmann::json &progress = index->at(name);
+        // Indexes written before we counted failures lack the field
+        failures = progress.value("failures", 0) + 1;
+        progress["failures"] = failures;
+    } catch (const std::exception &) {
+        return {JsonProcessingError(), 0};
+    }
+    Error err = outbox_write_index(dir, *index);
+    if (err) {
+        return {err, 0};
+    }
+    return {NoError(), failures};
+}
+
+Error outbox_reopen(std::string dir, std::string name) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        return index.as_error();
+    }
+    try {
+        index->at(name)["report_id"] = "";
+    } catch (const std::exception &) {
+        return JsonProcessingError();
+    }
+    return outbox_write_index(dir, *index);
+}
+
+bool outbox_is_rejection(Error err) {
+    return err == CollectorReportNotFoundError() ||
+           err == http::HttpRequestFailedError() ||
+           err == JsonProcessingError() || err == MissingMandatoryKeyError() ||
+           err == InvalidMandatoryValueError();
+}
+
+Error outbox_remove(std::string dir, std::string name) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        return index.as_error();
+    }
+    index->erase(name);
+    Error err = outbox_write_index(dir, *index);
+    if (err) {
+        return err;
+    }
+    // If we crash before this, outbox_append() truncates the leftover file
+    (void)std::remove(outbox_path(dir, name).c_str());
+    return NoError();
+}
+
+void outbox_submit(std::string dir, std::string collector_base_url,
+                   Callback<Error> callback, Settings settings,
+                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    outbox_submit_impl(dir, collector_base_url, callback, settings, reactor,
+                       logger);
+}
+
+} // namespace collector
+} // namespace ooni
+} // namespace mk
@@ -0,0 +1,65 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_OUTBOX_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_OUTBOX_HPP
+
+#include "src/libmeasurement_kit/ooni/collector_client.hpp"
+
+namespace mk {
+namespace ooni {
+namespace collector {
+
+/*
+    The outbox is a spool directory where we save the entries that we could
+    not submit, so that we can submit them later. The directory contains a
+    `<name>.njson` file for each spooled report and the `outbox.json` index,
+    which maps each name to an object like:
+
+        {"report_id": "", "acked_entries": 0, "acked_offset": 0,
+         "failures": 0}
+
+    where `report_id` is empty until the report has been created, the next
+    two fields tell how much of the file the collector has acknowledged
+    (see `submit_report()`), and `failures` counts the submissions that the
+    collector rejected since the last acknowledged entry. The index is
+    replaced atomically after each acknowledged entry, so submitting resumes
+    exactly where it stopped.
+*/
+
+// Appends the serialized `entry` to the spooled report `name`, adding it to
+// the index with `report_id` if it's not there. The entry is on disk when
+// this returns. An empty `report_id` in the entry is fixed when submitting.
+Error outbox_append(std::string dir, std::string name, std::string report_id,
+                    const std::string &entry, SharedPtr<Logger> logger);
+
+// Reads the index of the outbox. A missing index means an empty outbox.
+ErrorOr<nlohmann::json> outbox_read_index(std::string dir);
+
+// Atomically replaces the index of the outbox.
+Error outbox_write_index(std::string dir, const nlohmann::json &index);
+
+/*
+    Submits the reports that are in the index when it is called, one after
+    the other, removing them from the outbox once they have been closed. It
+    honours the settings of `submit_report()` except the ones used to resume,
+    which are read from the index. Reports spooled while it's running are
+    left for the next time, so it can run in the background of a test that
+    is spooling entries. On error, it continues with the next report and
+    eventually it calls `callback` with the first error.
+
+    If the collector has closed the report, e.g. because it was idle for too
+    long, the entries not acknowledged yet are submitted into a new report.
+    A report is removed from the outbox, losing its entries, once it has been
+    rejected `collector/outbox_max_failures` (int, default 10) times in a
+    row. Network errors are not counted, since the collector did not see the
+    report, so being offline for long does not empty the outbox.
+*/
+void outbox_submit(std::string dir, std::string collector_base_url,
+                   Callback<Error> callback, Settings settings,
+                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
+
+} // namespace collector
+} // namespace ooni
+} // namespace mk
+#endif
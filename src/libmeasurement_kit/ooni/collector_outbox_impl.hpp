@@ -0,0 +1,188 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_OUTBOX_IMPL_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_OUTBOX_IMPL_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include "src/libmeasurement_kit/ooni/collector_outbox.hpp"
+#include "src/libmeasurement_kit/ooni/error.hpp"
+
+#include <vector>
+
+namespace mk {
+namespace ooni {
+namespace collector {
+
+std::string outbox_path(std::string dir, std::string name);
+
+// Updates the progress of the spooled report `name` in the index
+Error outbox_update_index(std::string dir, std::string name,
+                          const nlohmann::json &progress);
+
+// Removes the spooled report `name` and its entry in the index
+Error outbox_remove(std::string dir, std::string name);
+
+// Counts a rejected submission of `name` and returns the failures so far
+ErrorOr<int> outbox_count_failure(std::string dir, std::string name);
+
+// Forgets the closed report of `name`, keeping the acknowledged entries
+Error outbox_reopen(std::string dir, std::string name);
+
+// Tells whether the collector has seen and rejected what we submitted
+bool outbox_is_rejection(Error err);
+
+// Signature of the submit_report() overload used by the outbox
+using SubmitReport = void(std::string, std::string, std::string,
+                          Callback<Error>, Settings, SharedPtr<Reactor>,
+                          SharedPtr<Logger>);
+
+template <SubmitReport *collector_submit_report = collector::submit_report>
+void outbox_submit_next_impl(std::string dir, std::string collector_base_url,
+                             SharedPtr<std::vector<std::string>> names,
+                             size_t idx, SharedPtr<Error> first_error,
+                             Callback<Error> callback, Settings settings,
+                             SharedPtr<Reactor> reactor,
+                             SharedPtr<Logger> logger) {
+    if (idx >= names->size()) {
+        callback(*first_error);
+        return;
+    }
+    auto submit_soon = [=](size_t idx) {
+        reactor->call_soon([=]() {
+            outbox_submit_next_impl<collector_submit_report>(
+                dir, collector_base_url, names, idx, first_error,
+                callback, settings, reactor, logger);
+        });
+    };
+    auto next = [=](Error err) {
+        if (err && !*first_error) {
+            *first_error = err;
+        }
+        submit_soon(idx + 1);
+    };
+    int max_failures = settings.get("collector/outbox_max_failures", 10);
+    std::string name = (*names)[idx];
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        next(index.as_error());
+        return;
+    }
+    if (index->count(name) == 0) {
+        next(NoError()); // Someone else has submitted it meanwhile
+        return;
+    }
+    Settings resume = settings;
+    resume["collector/raw_entries"] = true;
+    // Entries spooled before we moved them into a new report have the ID
+    // of the old report, which the collector has closed
+    resume["collector/replace_report_id"] = true;
+    std::string report_id;
+    try {
+        const nlohmann::json &progress = index->at(name);
+        report_id = progress.at("report_id").get<std::string>();
+        int acked_entries = progress.at("acked_entries");
+        int64_t acked_offset = progress.at("acked_offset");
+        // Without `report_id`, we submit the entries not acknowledged yet
+        // into a new report (see outbox_reopen())
+        if (report_id != "") {
+            resume["collector/report_id"] = report_id;
+        } else {
+            resume.erase("collector/report_id");
+        }
+        resume["collector/acked_entries"] = acked_entries;
+        resume["collector/acked_offset"] = acked_offset;
+    } catch (const std::exception &) {
+        logger->warn("outbox: invalid index entry for %s", name.c_str());
+        next(JsonProcessingError());
+        return;
+    }
+
+    // We use a private logger to know the progress of this report only
+    SharedPtr<Logger> sublogger = Logger::make();
+    sublogger->set_verbosity(logger->get_verbosity());
+    sublogger->on_log([logger](uint32_t level, const char *s) {
+        logger->logs(level, s);
+    });
+    sublogger->on_event_ex("status.report_submit",
+                           [=](nlohmann::json &&event) {
+        nlohmann::json progress = std::move(event.at("value"));
+        Error err = outbox_update_index(dir, name, progress);
+        if (err) {
+            logger->warn("outbox: cannot save progress of %s: %s",
+                         name.c_str(), err.what());
+        }
+        logger->emit_event_ex("status.report_submit", std::move(progress));
+    });
+
+    logger->info("outbox: submitting %s...", name.c_str());
+    collector_submit_report(
+        outbox_path(dir, name), collector_base_url, "",
+        [=](Error err) {
+            logger->info("outbox: submitting %s... %d", name.c_str(),
+                         err.code);
+            // We may crash after adding the report to the index and before
+            // saving its first entry, so an empty new report is fine
+            if (!err || (err == FileEofError() && report_id == "")) {
+                next(outbox_remove(dir, name));
+                return;
+            }
+            if (!outbox_is_rejection(err)) {
+                next(err);
+                return;
+            }
+            ErrorOr<int> failures = outbox_count_failure(dir, name);
+            if (!failures) {
+                logger->warn("outbox: cannot count failures of %s: %s",
+                             name.c_str(), failures.as_error().what());
+                next(err);
+                return;
+            }
+            if (*failures >= max_failures) {
+                logger->warn("outbox: dropping %s after %d failures",
+                             name.c_str(), *failures);
+                Error remove_err = outbox_remove(dir, name);
+                next(remove_err ? remove_err : err);
+                return;
+            }
+            if (err == CollectorReportNotFoundError()) {
+                logger->warn("outbox: the collector closed the report of %s, "
+                             "moving its entries into a new report",
+                             name.c_str());
+                Error reopen_err = outbox_reopen(dir, name);
+                if (reopen_err) {
+                    next(reopen_err);
+                    return;
+                }
+                submit_soon(idx);
+                return;
+            }
+            next(err);
+        },
+        resume, reactor, sublogger);
+}
+
+template <SubmitReport *collector_submit_report = collector::submit_report>
+void outbox_submit_impl(std::string dir, std::string collector_base_url,
+                        Callback<Error> callback, Settings settings,
+                        SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    ErrorOr<nlohmann::json> index = outbox_read_index(dir);
+    if (!index) {
+        callback(index.as_error());
+        return;
+    }
+    SharedPtr<std::vector<std::string>> names{
+        std::make_shared<std::vector<std::string>>()};
+    for (auto it = index->begin(); it != index->end(); ++it) {
+        names->push_back(it.key());
+    }
+    outbox_submit_next_impl<collector_submit_report>(
+        dir, collector_base_url, names, 0, SharedPtr<Error>{new Error},
+        callback, settings, reactor, logger);
+}
+
+} // namespace collector
+} // namespace ooni
+} // namespace mk
+#endif
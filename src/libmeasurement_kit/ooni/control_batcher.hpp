@@ -0,0 +1,179 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_CONTROL_BATCHER_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_CONTROL_BATCHER_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
+#include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/http/http.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mk {
+namespace ooni {
+
+/*
+    Sets up `settings` and `headers` for POSTing control requests, either
+    alone or in a batch, to the test helper in `settings["backend"]`.
+
+    We want a larger timeout when communicating with the OONI backend
+    because it may take time for the backend to retrieve a web page and
+    we don't want to recv() to timeout too soon.
+
+    See <https://github.com/measurement-kit/measurement-kit/issues/1864>.
+*/
+static inline void prepare_control_request(Settings &settings,
+                                           http::Headers &headers) {
+    settings["net/timeout"] = 30.0;
+    settings["http/url"] = settings["backend"];
+    settings["http/method"] = "POST";
+    settings["http/decode_content"] = true;
+    settings["net/connect_priority"] = "control";
+    headers_push_back(headers, "Content-Type", "application/json");
+}
+
+/*
+    Sends the web_connectivity control requests of the measurements that are
+    in flight using a single POST to the test helper, which must support the
+    batch format below. The OONI test helpers do not support it: it is only
+    meant for experimenting with custom test helpers, hence batching is off
+    unless `backend_batch_size` is larger than one. That is, we send
+
+        {"requests": [request, ...]}
+
+    where each request is what we would otherwise send alone, and we expect
+
+        {"responses": [response, ...]}
+
+    where each response is what we would otherwise receive, in the same order
+    as the requests. If the reply is not like this, all the requests fail with
+    JsonProcessingError, which web_connectivity reports as "json_parse_error",
+    like it does with a single request. A batch is sent when it contains
+    `batch_size` requests or when its first request has been waiting for
+    `batch_delay` seconds.
+
+    Since web_connectivity sends the control request right after resolving
+    the domain, the measurements running in parallel queue their requests at
+    about the same time, and each batch can be as large as the parallelism.
+*/
+class ControlBatcher : public NonCopyable, public NonMovable {
+  public:
+    // Queues `request` and eventually calls `cb` with the response
+    virtual void query(nlohmann::json request,
+                       Callback<Error, nlohmann::json> cb) = 0;
+
+    virtual ~ControlBatcher() {}
+};
+
+template <MK_MOCK_AS(http::request, http_request)>
+class ControlBatcherImpl : public ControlBatcher,
+                           public EnableSharedFromThis<ControlBatcherImpl<
+                                   http_request>> {
+  public:
+    static SharedPtr<ControlBatcherImpl> make(size_t batch_size,
+                                              double batch_delay,
+                                              Settings settings,
+                                              SharedPtr<Reactor> reactor,
+                                              SharedPtr<Logger> logger) {
+        SharedPtr<ControlBatcherImpl> batcher{new ControlBatcherImpl};
+        batcher->batch_size_ = std::max(batch_size, (size_t)1);
+        batcher->batch_delay_ = batch_delay;
+        batcher->settings_ = settings;
+        batcher->reactor_ = reactor;
+        batcher->logger_ = logger;
+        return batcher;
+    }
+
+    void query(nlohmann::json request,
+               Callback<Error, nlohmann::json> cb) override {
+        pending_.emplace_back(std::move(request), std::move(cb));
+        if (pending_.size() >= batch_size_) {
+            flush_();
+            return;
+        }
+        if (pending_.size() == 1) {
+            auto self = this->shared_from_this();
+            uint64_t batch = batch_id_;
+            reactor_->call_later(batch_delay_, [self, batch]() {
+                if (batch == self->batch_id_) {
+                    self->flush_();
+                }
+            });
+        }
+    }
+
+  private:
+    using Pending = std::vector<
+            std::pair<nlohmann::json, Callback<Error, nlohmann::json>>>;
+
+    size_t batch_size_ = 1;
+    double batch_delay_ = 0.0;
+    Settings settings_;
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+    Pending pending_;
+    uint64_t batch_id_ = 0; /* Tells stale timers that we already flushed */
+
+    ControlBatcherImpl() {}
+
+    void flush_() {
+        Pending batch;
+        std::swap(batch, pending_);
+        batch_id_ += 1;
+
+        nlohmann::json request;
+        request["requests"] = nlohmann::json::array();
+        for (auto &p : batch) {
+            request["requests"].push_back(std::move(p.first));
+        }
+
+        Settings settings = settings_;
+        http::Headers headers;
+        prepare_control_request(settings, headers);
+
+        logger_->info("Sending %lu control requests to %s",
+                      (unsigned long)batch.size(),
+                      settings["backend"].c_str());
+        SharedPtr<Logger> logger = logger_;
+        http_request(
+                settings, headers, request.dump(),
+                [batch, logger](Error error,
+                                SharedPtr<http::Response> response) {
+                    nlohmann::json responses;
+                    if (!error) {
+                        try {
+                            responses = nlohmann::json::parse(response->body)
+                                                .at("responses");
+                            if (!responses.is_array() ||
+                                responses.size() != batch.size()) {
+                                error = JsonProcessingError();
+                            }
+                        } catch (const std::exception &) {
+                            error = JsonProcessingError();
+                        }
+                    }
+                    if (error) {
+                        logger->warn("control batch error: %s", error.what());
+                    }
+                    for (size_t i = 0; i < batch.size(); ++i) {
+                        if (error) {
+                            batch[i].second(error, nullptr);
+                            continue;
+                        }
+                        batch[i].second(NoError(), std::move(responses[i]));
+                    }
+                },
+                reactor_, logger_, nullptr, 0);
+    }
+};
+
+} // namespace ooni
+} // namespace mk
+#endif
@@ -59,6 +59,8 @@ MK_DEFINE_ERR(MK_ERR_OONI(28), RegistryInvalidRequestError,
               "registry_invalid_request")
 MK_DEFINE_ERR(MK_ERR_OONI(29), RegistryEmptyClientIdError,
               "registry_empty_client_id")
+MK_DEFINE_ERR(MK_ERR_OONI(30), CollectorReportNotFoundError,
+              "collector_report_not_found")
 
 } // namespace mk
 } // namespace ooni
@@ -17,6 +17,8 @@ namespace ooni {
 
 static const std::string FB_ASN = "AS32934";
 
+constexpr size_t tcp_parallelism = 16;
+
 static const std::map<std::string, std::string> &FB_SERVICE_HOSTNAMES = {
       {"stun", "stun.fbsbx.com"},
       {"b_api", "b-api.facebook.com"},
@@ -124,58 +126,6 @@ tcp_many(Error error, SharedPtr<nlohmann::json> entry,
         cb(entry);
         return;
     }
-    SharedPtr<size_t> ips_tested(new size_t(0));
-
-    auto tcp_cb = [=](std::string service, std::string ip, uint16_t port,
-            bool this_ip_consistent) {
-        return [=](Error err, SharedPtr<net::Transport> txp) {
-            assert(!!txp);
-            nlohmann::json current_entry{
-                  {"ip", ip}, {"port", port}, {"status", nullptr}};
-            if (!!err) {
-                logger->info("tcp failure to %s at %s:%d", service.c_str(),
-                             ip.c_str(), port);
-                current_entry["status"]["success"] = false;
-                current_entry["status"]["failure"] = true;
-            } else {
-                logger->info("tcp success to %s at %s:%d", service.c_str(),
-                             ip.c_str(), port);
-                if (this_ip_consistent) {
-                    (*entry)["facebook_" + service + "_reachable"] = true;
-                }
-                current_entry["status"]["success"] = true;
-                current_entry["status"]["failure"] = false;
-            }
-            (*entry)["tcp_connect"].push_back(std::move(current_entry));
-            *ips_tested += 1;
-            assert(*ips_tested <= ips_count);
-            if (ips_count == *ips_tested) {
-                // if ANY services were TCP unreachable on all consistent IPs,
-                // switch this to true.
-                (*entry)["facebook_tcp_blocking"] = false;
-                for (auto const &service_and_hostname : FB_SERVICE_HOSTNAMES) {
-                    std::string service = service_and_hostname.first;
-                    if (service == "stun") { continue; }
-                    bool consistent =
-                        !!(*entry)["facebook_" + service + "_dns_consistent"];
-                    bool reachable =
-                        !!(*entry)["facebook_" + service + "_reachable"];
-                    logger->info("service %s DNS consistency: %s",
-                        service.c_str(), (!!consistent) ? "true" : "false");
-                    logger->info("service %s TCP reachability: %s",
-                        service.c_str(), (!!reachable) ? "true" : "false");
-                    if (consistent && !reachable) {
-                        (*entry)["facebook_tcp_blocking"] = true;
-                    }
-                }
-                txp->close([=] {
-                    cb(entry);
-                });
-            } else {
-                txp->close([=] {});
-            }
-        };
-    };
 
     // if we can TCP connect to ANY consistent IP for a service,
     // switch this to true.
@@ -186,7 +136,13 @@ tcp_many(Error error, SharedPtr<nlohmann::json> entry,
     // we're skipping stun like ooni-probe does
     (*entry)["facebook_stun_reachable"] = nullptr;
 
-
+    struct Attempt {
+        std::string service;
+        templates::TcpEndpoint endpoint;
+        bool ip_consistent;
+    };
+    SharedPtr<std::vector<Attempt>> attempts(new std::vector<Attempt>);
+    std::vector<templates::TcpEndpoint> endpoints;
     for (auto const &service_and_ips : *fb_service_ips) {
         std::string service = service_and_ips.first;
         // if ANY ips for this service are in FB's ASN, switch to true
@@ -203,13 +159,11 @@ tcp_many(Error error, SharedPtr<nlohmann::json> entry,
             if (service == "stun") {
                 continue;
             }
-            Settings tcp_options{options};
-            tcp_options["host"] = ip;
-            uint16_t port = 443;
-            tcp_options["port"] = port;
-            tcp_options["net/timeout"] = 10.0;
-            templates::tcp_connect(tcp_options,
-                tcp_cb(service, ip, port, this_ip_consistent), reactor, logger);
+            // Services share front-end addresses, so we plan the connects
+            // and then connect once to each distinct endpoint
+            templates::TcpEndpoint endpoint{ip, 443};
+            attempts->push_back({service, endpoint, this_ip_consistent});
+            endpoints.push_back(endpoint);
         }
     }
     // if ANY services are not DNS consistent, switch this to true
@@ -225,7 +179,52 @@ tcp_many(Error error, SharedPtr<nlohmann::json> entry,
         }
     }
 
-
+    Settings tcp_options{options};
+    tcp_options["net/timeout"] = 10.0;
+    templates::tcp_connect_many(endpoints, tcp_parallelism, tcp_options,
+            [=](std::map<templates::TcpEndpoint, Error> results) {
+        for (auto const &attempt : *attempts) {
+            const std::string &service = attempt.service;
+            const std::string &ip = attempt.endpoint.first;
+            int port = attempt.endpoint.second;
+            nlohmann::json current_entry{
+                  {"ip", ip}, {"port", port}, {"status", nullptr}};
+            if (!!results.at(attempt.endpoint)) {
+                logger->info("tcp failure to %s at %s:%d", service.c_str(),
+                             ip.c_str(), port);
+                current_entry["status"]["success"] = false;
+                current_entry["status"]["failure"] = true;
+            } else {
+                logger->info("tcp success to %s at %s:%d", service.c_str(),
+                             ip.c_str(), port);
+                if (attempt.ip_consistent) {
+                    (*entry)["facebook_" + service + "_reachable"] = true;
+                }
+                current_entry["status"]["success"] = true;
+                current_entry["status"]["failure"] = false;
+            }
+            (*entry)["tcp_connect"].push_back(std::move(current_entry));
+        }
+        // if ANY services were TCP unreachable on all consistent IPs,
+        // switch this to true.
+        (*entry)["facebook_tcp_blocking"] = false;
+        for (auto const &service_and_hostname : FB_SERVICE_HOSTNAMES) {
+            std::string service = service_and_hostname.first;
+            if (service == "stun") { continue; }
+            bool consistent =
+                !!(*entry)["facebook_" + service + "_dns_consistent"];
+            bool reachable =
+                !!(*entry)["facebook_" + service + "_reachable"];
+            logger->info("service %s DNS consistency: %s",
+                service.c_str(), (!!consistent) ? "true" : "false");
+            logger->info("service %s TCP reachability: %s",
+                service.c_str(), (!!reachable) ? "true" : "false");
+            if (consistent && !reachable) {
+                (*entry)["facebook_tcp_blocking"] = true;
+            }
+        }
+        cb(entry);
+    }, reactor, logger);
 }
 
 void facebook_messenger(Settings options, Callback<SharedPtr<nlohmann::json>> callback,
@@ -6,6 +6,7 @@
 
 #include "src/libmeasurement_kit/common/settings.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/ooni/control_batcher.hpp"
 
 namespace mk {
 namespace ooni {
@@ -26,6 +27,12 @@ void web_connectivity(std::string input, Settings,
                       Callback<SharedPtr<nlohmann::json>>,
                       SharedPtr<Reactor>, SharedPtr<Logger>);
 
+// Like above, but the control request is sent by `control_batcher`, if set
+void web_connectivity(std::string input, Settings,
+                      Callback<SharedPtr<nlohmann::json>>,
+                      SharedPtr<ControlBatcher> control_batcher,
+                      SharedPtr<Reactor>, SharedPtr<Logger>);
+
 void meek_fronted_requests(std::string input, Settings,
                            Callback<SharedPtr<nlohmann::json>>,
                            SharedPtr<Reactor>, SharedPtr<Logger>);
@@ -122,6 +122,13 @@ void tcp_connect(Settings options,
     net::connect(options["host"], *port, cb, options, reactor, logger);
 }
 
+void tcp_connect_many(std::vector<TcpEndpoint> endpoints, size_t parallelism,
+        Settings options, Callback<std::map<TcpEndpoint, Error>> cb,
+        SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    tcp_connect_many_impl<tcp_connect>(endpoints, parallelism, options, cb,
+                                       reactor, logger);
+}
+
 } // namespace templates
 } // namespace ooni
 } // namespace mk
@@ -9,6 +9,10 @@
 #include "src/libmeasurement_kit/dns/query.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
 
+#include <map>
+#include <utility>
+#include <vector>
+
 namespace mk {
 namespace ooni {
 namespace templates {
@@ -25,6 +29,17 @@ void http_request(SharedPtr<nlohmann::json> entry, Settings settings, http::Head
 void tcp_connect(Settings options, Callback<Error, SharedPtr<net::Transport>> cb,
                  SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
 
+using TcpEndpoint = std::pair<std::string, int>;
+
+// Connects once to each distinct endpoint in `endpoints`, with at most
+// `parallelism` connects in flight, closes the connections, and calls
+// `cb` with the result of each distinct endpoint. Use it when several
+// hostnames resolve to the same addresses.
+void tcp_connect_many(std::vector<TcpEndpoint> endpoints, size_t parallelism,
+                      Settings options,
+                      Callback<std::map<TcpEndpoint, Error>> cb,
+                      SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
+
 } // namespace templates
 } // namespace mk
 } // namespace ooni
@@ -7,10 +7,15 @@
 #include <event2/dns.h>
 
 #include "src/libmeasurement_kit/ooni/error.hpp"
+#include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/parallel.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
 #include "src/libmeasurement_kit/net/emitter.hpp"
+#include "src/libmeasurement_kit/ooni/templates.hpp"
 #include "src/libmeasurement_kit/ooni/utils.hpp"
 
+#include <set>
+
 namespace mk {
 namespace ooni {
 namespace templates {
@@ -77,6 +82,9 @@ void http_request_impl(SharedPtr<nlohmann::json> entry, Settings settings,
                         /*
                         * Note: `probe_ip` comes from an external service, hence
                         * we MUST call `represent_string` _after_ `redact()`.
+                        *
+                        * Also, since `redact()` returns a temporary, it is
+                        * moved into the entry, and the body is copied once.
                         */
                         for (auto h : response->headers) {
                             rr["response"]["headers"][h.key] =
@@ -126,6 +134,46 @@ void http_request_impl(SharedPtr<nlohmann::json> entry, Settings settings,
         reactor, logger, {}, 0);
 }
 
+// Mockable implementation of tcp_connect_many(), such that regress tests
+// can count the connects without using the network.
+template <MK_MOCK_AS(tcp_connect, mocked_tcp_connect)>
+void tcp_connect_many_impl(std::vector<TcpEndpoint> endpoints,
+        size_t parallelism, Settings options,
+        Callback<std::map<TcpEndpoint, Error>> cb,
+        SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    std::set<TcpEndpoint> seen;
+    std::vector<TcpEndpoint> unique;
+    for (auto &endpoint : endpoints) {
+        if (seen.insert(endpoint).second) {
+            unique.push_back(endpoint);
+        }
+    }
+    logger->debug("tcp_connect_many: %lu distinct endpoints out of %lu",
+                  (unsigned long)unique.size(),
+                  (unsigned long)endpoints.size());
+    std::vector<Continuation<Error>> input;
+    for (auto &endpoint : unique) {
+        Settings local_options = options;
+        local_options["host"] = endpoint.first;
+        local_options["port"] = endpoint.second;
+        input.push_back([=](Callback<Error> cb) {
+            mocked_tcp_connect(local_options,
+                    [=](Error err, SharedPtr<net::Transport> txp) {
+                        txp->close(nullptr);
+                        cb(err);
+                    },
+                    reactor, logger);
+        });
+    }
+    mk::parallel(input, [=](Error overall) {
+        std::map<TcpEndpoint, Error> results;
+        for (size_t i = 0; i < unique.size(); ++i) {
+            results[unique[i]] = overall.child_errors[i];
+        }
+        cb(std::move(results));
+    }, parallelism);
+}
+
 } // namespace templates
 } // namespace ooni
 } // namespace mk
@@ -15,32 +15,50 @@ void resolver_lookup(Callback<Error, std::string> callback, Settings settings,
     resolver_lookup_impl(callback, settings, reactor, logger);
 }
 
-std::string extract_html_title(std::string body) {
-  return regexp::html_extract_title(body);
+std::string extract_html_title(const std::string &body, size_t max_length) {
+  return regexp::html_extract_title(body, max_length);
 }
 
 bool is_private_ipv4_addr(const std::string &ipv4_addr) {
   return regexp::private_ipv4(ipv4_addr);
 }
 
-nlohmann::json represent_string(const std::string &s) {
+bool is_private_ip_addr(const std::string &ip_addr) {
+  return regexp::private_ipv4(ip_addr) || regexp::private_ipv6(ip_addr);
+}
+
+nlohmann::json represent_string(std::string s) {
     Error error = utf8_parse(s);
     if (error != NoError()) {
         return nlohmann::json{{"format", "base64"},
                               {"data", base64_encode(s)}};
     }
-    return s;
+    return nlohmann::json(std::move(s));
 }
 
 std::string scrub(std::string s, std::string real_probe_ip) {
-    size_t p = 0;
-    while ((p = s.find(real_probe_ip, p)) != std::string::npos) {
-        s = s.replace(p, real_probe_ip.size(), "[REDACTED]");
+    if (real_probe_ip.empty()) {
+        return s;
     }
-    return s;
+    size_t p = s.find(real_probe_ip);
+    if (p == std::string::npos) {
+        return s; // Most common case, in which we do not copy
+    }
+    // Build the result in a single pass, rather than replacing in place,
+    // which shifts the rest of the string for each occurrence
+    std::string result;
+    result.reserve(s.size() + 16);
+    size_t prev = 0;
+    do {
+        result.append(s, prev, p - prev);
+        result.append("[REDACTED]");
+        prev = p + real_probe_ip.size();
+    } while ((p = s.find(real_probe_ip, prev)) != std::string::npos);
+    result.append(s, prev, std::string::npos);
+    return result;
 }
 
-std::string redact(Settings settings, std::string s) {
+std::string redact(const Settings &settings, std::string s) {
     /*
      * XXX probe ip passed down the stack to allow us to scrub it from the
      * entry; see issue #1110 for plans to make this better.
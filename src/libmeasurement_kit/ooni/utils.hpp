@@ -6,14 +6,19 @@
 
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/dns/query.hpp"
+#include "src/libmeasurement_kit/regexp/regexp.hpp"
 
 namespace mk {
 namespace ooni {
 
-std::string extract_html_title(std::string body);
+std::string extract_html_title(
+        const std::string &body,
+        size_t max_length = regexp::html_title_scan_length);
 
 bool is_private_ipv4_addr(const std::string &ipv4_addr);
 
+bool is_private_ip_addr(const std::string &ip_addr);
+
 std::string scrub(
         std::string orig,
         std::string real_probe_ip
@@ -22,9 +27,10 @@ std::string scrub(
 void resolver_lookup(Callback<Error, std::string> callback, Settings,
                      SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
 
-nlohmann::json represent_string(const std::string &s);
+// Takes `s` by value, such that we move temporaries into the JSON
+nlohmann::json represent_string(std::string s);
 
-std::string redact(Settings settings, std::string s);
+std::string redact(const Settings &settings, std::string s);
 
 } // namespace ooni
 } // namespace mk
@@ -2,6 +2,7 @@
 // Measurement Kit is free software under the BSD license. See AUTHORS
 // and LICENSE for more information on the copying conditions.
 
+#include "src/libmeasurement_kit/common/parallel.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/constants.hpp"
 #include "src/libmeasurement_kit/ooni/nettests.hpp"
@@ -23,7 +24,7 @@ typedef std::vector<std::pair<std::string, int>> SocketList;
 
 static void compare_http_requests(SharedPtr<nlohmann::json> entry,
                                   SharedPtr<http::Response> response, nlohmann::json control,
-                                  SharedPtr<Logger> logger) {
+                                  Settings options, SharedPtr<Logger> logger) {
 
     // The response may be null if HTTP fails due to network errors
     if (!response) {
@@ -118,7 +119,10 @@ static void compare_http_requests(SharedPtr<nlohmann::json> entry,
 
     // Check if the HTML titles match
     logger->debug("web_connectivity: checking HTML titles");
-    std::string experiment_title = extract_html_title(response->body);
+    int64_t scan_length = options.get("html_title_scan_length",
+            (int64_t)regexp::html_title_scan_length);
+    std::string experiment_title = extract_html_title(response->body,
+            (scan_length > 0) ? (size_t)scan_length : response->body.size());
     std::vector<std::string> exp_title_words;
     std::vector<std::string> ctrl_title_words;
 
@@ -176,7 +180,7 @@ static void compare_dns_queries(mk::http::Url url, SharedPtr<nlohmann::json> ent
     }
 
     for (auto exp_addr : exp_addresses) {
-        if (is_private_ipv4_addr(exp_addr) == true) {
+        if (is_private_ip_addr(exp_addr) == true) {
             (*entry)["dns_consistency"] = "inconsistent";
             return;
         }
@@ -268,7 +272,8 @@ static void compare_control_experiment(std::string input, SharedPtr<nlohmann::js
         (*entry)["control"]["http_request"]["failure"] == nullptr) {
         logger->debug("web_connectivity: comparing http_requests");
         compare_http_requests(entry, response,
-                              (*entry)["control"]["http_request"], logger);
+                              (*entry)["control"]["http_request"], options,
+                              logger);
     }
 
     logger->debug("web_connectivity: comparing dns_queries");
@@ -351,6 +356,7 @@ static void compare_control_experiment(std::string input, SharedPtr<nlohmann::js
 static void control_request(http::Headers headers_to_pass_along,
                             SharedPtr<nlohmann::json> entry, SocketList socket_list,
                             std::string url, Callback<Error> callback,
+                            SharedPtr<ControlBatcher> control_batcher,
                             Settings settings, SharedPtr<Reactor> reactor,
                             SharedPtr<Logger> logger) {
 
@@ -366,7 +372,7 @@ static void control_request(http::Headers headers_to_pass_along,
     for (auto socket : socket_list) {
         // Formats the sockets as IP:PORT
         std::ostringstream ss;
-        if (is_private_ipv4_addr(socket.first) == true) {
+        if (is_private_ip_addr(socket.first) == true) {
             continue;
         }
         ss << socket.first;
@@ -387,17 +393,31 @@ static void control_request(http::Headers headers_to_pass_along,
         true_headers[h.key].push_back(h.value);
     }
     request["http_request_headers"] = true_headers;
+
+    if (control_batcher) {
+        control_batcher->query(std::move(request),
+                               [=](Error error, nlohmann::json doc) {
+                                   if (error == JsonProcessingError()) {
+                                       // Like a single request (see below)
+                                       (*entry)["control_failure"] =
+                                           "json_parse_error";
+                                       callback(error);
+                                       return;
+                                   }
+                                   if (error) {
+                                       (*entry)["control_failure"] =
+                                           error.reason;
+                                       callback(error);
+                                       return;
+                                   }
+                                   (*entry)["control"] = std::move(doc);
+                                   callback(NoError());
+                               });
+        return;
+    }
     std::string body = request.dump();
 
-    /* We want a larger timeout when communicating with the OONI backend
-     * because it may take time for the backend to retrieve a web page and
-     * we don't want to recv() to timeout too soon.
-     *
-     * See <https://github.com/measurement-kit/measurement-kit/issues/1864>. */
-    settings["net/timeout"] = 30.0;
-    settings["http/url"] = settings["backend"];
-    settings["http/method"] = "POST";
-    headers_push_back(headers, "Content-Type", "application/json");
+    prepare_control_request(settings, headers);
 
     if (settings["backend/type"] == "cloudfront") {
         // TODO set the appropriate headers to support cloud-fronting.
@@ -432,10 +452,11 @@ static void control_request(http::Headers headers_to_pass_along,
 
 static void experiment_http_request(
         SharedPtr<nlohmann::json> entry, std::string url,
-        Callback<Error, http::Headers, SharedPtr<http::Response>> cb,
+        Callback<Error, SharedPtr<http::Response>> cb,
         Settings options, SharedPtr<Reactor> reactor,
         SharedPtr<Logger> logger) {
 
+    // Note: the control request passes along these same headers
     http::Headers headers = constants::COMMON_CLIENT_HEADERS;
     std::string body;
     options["http/url"] = url;
@@ -457,10 +478,10 @@ static void experiment_http_request(
                                 if (err) {
                                     (*entry)["http_experiment_failure"] =
                                         err.reason;
-                                    cb(err, headers, response);
+                                    cb(err, response);
                                     return;
                                 }
-                                cb(NoError(), headers, response);
+                                cb(NoError(), response);
                             },
                             reactor, logger);
 }
@@ -573,6 +594,13 @@ static void experiment_dns_query(
 void web_connectivity(std::string input, Settings options,
                       Callback<SharedPtr<nlohmann::json>> callback, SharedPtr<Reactor> reactor,
                       SharedPtr<Logger> logger) {
+    web_connectivity(input, options, callback, nullptr, reactor, logger);
+}
+
+void web_connectivity(std::string input, Settings options,
+                      Callback<SharedPtr<nlohmann::json>> callback,
+                      SharedPtr<ControlBatcher> control_batcher,
+                      SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
 
     logger->emit_event_ex("status.update.websites", {
         {"url", input},
@@ -631,66 +659,75 @@ void web_connectivity(std::string input, Settings options,
                 logger->warn("web_connectivity: dns-query error: %s",
                              err.what());
             }
-            logger->info("web_connectivity: starting tcp_connect");
-
             SocketList socket_list;
             for (auto addr : addresses) {
                 socket_list.push_back(std::make_pair(addr, url->port));
             }
 
-            experiment_tcp_connect(
-                entry, socket_list,
-                [=](Error err) {
-
-                    if (err) {
-                        logger->warn("web_connectivity: tcp-connect error: %s",
-                                     err.what());
-                    }
-
-                    logger->info(
-                        "web_connectivity: starting http_request to %s",
-                        input.c_str());
-                    experiment_http_request(
-                        entry, input,
-                        [=](Error err, http::Headers request_headers,
-                            SharedPtr<http::Response> response) {
+            // The control request only depends on the URL, on the sockets
+            // and on the headers we send, so we run it in parallel with the
+            // TCP connect and HTTP steps, rather than after them.
+            auto response = SharedPtr<SharedPtr<http::Response>>::make();
+            mk::parallel({
+                [=](Callback<Error> cb) {
+                    logger->info("web_connectivity: starting tcp_connect");
+                    experiment_tcp_connect(
+                        entry, socket_list,
+                        [=](Error err) {
 
                             if (err) {
-                                logger->warn(
-                                    "web_connectivity: http-request error: %s",
-                                    err.what());
+                                logger->warn("web_connectivity: tcp-connect "
+                                             "error: %s",
+                                             err.what());
                             }
 
                             logger->info(
-                                "web_connectivity: doing control request");
-                            control_request(
-                                request_headers, entry,
-                                socket_list, input,
-                                [=](Error err) {
+                                "web_connectivity: starting http_request to %s",
+                                input.c_str());
+                            experiment_http_request(
+                                entry, input,
+                                [=](Error err,
+                                    SharedPtr<http::Response> res) {
 
                                     if (err) {
                                         logger->warn("web_connectivity: "
-                                                     "control-request error: "
-                                                     "%s",
+                                                     "http-request error: %s",
                                                      err.what());
                                     }
-
-                                    logger->info("web_connectivity: comparing "
-                                                 "control with experiment");
-                                    compare_control_experiment(
-                                        input, entry, response, addresses,
-                                        options, logger, *url);
-                                    callback(entry);
+                                    *response = res;
+                                    cb(err);
 
                                 },
-                                options, reactor,
-                                logger); // end control_request
+                                options, reactor, logger); // end http_request
 
                         },
-                        options, reactor, logger); // end http_request
+                        reactor, logger); // end tcp_connect
+                },
+                [=](Callback<Error> cb) {
+                    logger->info("web_connectivity: doing control request");
+                    control_request(
+                        constants::COMMON_CLIENT_HEADERS, entry, socket_list,
+                        input,
+                        [=](Error err) {
 
+                            if (err) {
+                                logger->warn("web_connectivity: "
+                                             "control-request error: %s",
+                                             err.what());
+                            }
+                            cb(err);
+
+                        },
+                        control_batcher, options, reactor,
+                        logger); // end control_request
                 },
-                reactor, logger); // end tcp_connect
+            }, [=](Error) {
+                logger->info("web_connectivity: comparing control with "
+                             "experiment");
+                compare_control_experiment(input, entry, *response, addresses,
+                                           options, logger, *url);
+                callback(entry);
+            });
 
         },
         options, reactor, logger); // end dns_query
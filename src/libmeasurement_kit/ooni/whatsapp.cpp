@@ -9,6 +9,7 @@
 #include "src/libmeasurement_kit/common/parallel.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/templates.hpp"
+#include "src/libmeasurement_kit/net/prefix_trie.hpp"
 #include "src/libmeasurement_kit/net/utils.hpp"
 #include "src/libmeasurement_kit/ooni/error.hpp"
 
@@ -200,6 +201,26 @@ bool ip_in_nets(std::string ip, std::vector<std::string> nets) {
     return false;
 }
 
+bool ip_in_whatsapp_nets(const std::string &ip) {
+    // Built once, since WHATSAPP_NETS does not change (and the C++11
+    // initialization of function-local statics is thread safe)
+    static const net::PrefixTrie nets = []() {
+        net::PrefixTrie trie;
+        for (auto &net : WHATSAPP_NETS) {
+            Error err = trie.add(net);
+            assert(!err);
+            (void)err;
+        }
+        return trie;
+    }();
+    return nets.contains(ip);
+}
+
+// Hostnames often resolve to the same addresses, so we connect once to
+// each distinct endpoint (with bounded parallelism) and then report the
+// result for every hostname, as if we had connected for each of them.
+constexpr size_t tcp_parallelism = 16;
+
 static void tcp_many(host_to_ips_t host_to_ips, SharedPtr<nlohmann::json> entry,
         Settings options, SharedPtr<Reactor> reactor,
         SharedPtr<Logger> logger, Callback<Error> cb) {
@@ -213,51 +234,24 @@ static void tcp_many(host_to_ips_t host_to_ips, SharedPtr<nlohmann::json> entry,
     // at the end, we copy these ^ hostnames into the report:
     (*entry)["whatsapp_endpoints_blocked"] = nlohmann::json::array();
     size_t ips_count = 0;
-    SharedPtr<size_t> ips_tested(new size_t(0));
     for (auto const& hostname_ipv : host_to_ips) {
         blocked_hostnames->insert(hostname_ipv.first);
         ips_count += hostname_ipv.second.size() * 2; // two ports per IP
     }
 
-    auto tcp_cb = [=](std::string hostname, std::string ip, int port,
-                      bool this_ip_consistent) {
-        return [=](Error connect_err, SharedPtr<net::Transport> txp) {
-            nlohmann::json result = {
-                    {"ip", ip}, {"port", port},
-                    {"status", {{"success", nullptr}, {"failure", nullptr}}},
-            };
-            if (!!connect_err) {
-                logger->info("tcp failure to %s:%d", ip.c_str(), port);
-                result["status"]["success"] = false;
-                result["status"]["failure"] = connect_err.reason;
-            } else {
-                logger->info("tcp success to %s:%d", ip.c_str(), port);
-                result["status"]["success"] = true;
-                result["status"]["failure"] = nullptr;
-                if (this_ip_consistent) {
-                    logger->info("removing %s from blocked_hostnames",
-                            hostname.c_str());
-                    (*entry)["whatsapp_endpoints_status"] = "ok";
-                    blocked_hostnames->erase(hostname);
-                }
-            }
-            (*entry)["tcp_connect"].push_back(result);
-            txp->close(nullptr);
-            *ips_tested += 1;
-            if (ips_count == *ips_tested) {
-                for (auto const& hostname : *blocked_hostnames) {
-                    (*entry)["whatsapp_endpoints_blocked"].push_back(hostname);
-                }
-                cb(NoError());
-            }
-        };
-    };
-
     // this is needed in case dns_many() returns no ips
     if (ips_count == 0) {
         cb(NoError());
         return;
     }
+
+    struct Attempt {
+        std::string hostname;
+        templates::TcpEndpoint endpoint;
+        bool ip_consistent;
+    };
+    SharedPtr<std::vector<Attempt>> attempts(new std::vector<Attempt>);
+    std::vector<templates::TcpEndpoint> endpoints;
     for (auto const& hostname_ipv : host_to_ips) {
         std::string hostname = hostname_ipv.first;
         // if *any* ips are in our old view of the whatsapp network,
@@ -275,7 +269,7 @@ static void tcp_many(host_to_ips_t host_to_ips, SharedPtr<nlohmann::json> entry,
             // When we have a better fix we shall delete this comment.
             //
 #ifdef BUG_341_FIXED_
-            if (ip_in_nets(ip, WHATSAPP_NETS)) {
+            if (ip_in_whatsapp_nets(ip)) {
                 logger->info("%s seems to belong to Whatsapp", ip.c_str());
 #endif
                 this_host_consistent = true;
@@ -289,13 +283,9 @@ static void tcp_many(host_to_ips_t host_to_ips, SharedPtr<nlohmann::json> entry,
             // XXX hardcoded
             std::vector<int> ports{443, 5222};
             for (auto const &port : ports) {
-                Settings local_options = options;
-                local_options["host"] = ip;
-                local_options["port"] = port;
-                templates::tcp_connect(
-                    local_options,
-                    tcp_cb(hostname, ip, port, this_ip_consistent),
-                    reactor, logger);
+                templates::TcpEndpoint endpoint{ip, port};
+                attempts->push_back({hostname, endpoint, this_ip_consistent});
+                endpoints.push_back(endpoint);
             }
         }
         if (!this_host_consistent) {
@@ -307,6 +297,39 @@ static void tcp_many(host_to_ips_t host_to_ips, SharedPtr<nlohmann::json> entry,
             blocked_hostnames->erase(hostname);
         }
     }
+
+    templates::tcp_connect_many(endpoints, tcp_parallelism, options,
+            [=](std::map<templates::TcpEndpoint, Error> results) {
+        for (auto const &attempt : *attempts) {
+            const std::string &ip = attempt.endpoint.first;
+            int port = attempt.endpoint.second;
+            Error connect_err = results.at(attempt.endpoint);
+            nlohmann::json result = {
+                    {"ip", ip}, {"port", port},
+                    {"status", {{"success", nullptr}, {"failure", nullptr}}},
+            };
+            if (!!connect_err) {
+                logger->info("tcp failure to %s:%d", ip.c_str(), port);
+                result["status"]["success"] = false;
+                result["status"]["failure"] = connect_err.reason;
+            } else {
+                logger->info("tcp success to %s:%d", ip.c_str(), port);
+                result["status"]["success"] = true;
+                result["status"]["failure"] = nullptr;
+                if (attempt.ip_consistent) {
+                    logger->info("removing %s from blocked_hostnames",
+                            attempt.hostname.c_str());
+                    (*entry)["whatsapp_endpoints_status"] = "ok";
+                    blocked_hostnames->erase(attempt.hostname);
+                }
+            }
+            (*entry)["tcp_connect"].push_back(result);
+        }
+        for (auto const& hostname : *blocked_hostnames) {
+            (*entry)["whatsapp_endpoints_blocked"].push_back(hostname);
+        }
+        cb(NoError());
+    }, reactor, logger);
 }
 
 static void dns_many(std::vector<std::string> hostnames, SharedPtr<nlohmann::json> entry,
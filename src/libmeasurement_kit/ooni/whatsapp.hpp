@@ -15,6 +15,9 @@ ErrorOr<bool> same_pre(std::vector<uint8_t> ip1, std::vector<uint8_t> ip2, int p
 ErrorOr<bool> ip_in_net(std::string ip1, std::string ip_w_mask);
 bool ip_in_nets(std::string ip, std::vector<std::string> nets);
 
+// Like ip_in_nets(ip, WHATSAPP_NETS), using a net::PrefixTrie built once
+bool ip_in_whatsapp_nets(const std::string &ip);
+
 } // namespace ooni
 } // namespace mk
 
@@ -4,59 +4,193 @@
 
 #include "src/libmeasurement_kit/regexp/regexp.hpp"
 
+#include <measurement_kit/common/aaa_base.h>
+
+#include <algorithm>
 #include <regex>
 
+#include <stdint.h>
+#include <string.h>
+
+#include <event2/util.h>
+
 namespace mk {
 namespace regexp {
 
+// The grammars below are simple enough that we match them by hand, which is
+// much faster than compiling a std::regex on every call.
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+
+static bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+
+// Tells whether `input` is made of `count` chars for which `pred` is true,
+// or of at least one such char, when `count` is zero.
+template <typename Predicate>
+static bool all_of(const std::string &input, size_t count, Predicate pred) {
+  return (count == 0 ? !input.empty() : input.size() == count) &&
+         std::all_of(input.begin(), input.end(), pred);
+}
+
 bool valid_country_code(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[A-Z]{2}$)"});
+  return all_of(input, 2, is_upper);
 }
 
 bool valid_airport_iata_code(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[a-z]{3}$)"});
+  return all_of(input, 3, is_lower);
 }
 
 bool lowercase_letters_only(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[a-z]+$)"});
+  return all_of(input, 0, is_lower);
 }
 
 std::string replace_probe_cc(std::string &&input, const std::string &cc) {
-  return std::regex_replace(input, std::regex{R"(\$\{probe_cc\})"}, cc);
+  static const std::string pattern = "${probe_cc}";
+  size_t pos = 0;
+  while ((pos = input.find(pattern, pos)) != std::string::npos) {
+    input.replace(pos, pattern.size(), cc);
+    pos += cc.size();
+  }
+  return std::move(input);
 }
 
 bool valid_nettest_name(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[A-Za-z0-9._-]+$)"});
+  return all_of(input, 0, [](char c) {
+    return is_digit(c) || is_lower(c) || is_upper(c) || c == '.' ||
+           c == '_' || c == '-';
+  });
 }
 
 bool valid_nettest_version(const std::string &input) {
-  return std::regex_match(
-      input,
-      std::regex{R"(^v?[0-9]{1,8}\.[0-9]{1,8}\.[0-9]{1,8}[a-z0-9-+.]{0,32}$)"});
+  // Compiled once, since matching the suffix by hand would be error prone;
+  // matching with a const std::regex is safe from many threads.
+  static const std::regex re{
+      R"(^v?[0-9]{1,8}\.[0-9]{1,8}\.[0-9]{1,8}[a-z0-9-+.]{0,32}$)",
+      std::regex::optimize};
+  return std::regex_match(input, re);
 }
 
 bool valid_probe_asn(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^AS[0-9]+$)"});
+  return input.size() > 2 && input[0] == 'A' && input[1] == 'S' &&
+         std::all_of(input.begin() + 2, input.end(), is_digit);
 }
 
 bool valid_test_start_time(const std::string &input) {
-  return std::regex_match(
-      input,
-      std::regex{R"(^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}$)"});
+  static const char format[] = "dddd-dd-dd dd:dd:dd";
+  if (input.size() != sizeof(format) - 1) {
+    return false;
+  }
+  for (size_t i = 0; i < input.size(); ++i) {
+    if (format[i] == 'd' ? !is_digit(input[i]) : input[i] != format[i]) {
+      return false;
+    }
+  }
+  return true;
 }
 
-std::string html_extract_title(const std::string &input) {
-  std::smatch match;
-  std::regex re{R"(<title>([^<]{1,128})<\/title>)", std::regex::icase};
-  if (std::regex_search(input, match, re) == false) {
-    return "";
+// Compares `n` bytes at `s` with the lowercase ASCII string `lower`, ignoring
+// the case of `s`, as std::regex::icase does in the "C" locale.
+static bool ascii_iequals(const char *s, const char *lower, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    char c = s[i];
+    if (c >= 'A' && c <= 'Z') {
+      c = (char)(c - 'A' + 'a');
+    }
+    if (c != lower[i]) {
+      return false;
+    }
   }
-  return (match.size() >= 2) ? match[1] : std::string{};
+  return true;
+}
+
+// Equivalent to searching `<title>([^<]{1,128})<\/title>` with icase in the
+// first `max_length` bytes of `input`, except that we jump from `<` to `<`
+// using memchr(), which the libc vectorizes, rather than using std::regex,
+// which is very slow and scans the whole body.
+std::string html_extract_title(const std::string &input, size_t max_length) {
+  static constexpr char open_tag[] = "<title>";
+  static constexpr size_t open_len = sizeof(open_tag) - 1;
+  static constexpr char close_tag[] = "</title>";
+  static constexpr size_t close_len = sizeof(close_tag) - 1;
+  static constexpr size_t max_title = 128;
+  const char *cur = input.data();
+  const char *end = cur + std::min(input.size(), max_length);
+  while (cur < end) {
+    cur = (const char *)memchr(cur, '<', (size_t)(end - cur));
+    if (cur == nullptr) {
+      break;
+    }
+    if ((size_t)(end - cur) < open_len ||
+        !ascii_iequals(cur, open_tag, open_len)) {
+      cur += 1;
+      continue;
+    }
+    const char *title = cur + open_len;
+    const char *close = (const char *)memchr(
+        title, '<', std::min((size_t)(end - title), max_title + 1));
+    if (close == nullptr) {
+      // No `<` within the title limit, so no `<title>` either
+      cur = title;
+      continue;
+    }
+    if (close > title && (size_t)(end - close) >= close_len &&
+        ascii_iequals(close, close_tag, close_len)) {
+      return std::string{title, close};
+    }
+    cur = close; // It may be another `<title>`
+  }
+  return "";
+}
+
+// Parses a dotted quad with no leading zeros, as inet_pton() does.
+static bool parse_ipv4(const std::string &input, uint8_t octets[4]) {
+  size_t pos = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    if (i > 0 && (pos >= input.size() || input[pos++] != '.')) {
+      return false;
+    }
+    size_t begin = pos;
+    unsigned value = 0;
+    while (pos < input.size() && is_digit(input[pos]) && pos - begin < 3) {
+      value = value * 10 + (unsigned)(input[pos++] - '0');
+    }
+    if (pos == begin || value > 255 || (pos - begin > 1 && input[begin] == '0')) {
+      return false;
+    }
+    octets[i] = (uint8_t)value;
+  }
+  return pos == input.size();
+}
+
+// Loopback (127/8) and RFC1918 (10/8, 172.16/12, 192.168/16) addresses.
+static bool private_ipv4_octets(const uint8_t octets[4]) {
+  return octets[0] == 127 || octets[0] == 10 ||
+         (octets[0] == 172 && octets[1] >= 16 && octets[1] <= 31) ||
+         (octets[0] == 192 && octets[1] == 168);
 }
 
 bool private_ipv4(const std::string &input) {
-  const char *pattern = R"(^(?:(?:127\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:192\.168\.[0-9]{1,3}\.[0-9]{1,3})|(?:10\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.1[6-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.2[0-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.3[0-1]\.[0-9]{1,3}\.[0-9]{1,3})|localhost)$)";
-  return std::regex_match(input, std::regex{pattern});
+  uint8_t octets[4];
+  return input == "localhost" ||
+         (parse_ipv4(input, octets) && private_ipv4_octets(octets));
+}
+
+bool private_ipv6(const std::string &input) {
+  uint8_t addr[16];
+  if (evutil_inet_pton(AF_INET6, input.c_str(), addr) != 1) {
+    return false;
+  }
+  static const uint8_t loopback[16] = {0, 0, 0, 0, 0, 0, 0, 0,
+                                       0, 0, 0, 0, 0, 0, 0, 1};
+  static const uint8_t v4mapped[12] = {0, 0, 0, 0, 0,    0,
+                                       0, 0, 0, 0, 0xff, 0xff};
+  return memcmp(addr, loopback, sizeof(loopback)) == 0 ||
+         (addr[0] & 0xfe) == 0xfc ||                      // fc00::/7 (ULA)
+         (addr[0] == 0xfe && (addr[1] & 0xc0) == 0x80) || // fe80::/10
+         (memcmp(addr, v4mapped, sizeof(v4mapped)) == 0 &&
+          private_ipv4_octets(addr + 12));
 }
 
 } // namespace regexp
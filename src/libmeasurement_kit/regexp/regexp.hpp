@@ -25,10 +25,20 @@ bool valid_probe_asn(const std::string &input);
 
 bool valid_test_start_time(const std::string &input);
 
-std::string html_extract_title(const std::string &input);
+// Bodies are scanned up to this length by default, because titles are in
+// the head of a page and scanning multi-megabyte bodies is wasteful.
+constexpr size_t html_title_scan_length = 1 << 20;
 
+std::string html_extract_title(const std::string &input,
+                               size_t max_length = html_title_scan_length);
+
+// Tells whether `input` is "localhost" or a loopback or RFC1918 address
 bool private_ipv4(const std::string &input);
 
+// Tells whether `input` is a loopback, unique local, or link local IPv6
+// address, or an IPv4 mapped address for which private_ipv4() is true
+bool private_ipv6(const std::string &input);
+
 } // namespace regexp
 } // namespace mk
 #endif // SRC_LIBMEASUREMENT_KIT_REGEXP_REGEXP_HPP
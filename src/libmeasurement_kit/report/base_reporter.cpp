@@ -35,7 +35,7 @@ Continuation<Error> BaseReporter::do_open_(Continuation<Error> cc) {
 }
 
 Continuation<Error>
-BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
+BaseReporter::do_write_entry_(SerializedEntry entry, Continuation<Error> cc) {
     return [=](Callback<Error> cb) {
         if (!openned_) {
             cb(ReportNotOpenError());
@@ -47,8 +47,8 @@ BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
         }
         // On success we save the serialization of the previous entry such
         // that submitting more than once the same entry is idempontent
-        std::string serio = entry.dump();
-        if (serio == prev_entry_) {
+        if (prev_entry_ && (prev_entry_.get() == entry.get() ||
+                            *prev_entry_ == *entry)) {
             cb(NoError(DuplicateEntrySubmitError()));
             return;
         }
@@ -57,8 +57,8 @@ BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
                 cb(error);
                 return;
             }
-            prev_entry_ = serio; // Only on success to allow resubmit
-            cb(NoError());
+            prev_entry_ = entry; // Only on success to allow resubmit
+            cb(error); // Keep child errors, e.g. EntrySpooledError
         });
     };
 }
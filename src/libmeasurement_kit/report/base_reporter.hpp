@@ -26,7 +26,8 @@ class BaseReporter : public NonCopyable, public NonMovable {
         return do_open_([=](Callback<Error> cb) { cb(NoError()); });
     }
 
-    virtual Continuation<Error> write_entry(nlohmann::json e) {
+    // The entry is shared with other reporters and must not be modified
+    virtual Continuation<Error> write_entry(SerializedEntry e) {
         return do_write_entry_(e, [=](Callback<Error> cb) { cb(NoError()); });
     }
 
@@ -43,7 +44,7 @@ class BaseReporter : public NonCopyable, public NonMovable {
 
     Continuation<Error> do_open_(Continuation<Error> cc);
 
-    Continuation<Error> do_write_entry_(nlohmann::json, Continuation<Error> cc);
+    Continuation<Error> do_write_entry_(SerializedEntry, Continuation<Error> cc);
 
     Continuation<Error> do_close_(Continuation<Error> cc);
 
@@ -51,7 +52,7 @@ class BaseReporter : public NonCopyable, public NonMovable {
 
     bool openned_ = false;
     bool closed_ = false;
-    std::string prev_entry_;
+    SerializedEntry prev_entry_;
 };
 
 } // namespace report
@@ -18,6 +18,21 @@ MK_DEFINE_ERR(MK_ERR_REPORT(5), ReportLogicalError, "report_formatting_error")
 MK_DEFINE_ERR(MK_ERR_REPORT(6), DuplicateEntrySubmitError, "duplicate_entry_submitted")
 MK_DEFINE_ERR(MK_ERR_REPORT(7), MissingReportIdError, "missing_report_id")
 MK_DEFINE_ERR(MK_ERR_REPORT(8), MultipleReportIdsError, "multiple_inconsistent_report_ids")
+MK_DEFINE_ERR(MK_ERR_REPORT(9), EntrySpooledError, "entry_spooled")
+
+// Writing an entry that has been saved into the collector outbox, rather than
+// submitted, succeeds with EntrySpooledError as a child error
+static inline bool is_entry_spooled(const Error &error) {
+    if (error == EntrySpooledError()) {
+        return true;
+    }
+    for (auto &child : error.child_errors) {
+        if (is_entry_spooled(child)) {
+            return true;
+        }
+    }
+    return false;
+}
 
 } // namespace report
 } // namespace mk
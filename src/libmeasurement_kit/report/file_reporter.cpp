@@ -5,6 +5,7 @@
 #include "src/libmeasurement_kit/report/error.hpp"
 #include "src/libmeasurement_kit/report/file_reporter.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace mk {
@@ -23,33 +24,56 @@ static Error map_error(std::ostream &file) {
     return GenericError();
 }
 
+static bool is_gzip_filename(const std::string &s) {
+    return s.size() >= 3 && s.compare(s.size() - 3, 3, ".gz") == 0;
+}
+
 /* static */ SharedPtr<BaseReporter> FileReporter::make(std::string s) {
     SharedPtr<FileReporter> reporter(new FileReporter);
     reporter->filename = s;
     return reporter.as<BaseReporter>();
 }
 
-Continuation<Error> FileReporter::open(ReportLegacy &) {
-    return do_open_([=](Callback<Error> cb) {
+Continuation<Error> FileReporter::open(ReportLegacy &report) {
+    return do_open_([=, &report](Callback<Error> cb) {
         if (filename == "-") {
             cb(NoError());
             return;
         }
-        file.open(filename);
-        if (!file.good()) {
-            cb(map_error(file));
+        // By default we commit every entry, as we used to do. Committing
+        // less frequently reduces the number of writes (and flash wear) at
+        // the cost of possibly losing the last entries on crash.
+        file.flush_every = (size_t)std::max(
+            0, report.options.get("report_flush_every", 1));
+        file.min_flush_interval =
+            report.options.get("report_flush_interval", 0.0);
+        file.fsync = report.options.get("report_fsync", false);
+        file.gzip = report.options.get("report_gzip", false) ||
+                    is_gzip_filename(filename);
+        // Appending also works with gzip, since members can be concatenated
+        file.append = report.resume;
+        if (file.open(filename) != NoError()) {
+            cb(ReportIoError());
             return;
         }
         cb(NoError());
     });
 }
 
-Continuation<Error> FileReporter::write_entry(nlohmann::json entry) {
+Continuation<Error> FileReporter::write_entry(SerializedEntry entry) {
     return do_write_entry_(entry, [=](Callback<Error> cb) {
-        std::ostream &frf = (filename == "-") ? std::cout : file;
-        frf << entry.dump() << std::endl;
-        if (!frf.good()) {
-            cb(map_error(frf));
+        if (filename == "-") {
+            std::cout << *entry << std::endl;
+            if (!std::cout.good()) {
+                cb(map_error(std::cout));
+                return;
+            }
+            cb(NoError());
+            return;
+        }
+        file << *entry << '\n';
+        if (file.end_record() != NoError()) {
+            cb(map_error(file));
             return;
         }
         cb(NoError());
@@ -62,9 +86,8 @@ Continuation<Error> FileReporter::close() {
             cb(NoError());
             return;
         }
-        file.close();
-        if (!file.good()) {
-            cb(map_error(file));
+        if (file.close() != NoError()) {
+            cb(ReportIoError());
             return;
         }
         cb(NoError());
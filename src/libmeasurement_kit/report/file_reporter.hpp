@@ -4,8 +4,7 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_REPORT_FILE_REPORTER_HPP
 #define SRC_LIBMEASUREMENT_KIT_REPORT_FILE_REPORTER_HPP
 
-#include <fstream>
-
+#include "src/libmeasurement_kit/common/file_writer.hpp"
 #include "src/libmeasurement_kit/report/base_reporter.hpp"
 
 namespace mk {
@@ -16,7 +15,7 @@ class FileReporter : public BaseReporter {
     static SharedPtr<BaseReporter> make(std::string filename);
 
     Continuation<Error> open(ReportLegacy &report) override;
-    Continuation<Error> write_entry(nlohmann::json entry) override;
+    Continuation<Error> write_entry(SerializedEntry entry) override;
     Continuation<Error> close() override;
 
     ~FileReporter() override {}
@@ -25,7 +24,7 @@ class FileReporter : public BaseReporter {
     FileReporter() {}
 
     std::string filename;
-    std::ofstream file;
+    FileWriter file;
 };
 
 } // namespace report
@@ -5,7 +5,8 @@
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/report/ooni_reporter.hpp"
 #include "src/libmeasurement_kit/report/error.hpp"
-#include "src/libmeasurement_kit/ooni/collector_client.hpp"
+#include "src/libmeasurement_kit/ooni/collector_outbox.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
 
 namespace mk {
 namespace report {
@@ -22,6 +23,7 @@ OoniReporter::OoniReporter(Settings s, SharedPtr<Reactor> r, SharedPtr<Logger> l
     }
     logger->info("Results collector: %s",
         settings["collector_base_url"].c_str());
+    outbox_dir = settings.get("collector_outbox_dir", std::string{});
 }
 
 /* static */ SharedPtr<BaseReporter> OoniReporter::make(Settings settings,
@@ -32,6 +34,9 @@ OoniReporter::OoniReporter(Settings s, SharedPtr<Reactor> r, SharedPtr<Logger> l
 
 Continuation<Error> OoniReporter::open(ReportLegacy &report) {
     return do_open_([=, &report](Callback<Error> cb) {
+        // Even when resuming, we open a new report, since the collector does
+        // not tell us whether the report we were submitting to is still open
+        // and it closes the reports that have been idle for too long
         logger->info("Opening report; please be patient...");
         ooni::collector::connect_and_create_report(
                 report.get_dummy_entry(),
@@ -51,17 +56,23 @@ Continuation<Error> OoniReporter::open(ReportLegacy &report) {
     });
 }
 
-Continuation<Error> OoniReporter::write_entry(nlohmann::json entry) {
+Continuation<Error> OoniReporter::write_entry(SerializedEntry entry) {
 
     // Register action for when we will be asked to write the entry
     return do_write_entry_(entry, [=](Callback<Error> cb) {
+        if (outbox_name != "") {
+            // Keep the entries in order once we have started spooling
+            spool_entry_(entry, NoError(), cb);
+            return;
+        }
         if (report_id == "") {
             logger->warn("ooni_reporter: missing report ID");
-            cb(MissingReportIdError());
+            spool_entry_(entry, MissingReportIdError(), cb);
             return;
         }
         logger->info("Submitting test results; please be patient...");
-        ooni::collector::connect_and_update_report(report_id, entry,
+        // Send the entry as is, since it has already been serialized
+        ooni::collector::connect_and_update_report_raw(report_id, *entry,
                                              [=](Error e) {
                                                  logger->debug(
                                                      "Submitting entry... %d",
@@ -70,8 +81,10 @@ Continuation<Error> OoniReporter::write_entry(nlohmann::json entry) {
                                                      logger->info("Results "
                                                         "successfully "
                                                         "submitted");
+                                                     cb(e);
+                                                     return;
                                                  }
-                                                 cb(e);
+                                                 spool_entry_(entry, e, cb);
                                              },
                                              settings,
                                              reactor,
@@ -79,8 +92,38 @@ Continuation<Error> OoniReporter::write_entry(nlohmann::json entry) {
     });
 }
 
+void OoniReporter::spool_entry_(SerializedEntry entry, Error error,
+                                Callback<Error> cb) {
+    if (outbox_dir == "") {
+        cb(error);
+        return;
+    }
+    if (outbox_name == "") {
+        outbox_name = (report_id != "") ? report_id
+                                        : "pending-" + mk::random_str(16);
+        logger->warn("ooni_reporter: saving entries into the outbox as %s",
+                     outbox_name.c_str());
+    }
+    // Note: if report_id is empty, it is set when submitting the outbox
+    Error err = ooni::collector::outbox_append(outbox_dir, outbox_name,
+                                               report_id, *entry, logger);
+    if (err) {
+        logger->warn("ooni_reporter: cannot save entry into the outbox: %s",
+                     err.what());
+        cb(error ? error : err);
+        return;
+    }
+    // Not a failure, but the entry is yet to be submitted
+    cb(NoError(EntrySpooledError()));
+}
+
 Continuation<Error> OoniReporter::close() {
     return do_close_([=](Callback<Error> cb) {
+        if (outbox_name != "") {
+            // The report is closed after submitting the outbox
+            cb(NoError());
+            return;
+        }
         if (report_id == "") {
             logger->warn("ooni_reporter: missing report ID");
             cb(MissingReportIdError());
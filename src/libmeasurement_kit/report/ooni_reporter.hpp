@@ -15,7 +15,7 @@ class OoniReporter : public BaseReporter {
     static SharedPtr<BaseReporter> make(Settings, SharedPtr<Reactor>, SharedPtr<Logger>);
 
     Continuation<Error> open(ReportLegacy &report) override;
-    Continuation<Error> write_entry(nlohmann::json entry) override;
+    Continuation<Error> write_entry(SerializedEntry entry) override;
     Continuation<Error> close() override;
 
     ~OoniReporter() override {}
@@ -25,10 +25,15 @@ class OoniReporter : public BaseReporter {
   private:
     OoniReporter(Settings, SharedPtr<Reactor>, SharedPtr<Logger>);
 
+    // Saves the entry into the outbox, if any, otherwise fails with `error`
+    void spool_entry_(SerializedEntry entry, Error error, Callback<Error> cb);
+
     SharedPtr<Reactor> reactor;
     SharedPtr<Logger> logger;
     Settings settings; // Our private copy of the ooni_test settings
     std::string report_id;
+    std::string outbox_dir;
+    std::string outbox_name; // Set when we start using the outbox
 };
 
 } // namespace report
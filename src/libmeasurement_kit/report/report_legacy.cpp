@@ -3,6 +3,7 @@
 // and LICENSE for more information on the copying conditions.
 
 #include "src/libmeasurement_kit/common/fmap.hpp"
+#include "src/libmeasurement_kit/common/json_writer.hpp"
 #include "src/libmeasurement_kit/common/parallel.hpp"
 
 #include "src/libmeasurement_kit/common/utils.hpp"
@@ -11,6 +12,8 @@
 #include "src/libmeasurement_kit/report/error.hpp"
 #include "src/libmeasurement_kit/report/report_legacy.hpp"
 
+#include <algorithm>
+
 namespace mk {
 namespace report {
 
@@ -20,7 +23,8 @@ void ReportLegacy::add_reporter(SharedPtr<BaseReporter> reporter) {
     reporters_.push_back(reporter);
 }
 
-void ReportLegacy::fill_entry(nlohmann::json &entry) const {
+nlohmann::json ReportLegacy::make_header_() const {
+    nlohmann::json entry;
     entry["test_name"] = test_name;
     entry["test_version"] = test_version;
     entry["test_start_time"] = *mk::timestamp(&test_start_time);
@@ -38,12 +42,37 @@ void ReportLegacy::fill_entry(nlohmann::json &entry) const {
     entry["annotations"]["engine_version"] = MK_VERSION;
     entry["annotations"]["engine_version_full"] = MK_VERSION_FULL;
     entry["report_id"] = report_id;
+    return entry;
+}
+
+static void merge_header(nlohmann::json &entry, const nlohmann::json &header) {
+    for (auto it = header.begin(); it != header.end(); ++it) {
+        if (it.key() != "annotations") {
+            entry[it.key()] = it.value();
+            continue;
+        }
+        // Merge with the annotations that may already be there
+        nlohmann::json &annotations = entry["annotations"];
+        for (auto a = it->begin(); a != it->end(); ++a) {
+            annotations[a.key()] = a.value();
+        }
+    }
+}
+
+void ReportLegacy::fill_entry(nlohmann::json &entry) const {
+    if (!header_final_) {
+        // Before open() completes, report_id may still change
+        merge_header(entry, make_header_());
+        return;
+    }
+    if (header_.is_null()) {
+        header_ = make_header_();
+    }
+    merge_header(entry, header_);
 }
 
 nlohmann::json ReportLegacy::get_dummy_entry() const {
-    nlohmann::json entry;
-    fill_entry(entry);
-    return entry;
+    return make_header_();
 }
 
 #define FMAP mk::fmap<SharedPtr<BaseReporter>, Continuation<Error>>
@@ -51,20 +80,108 @@ nlohmann::json ReportLegacy::get_dummy_entry() const {
 void ReportLegacy::open(Callback<Error> callback) {
     mk::parallel(FMAP(reporters_, [=](SharedPtr<BaseReporter> r) {
         return r->open(*this);
-    }), callback);
+    }), [=](Error error) {
+        // The reporters may have set the report_id, so only from now on
+        // we can compute the header once and reuse it for all entries
+        if (!error) {
+            header_final_ = true;
+            header_ = nullptr;
+        }
+        callback(error);
+    });
 }
 
 void ReportLegacy::write_entry(nlohmann::json entry, Callback<Error> callback,
-                         SharedPtr<Logger>) {
+                               SharedPtr<Logger> logger) {
+    write_entry(SerializedEntry{new std::string{json_dump(entry)}}, callback,
+                logger);
+}
+
+void ReportLegacy::write_entry(SerializedEntry entry, Callback<Error> callback,
+                               SharedPtr<Logger>) {
+    // All the reporters share the same serialization of the entry
     mk::parallel(FMAP(reporters_, [=](SharedPtr<BaseReporter> r) {
         return r->write_entry(entry);
     }), callback);
 }
 
+void ReportLegacy::enqueue_entry(nlohmann::json entry, Callback<> on_queued,
+                                 Callback<Error> on_written,
+                                 SharedPtr<Logger> logger) {
+    enqueue_entry(SerializedEntry{new std::string{json_dump(entry)}},
+                  std::move(on_queued), std::move(on_written),
+                  std::move(logger));
+}
+
+void ReportLegacy::enqueue_entry(SerializedEntry entry, Callback<> on_queued,
+                                 Callback<Error> on_written,
+                                 SharedPtr<Logger> logger) {
+    if (max_queued_entries <= 0) {
+        write_entry(std::move(entry), [=](Error error) {
+            on_written(error);
+            on_queued();
+        }, logger);
+        return;
+    }
+    QueuedEntry qe;
+    qe.entry = std::move(entry);
+    qe.on_written = std::move(on_written);
+    qe.logger = std::move(logger);
+    bool fits = queue_.size() < max_queued_entries;
+    if (!fits) {
+        qe.logger->debug("report: queue is full; waiting for room");
+        qe.on_queued = std::move(on_queued);
+    }
+    queue_.push_back(std::move(qe));
+    if (fits) {
+        on_queued();
+    }
+    write_queued_entries_();
+}
+
+void ReportLegacy::write_queued_entries_() {
+    while (writing_ < std::max(max_writing_entries, (size_t)1) &&
+           !queue_.empty()) {
+        QueuedEntry qe = std::move(queue_.front());
+        queue_.pop_front();
+        // Unblock the first entry that was waiting for room, if any
+        if (queue_.size() >= max_queued_entries &&
+            queue_[max_queued_entries - 1].on_queued) {
+            Callback<> on_queued;
+            std::swap(on_queued, queue_[max_queued_entries - 1].on_queued);
+            on_queued();
+        }
+        writing_ += 1;
+        auto on_written = std::move(qe.on_written);
+        write_entry(std::move(qe.entry), [=](Error error) {
+            writing_ -= 1;
+            on_written(error);
+            write_queued_entries_();
+            if (writing_ == 0 && queue_.empty()) {
+                std::vector<Callback<>> callbacks;
+                std::swap(callbacks, drain_callbacks_);
+                for (auto &cb : callbacks) {
+                    cb();
+                }
+            }
+        }, qe.logger);
+    }
+}
+
+void ReportLegacy::drain(Callback<> callback) {
+    if (writing_ == 0 && queue_.empty()) {
+        callback();
+        return;
+    }
+    drain_callbacks_.push_back(std::move(callback));
+}
+
 void ReportLegacy::close(Callback<Error> callback) {
-    mk::parallel(FMAP(reporters_, [](SharedPtr<BaseReporter> r) {
-        return r->close();
-    }), callback);
+    drain([=]() {
+        mk::parallel(FMAP(reporters_, [](SharedPtr<BaseReporter> r) {
+            return r->close();
+        }), callback);
+    });
 }
 
 #undef FMAP // So long, and thanks for the fish
@@ -7,6 +7,7 @@
 #include <measurement_kit/common.hpp>
 
 #include <ctime>
+#include <deque>
 
 #include "src/libmeasurement_kit/common/logger.hpp"
 #include "src/libmeasurement_kit/common/settings.hpp"
@@ -16,6 +17,9 @@ namespace report {
 
 class BaseReporter; // Forward decl.
 
+// Entry serialized only once and then shared, read-only, by all reporters
+using SerializedEntry = SharedPtr<const std::string>;
+
 class ReportLegacy {
   public:
     const std::string software_name = "measurement_kit";
@@ -35,10 +39,18 @@ class ReportLegacy {
 
     std::string report_id; /* Set after open(), if possible */
 
+    // When set before open(), the reporters continue the report that we
+    // were writing when we were interrupted, rather than starting anew:
+    // files are appended to. The collector may have closed the report that
+    // we were submitting to, hence the rest of the entries are submitted to
+    // a new report, whose ID is `report_id`.
+    bool resume = false;
+
     ReportLegacy();
 
     void add_reporter(SharedPtr<BaseReporter> reporter);
 
+    // Adds the report header fields, computed once after open() succeeds
     void fill_entry(nlohmann::json &entry) const;
 
     nlohmann::json get_dummy_entry() const;
@@ -47,10 +59,52 @@ class ReportLegacy {
 
     void write_entry(nlohmann::json entry, Callback<Error> callback, SharedPtr<Logger> logger);
 
+    void write_entry(SerializedEntry entry, Callback<Error> callback,
+                     SharedPtr<Logger> logger);
+
+    /*
+     * Like write_entry() but the entry is written in the background. The
+     * `on_queued` callback is called as soon as there is room for the entry
+     * in the queue, so the caller can continue working, while `on_written`
+     * is called once the entry has been written. At most `max_queued_entries`
+     * entries wait to be written and at most `max_writing_entries` entries
+     * are written in parallel. If `max_queued_entries` is zero, `on_queued`
+     * is called after `on_written`, as if we were using write_entry().
+     */
+    void enqueue_entry(nlohmann::json entry, Callback<> on_queued,
+                       Callback<Error> on_written, SharedPtr<Logger> logger);
+
+    void enqueue_entry(SerializedEntry entry, Callback<> on_queued,
+                       Callback<Error> on_written, SharedPtr<Logger> logger);
+
+    size_t max_queued_entries = 0;
+    size_t max_writing_entries = 1;
+
+    // Calls `callback` once all the enqueued entries have been written
+    void drain(Callback<> callback);
+
+    // Drains the queue and then closes the report
     void close(Callback<Error> callback);
 
   private:
+    class QueuedEntry {
+      public:
+        SerializedEntry entry;
+        Callback<> on_queued; /* Empty once called */
+        Callback<Error> on_written;
+        SharedPtr<Logger> logger;
+    };
+
+    std::vector<Callback<>> drain_callbacks_;
+    mutable nlohmann::json header_; /* Cached by fill_entry() */
+    bool header_final_ = false;
+    std::deque<QueuedEntry> queue_;
     std::vector<SharedPtr<BaseReporter>> reporters_;
+    size_t writing_ = 0;
+
+    void write_queued_entries_();
+
+    nlohmann::json make_header_() const;
 };
 
 } // namespace report
@@ -14,7 +14,7 @@ namespace ndt {
     "                       [-T phase] [host]\n"                               \
     "\n"                                                                       \
     "Available tool names for mlab-ns: ndt, neubot (default: ndt)\n"           \
-    "Available phases: download, download-ext, none, upload\n"                 \
+    "Available phases: download, download-ext, none, upload, upload-ext\n"     \
     "  (default: -T download -T upload)\n"
 
 int main(std::list<Callback<BaseTest &>> &initializers, int argc, char **argv) {
@@ -48,6 +48,8 @@ int main(std::list<Callback<BaseTest &>> &initializers, int argc, char **argv) {
                 test_suite = 0;
             } else if (strcmp(optarg, "upload") == 0) {
                 test_suite |= MK_NDT_UPLOAD;
+            } else if (strcmp(optarg, "upload-ext") == 0) {
+                test_suite |= MK_NDT_UPLOAD_EXT;
             } else {
                 fprintf(stderr, "invalid parameter for -T option: %s", optarg);
                 exit(1);
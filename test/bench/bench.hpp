@@ -0,0 +1,168 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef TEST_BENCH_BENCH_HPP
+#define TEST_BENCH_BENCH_HPP
+
+/*
+ * Measures what a client costs while running against a loopback server, or
+ * what any other code costs, in terms of CPU time and allocations of the
+ * calling thread and of peak RSS of the process. Since it replaces the global
+ * allocation functions, for counting allocations, it must be included by a
+ * single translation unit of each program.
+ */
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <event2/event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <string>
+
+namespace mk {
+namespace bench {
+
+// Only the client thread counts, such that the server does not interfere
+static thread_local bool counting_allocations = false;
+static thread_local uint64_t allocations = 0;
+
+static inline void *counting_malloc(size_t n) {
+    if (counting_allocations) {
+        allocations += 1;
+    }
+    return malloc(n);
+}
+
+static inline void *counting_realloc(void *p, size_t n) {
+    if (counting_allocations) {
+        allocations += 1;
+    }
+    return realloc(p, n);
+}
+
+// Called through a pointer, since otherwise the compiler sees free() paired
+// with operator new and warns about a mismatched deallocation
+static void (*volatile release)(void *) = free;
+
+// Also count what libevent allocates, e.g. the evbuffer chains
+static const bool libevent_allocations_counted = []() {
+    event_set_mem_functions(counting_malloc, counting_realloc, free);
+    return true;
+}();
+
+// CPU time used by the calling thread where possible, else by the process
+static inline double cpu_time() {
+#ifndef _WIN32
+#ifdef RUSAGE_THREAD
+    int who = RUSAGE_THREAD;
+#else
+    int who = RUSAGE_SELF; /* E.g., macOS */
+#endif
+    rusage ru{};
+    if (getrusage(who, &ru) == 0) {
+        return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e06 +
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e06;
+    }
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// Peak resident set size of the process in bytes, or zero if unknown
+static inline uint64_t peak_rss() {
+#ifndef _WIN32
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+        return (uint64_t)ru.ru_maxrss; /* Already in bytes */
+#else
+        return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Makes the peak resident set size equal to the current one, where we can,
+// so that peak_rss() tells the peak since this call rather than since exec
+static inline void reset_peak_rss() {
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp != nullptr) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+#endif
+}
+
+class Measurement {
+  public:
+    void start() {
+        reset_peak_rss();
+        allocations_ = allocations;
+        cpu_ = cpu_time();
+        counting_allocations = true;
+    }
+
+    void stop() {
+        counting_allocations = false;
+        allocations_ = allocations - allocations_;
+        cpu_ = cpu_time() - cpu_;
+        peak_rss_ = peak_rss();
+    }
+
+    // Prints the throughput of moving `bytes` in `seconds`, as measured by
+    // the server, and the costs of the client per GB
+    void report(std::string name, uint64_t bytes, double seconds) const {
+        double gb = bytes / 1e09;
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "%-24s %8.1f MB %6.2f s %9.1f Mbit/s %7.3f cpu-s/GB "
+                 "%10.0f allocs/GB",
+                 name.c_str(), bytes / 1e06, seconds,
+                 (seconds > 0.0) ? bytes * 8 / 1e06 / seconds : 0.0,
+                 (gb > 0.0) ? cpu_ / gb : 0.0,
+                 (gb > 0.0) ? allocations_ / gb : 0.0);
+        std::cout << line << std::endl;
+    }
+
+    // Prints the costs of running the code once
+    void report(std::string name) const {
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "%-40s %8.3f cpu-s %10llu allocs %8.1f MB peak RSS",
+                 name.c_str(), cpu_, (unsigned long long)allocations_,
+                 peak_rss_ / 1e06);
+        std::cout << line << std::endl;
+    }
+
+  private:
+    uint64_t allocations_ = 0;
+    double cpu_ = 0.0;
+    uint64_t peak_rss_ = 0;
+};
+
+} // namespace bench
+} // namespace mk
+
+void *operator new(size_t n) {
+    void *p = mk::bench::counting_malloc((n > 0) ? n : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { mk::bench::release(p); }
+
+void operator delete(void *p, size_t) noexcept { mk::bench::release(p); }
+
+#endif
@@ -0,0 +1,71 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "test/bench/bench.hpp"
+#include "test/bench/dash_server.hpp"
+
+#include "src/libmeasurement_kit/common/reactor_pool.hpp"
+#include "src/libmeasurement_kit/neubot/dash.hpp"
+
+using namespace mk;
+
+static Error run_dash(bench::DashServer &server, Settings settings,
+                      SharedPtr<nlohmann::json> entry) {
+    SharedPtr<Logger> logger = Logger::make();
+    logger->on_log(nullptr); // Keep the benchmark output readable
+    // Like negotiate does, since run() does not pass on the url it is given
+    settings["http/url"] = server.url();
+    Error error = GenericError();
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        neubot::dash::run(server.url(), "", "127.0.0.1", entry, settings,
+                          reactor, logger, [&](Error err) {
+                              error = err;
+                              reactor->stop();
+                          });
+    });
+    return error;
+}
+
+TEST_CASE("neubot::dash::run works with the loopback server") {
+    ReactorPool pool{1};
+    bench::DashServer server{pool.at(0), Logger::make()};
+    Settings settings;
+    settings["constant_bitrate"] = 8000; /* I.e., 1 MB per second */
+    settings["elapsed_target"] = 1;
+    settings["max_iteration"] = 3;
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    REQUIRE(run_dash(server, settings, entry) == NoError());
+    REQUIRE((*entry)["receiver_data"].size() == 3);
+    for (auto &e : (*entry)["receiver_data"]) {
+        REQUIRE(e["received"] == 1000000);
+    }
+    REQUIRE(server.stats().requests == 3);
+    REQUIRE(server.stats().bytes == 3000000);
+}
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of neubot::dash::run over loopback", "[.][benchmark]") {
+    ReactorPool pool{1};
+    for (int rate : {80000, 800000}) {
+        bench::DashServer server{pool.at(0), Logger::make()};
+        Settings settings;
+        settings["constant_bitrate"] = rate;
+        settings["elapsed_target"] = 1;
+        settings["max_iteration"] = 8000000 / rate;
+        bench::Measurement measurement;
+        measurement.start();
+        REQUIRE(run_dash(server, settings,
+                         SharedPtr<nlohmann::json>{new nlohmann::json}) ==
+                NoError());
+        measurement.stop();
+        measurement.report("dash (" + std::to_string(rate / 8000) +
+                                 " MB/request)",
+                           server.stats().bytes, server.stats().seconds);
+    }
+}
@@ -0,0 +1,157 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef TEST_BENCH_DASH_SERVER_HPP
+#define TEST_BENCH_DASH_SERVER_HPP
+
+#include "test/bench/listener.hpp"
+
+#include "src/libmeasurement_kit/common/lexical_cast.hpp"
+#include "src/libmeasurement_kit/common/unique_ptr.hpp"
+
+#include <stdint.h>
+
+#include <mutex>
+
+namespace mk {
+namespace bench {
+
+/*
+ * Stand-in for a neubot DASH server, serving over loopback the requests for
+ * `/dash/download/<count>` that neubot::dash::run sends, with keep-alive and
+ * with bodies made of the same chunk written over and over, so that the cost
+ * of the test is the client's. Negotiation and collection are not supported,
+ * since the real client only speaks them over https.
+ */
+class DashServer : public NonCopyable, public NonMovable {
+  public:
+    class Stats {
+      public:
+        uint64_t requests = 0;
+        uint64_t bytes = 0;   /* Bytes of the bodies */
+        double seconds = 0.0; /* Time spent sending the bodies */
+    };
+
+    // Uses `reactor`, which must be running in a background thread, e.g. as
+    // part of a ReactorPool, for accepting and serving clients
+    DashServer(SharedPtr<Reactor> reactor, SharedPtr<Logger> logger)
+        : state_{new State} {
+        state_->chunk = make_chunk();
+        SharedPtr<State> state = state_;
+        listener_.reset(new Listener(reactor, logger,
+                                     [=](SharedPtr<net::Transport> txp) {
+                                         serve(state, logger, txp);
+                                     }));
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(listener_->port()) + "/";
+    }
+
+    Stats stats() {
+        std::unique_lock<std::mutex> _{state_->mutex};
+        return state_->stats;
+    }
+
+  private:
+    class State {
+      public:
+        SharedPtr<std::string> chunk;
+        std::mutex mutex;
+        Stats stats;
+    };
+
+    class Connection {
+      public:
+        net::Buffer input;
+        bool sending = false;
+        uint64_t count = 0;   /* Size of the body being sent */
+        uint64_t pending = 0; /* Part of it that we did not write yet */
+        double begin = 0.0;
+    };
+
+    static void serve(SharedPtr<State> state, SharedPtr<Logger> logger,
+                      SharedPtr<net::Transport> txp) {
+        SharedPtr<Connection> conn{std::make_shared<Connection>()};
+        set_write_low_watermark(txp);
+        txp->on_data([=](net::Buffer data) {
+            conn->input << data;
+            process(state, logger, conn, txp);
+        });
+        txp->on_flush([=]() {
+            if (!conn->sending) {
+                return;
+            }
+            if (conn->pending > 0) {
+                write_body(state, conn, txp);
+                return;
+            }
+            conn->sending = false;
+            {
+                std::unique_lock<std::mutex> _{state->mutex};
+                state->stats.requests += 1;
+                state->stats.bytes += conn->count;
+                state->stats.seconds += time_now() - conn->begin;
+            }
+            process(state, logger, conn, txp);
+        });
+        txp->on_error([=](Error) { txp->close([]() {}); });
+    }
+
+    // Parses the next request, if it is complete and we are not still busy
+    // sending the previous response, and starts sending the response
+    static void process(SharedPtr<State> state, SharedPtr<Logger> logger,
+                        SharedPtr<Connection> conn,
+                        SharedPtr<net::Transport> txp) {
+        if (conn->sending) {
+            return; /* Clients do not pipeline; but stay on the safe side */
+        }
+        std::string head = conn->input.peek();
+        size_t end = head.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            return;
+        }
+        conn->input.discard(end + 4);
+        head = head.substr(0, head.find("\r\n"));
+        static const std::string prefix = "GET /dash/download/";
+        ErrorOr<uint64_t> count{ValueError(), 0};
+        if (head.compare(0, prefix.size(), prefix) == 0) {
+            size_t space = head.find(' ', prefix.size());
+            count = lexical_cast_noexcept<uint64_t>(
+                  head.substr(prefix.size(), space - prefix.size()));
+        }
+        if (!count) {
+            logger->warn("dash_server: unexpected request: %s", head.c_str());
+            txp->close([]() {});
+            return;
+        }
+        txp->write("HTTP/1.1 200 OK\r\nServer: loopback\r\n"
+                   "Content-Type: video/mp4\r\nContent-Length: " +
+                   std::to_string(*count) +
+                   "\r\nConnection: keep-alive\r\n\r\n");
+        conn->sending = true;
+        conn->count = *count;
+        conn->pending = *count;
+        conn->begin = time_now();
+        write_body(state, conn, txp);
+        write_body(state, conn, txp);
+    }
+
+    static void write_body(SharedPtr<State> state, SharedPtr<Connection> conn,
+                           SharedPtr<net::Transport> txp) {
+        if (conn->pending >= chunk_size) {
+            write_chunk(txp, state->chunk);
+            conn->pending -= chunk_size;
+        } else if (conn->pending > 0) {
+            txp->write(state->chunk->substr(0, conn->pending));
+            conn->pending = 0;
+        }
+    }
+
+    SharedPtr<State> state_;
+    UniquePtr<Listener> listener_;
+};
+
+} // namespace bench
+} // namespace mk
+#endif
@@ -0,0 +1,98 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "test/bench/bench.hpp"
+
+#include "src/libmeasurement_kit/common/json_writer.hpp"
+#include "src/libmeasurement_kit/ooni/templates_impl.hpp"
+
+using namespace mk;
+
+static size_t body_size = 0;
+
+// Returns a chain of redirects, like the one web_connectivity may follow,
+// whose bodies are about `body_size` bytes of HTML each
+static void redirects(Settings, http::Headers, std::string,
+                      Callback<Error, SharedPtr<http::Response>> cb,
+                      SharedPtr<Reactor>, SharedPtr<Logger>,
+                      SharedPtr<http::Response>, int) {
+    SharedPtr<http::Response> previous;
+    for (int i = 0; i < 5; ++i) {
+        SharedPtr<http::Response> response{new http::Response};
+        response->request.reset(new http::Request);
+        response->request->method = "GET";
+        http::headers_push_back(response->request->headers, "User-Agent",
+                                "Mozilla/5.0");
+        response->response_line = "HTTP/1.1 200 Ok";
+        response->status_code = 200;
+        http::headers_push_back(response->headers, "Content-Type",
+                                "text/html; charset=utf-8");
+        response->body = "<html><body>\n";
+        while (response->body.size() < body_size) {
+            response->body += "<p class=\"x\">Caff\xc3\xa8 \"latte\"</p>\n";
+        }
+        response->previous = previous;
+        previous = response;
+    }
+    cb(NoError(), previous);
+}
+
+static SharedPtr<nlohmann::json> make_test_keys() {
+    SharedPtr<nlohmann::json> test_keys{new nlohmann::json};
+    ooni::templates::http_request_impl<redirects>(
+          test_keys, {}, {}, "", [](Error, SharedPtr<http::Response>) {},
+          Reactor::make(), Logger::make());
+    (*test_keys)["queries"] = nlohmann::json::array();
+    (*test_keys)["tcp_connect"] = nlohmann::json::array();
+    return test_keys;
+}
+
+static nlohmann::json make_entry() {
+    return {{"input", "http://www.example.com/"},
+            {"probe_asn", "AS0"},
+            {"probe_cc", "ZZ"},
+            {"test_name", "web_connectivity"}};
+}
+
+// How the runnable wrote entries before, copying the test keys
+static std::string copy_and_dump(SharedPtr<nlohmann::json> test_keys) {
+    nlohmann::json entry = make_entry();
+    entry["test_keys"] = *test_keys;
+    return entry.dump();
+}
+
+// How the runnable writes entries now
+static std::string move_and_json_dump(SharedPtr<nlohmann::json> test_keys) {
+    nlohmann::json entry = make_entry();
+    entry["test_keys"] = std::move(*test_keys);
+    return json_dump(entry);
+}
+
+TEST_CASE("Entries are the same however we write them") {
+    body_size = 4096;
+    std::string serialized = copy_and_dump(make_test_keys());
+    REQUIRE(serialized.size() > 5 * body_size);
+    REQUIRE(move_and_json_dump(make_test_keys()) == serialized);
+}
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of writing web_connectivity like entries",
+          "[.][benchmark]") {
+    body_size = 1 << 20;
+    for (auto writer : {move_and_json_dump, copy_and_dump}) {
+        bench::Measurement measurement;
+        measurement.start();
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(writer(make_test_keys()).size() > 5 * body_size);
+        }
+        measurement.stop();
+        measurement.report((writer == copy_and_dump)
+                                 ? "entry (copy and dump())"
+                                 : "entry (move and json_dump())");
+    }
+}
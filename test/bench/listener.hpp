@@ -0,0 +1,104 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef TEST_BENCH_LISTENER_HPP
+#define TEST_BENCH_LISTENER_HPP
+
+#include "src/libmeasurement_kit/common/callback.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/net/libevent_emitter.hpp"
+
+#include <event2/bufferevent.h>
+#include <event2/listener.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace mk {
+namespace bench {
+
+// The servers write the same random chunk over and over by reference, so
+// that what they send costs them as little as possible
+static constexpr size_t chunk_size = 1 << 16;
+
+static inline SharedPtr<std::string> make_chunk() {
+    return SharedPtr<std::string>{new std::string(random_str(chunk_size))};
+}
+
+// Limits the output buffered by `txp` to about two chunks, such that the
+// flush callback fires as soon as there is room for another chunk
+static inline void set_write_low_watermark(SharedPtr<net::Transport> txp) {
+    bufferevent_setwatermark(txp->get_bufferevent(), EV_WRITE, chunk_size, 0);
+}
+
+static inline void write_chunk(SharedPtr<net::Transport> txp,
+                               SharedPtr<std::string> chunk) {
+    net::Buffer data;
+    data.write_reference(chunk);
+    txp->write(std::move(data));
+}
+
+/*
+ * Accepts connections on an ephemeral port of 127.0.0.1 and passes them to
+ * the callback, wrapped into transports, from the thread of `reactor`. The
+ * callback may destroy the listener, e.g. once it has accepted enough.
+ */
+class Listener : public NonCopyable, public NonMovable {
+  public:
+    Listener(SharedPtr<Reactor> reactor, SharedPtr<Logger> logger,
+             Callback<SharedPtr<net::Transport>> &&cb)
+        : reactor_{reactor}, logger_{logger}, callback_{std::move(cb)} {
+        sockaddr_in sin{};
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listener_ = evconnlistener_new_bind(
+              reactor->get_event_base(), accept_cb, this,
+              LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_THREADSAFE,
+              -1, (sockaddr *)&sin, sizeof(sin));
+        if (listener_ == nullptr) {
+            throw std::runtime_error("evconnlistener_new_bind");
+        }
+        socklen_t len = sizeof(sin);
+        if (getsockname(evconnlistener_get_fd(listener_), (sockaddr *)&sin,
+                        &len) != 0) {
+            evconnlistener_free(listener_);
+            throw std::runtime_error("getsockname");
+        }
+        port_ = ntohs(sin.sin_port);
+    }
+
+    ~Listener() { evconnlistener_free(listener_); }
+
+    int port() const { return port_; }
+
+  private:
+    static void accept_cb(evconnlistener *, evutil_socket_t fd, sockaddr *,
+                          int, void *opaque) {
+        Listener *self = static_cast<Listener *>(opaque);
+        bufferevent *bev = bufferevent_socket_new(
+              self->reactor_->get_event_base(), fd, BEV_OPT_CLOSE_ON_FREE);
+        if (bev == nullptr) {
+            evutil_closesocket(fd);
+            return;
+        }
+        SharedPtr<net::Transport> txp =
+              net::LibeventEmitter::make(bev, self->reactor_, self->logger_);
+        // Copy the callback, since it may destroy `self`
+        auto callback = self->callback_;
+        callback(txp);
+    }
+
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+    Callback<SharedPtr<net::Transport>> callback_;
+    evconnlistener *listener_ = nullptr;
+    int port_ = 0;
+};
+
+} // namespace bench
+} // namespace mk
+#endif
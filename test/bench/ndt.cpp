@@ -0,0 +1,92 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "test/bench/bench.hpp"
+#include "test/bench/ndt_server.hpp"
+
+#include "src/libmeasurement_kit/common/reactor_pool.hpp"
+#include "src/libmeasurement_kit/ndt/run.hpp"
+
+using namespace mk;
+
+static Error run_ndt(bench::NdtServer &server, int test_suite,
+                     SharedPtr<nlohmann::json> entry) {
+    Settings settings;
+    settings["test_suite"] = test_suite;
+    SharedPtr<Logger> logger = Logger::make();
+    logger->on_log(nullptr); // Keep the benchmark output readable
+    Error error = GenericError();
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        ndt::run_with_specific_server(entry, "127.0.0.1", server.port(),
+                                      [&](Error err) {
+                                          error = err;
+                                          reactor->stop();
+                                      },
+                                      settings, reactor, logger);
+    });
+    return error;
+}
+
+TEST_CASE("ndt::run works with the loopback server") {
+    ReactorPool pool{1};
+    bench::NdtServer::Config config;
+    config.c2s_duration = 0.5;
+    config.s2c_duration = 0.5;
+    config.num_streams = 2;
+    bench::NdtServer server{config, pool.at(0), Logger::make()};
+
+    SECTION("With the extended tests") {
+        SharedPtr<nlohmann::json> entry{new nlohmann::json};
+        REQUIRE(run_ndt(server, MK_NDT_UPLOAD_EXT | MK_NDT_DOWNLOAD_EXT,
+                        entry) == NoError());
+        REQUIRE((*entry)["phase_result"]["upload_ext"] == "");
+        REQUIRE((*entry)["phase_result"]["download_ext"] == "");
+        REQUIRE((*entry)["test_s2c"][0]["params"]["num_streams"] == 2);
+        REQUIRE(server.c2s_stats().bytes > 0);
+        REQUIRE(server.s2c_stats().bytes > 0);
+    }
+
+    SECTION("With the download test") {
+        SharedPtr<nlohmann::json> entry{new nlohmann::json};
+        REQUIRE(run_ndt(server, MK_NDT_DOWNLOAD, entry) == NoError());
+        REQUIRE((*entry)["phase_result"]["download"] == "");
+        REQUIRE(server.s2c_stats().bytes > 0);
+    }
+}
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of ndt::run over loopback", "[.][benchmark]") {
+    ReactorPool pool{1};
+    for (int num_streams : {1, 4}) {
+        bench::NdtServer::Config config;
+        config.c2s_duration = 5.0;
+        config.s2c_duration = 5.0;
+        config.num_streams = num_streams;
+        bench::NdtServer server{config, pool.at(0), Logger::make()};
+        std::string suffix = " (" + std::to_string(num_streams) + " streams)";
+
+        bench::Measurement c2s;
+        c2s.start();
+        REQUIRE(run_ndt(server, MK_NDT_UPLOAD_EXT,
+                        SharedPtr<nlohmann::json>{new nlohmann::json}) ==
+                NoError());
+        c2s.stop();
+        c2s.report("ndt c2s" + suffix, server.c2s_stats().bytes,
+                   server.c2s_stats().seconds);
+
+        bench::Measurement s2c;
+        s2c.start();
+        REQUIRE(run_ndt(server, MK_NDT_DOWNLOAD_EXT,
+                        SharedPtr<nlohmann::json>{new nlohmann::json}) ==
+                NoError());
+        s2c.stop();
+        s2c.report("ndt s2c" + suffix, server.s2c_stats().bytes,
+                   server.s2c_stats().seconds);
+    }
+}
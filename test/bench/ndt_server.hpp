@@ -0,0 +1,273 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef TEST_BENCH_NDT_SERVER_HPP
+#define TEST_BENCH_NDT_SERVER_HPP
+
+#include "test/bench/listener.hpp"
+
+#include "src/libmeasurement_kit/common/lexical_cast.hpp"
+#include "src/libmeasurement_kit/common/unique_ptr.hpp"
+#include "src/libmeasurement_kit/ndt/messages_impl.hpp"
+
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mk {
+namespace bench {
+
+/*
+ * Stand-in for a NDT server, speaking just what ndt::run needs to run the
+ * upload (C2S, C2S_EXT) and the download (S2C, S2C_EXT) tests over loopback.
+ * It does not run META, it does not send web100 variables and it writes the
+ * same chunk over and over, so that the cost of the test is the client's.
+ */
+class NdtServer : public NonCopyable, public NonMovable {
+  public:
+    class Config {
+      public:
+        double c2s_duration = 2.0; /* Only used by C2S_EXT */
+        double s2c_duration = 2.0;
+        int num_streams = 1;       /* Only used by the extended tests */
+    };
+
+    class Stats {
+      public:
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+    };
+
+    // Uses `reactor`, which must be running in a background thread, e.g. as
+    // part of a ReactorPool, for accepting and serving clients
+    NdtServer(Config config, SharedPtr<Reactor> reactor,
+              SharedPtr<Logger> logger)
+        : state_{new State} {
+        state_->config = config;
+        state_->chunk = make_chunk();
+        SharedPtr<State> state = state_;
+        listener_.reset(new Listener(reactor, logger,
+                                     [=](SharedPtr<net::Transport> txp) {
+                                         serve(state, reactor, logger, txp);
+                                     }));
+    }
+
+    int port() const { return listener_->port(); }
+
+    // Statistics of the latest upload and download tests
+    Stats c2s_stats() {
+        std::unique_lock<std::mutex> _{state_->mutex};
+        return state_->c2s;
+    }
+
+    Stats s2c_stats() {
+        std::unique_lock<std::mutex> _{state_->mutex};
+        return state_->s2c;
+    }
+
+  private:
+    class State {
+      public:
+        Config config;
+        SharedPtr<std::string> chunk;
+        std::mutex mutex;
+        Stats c2s;
+        Stats s2c;
+    };
+
+    // Connections and counters of a C2S or S2C test
+    class Test {
+      public:
+        SharedPtr<Listener> listener;
+        size_t num_streams = 1;
+        size_t closed = 0;
+        uint64_t bytes = 0;
+        double begin = 0.0;
+    };
+
+    static void send(SharedPtr<ndt::Context> ctx, uint8_t type,
+                     nlohmann::json message) {
+        ErrorOr<net::Buffer> out = ndt::messages::format_any(type, message);
+        ndt::messages::write_noasync(ctx, *out);
+    }
+
+    static void serve(SharedPtr<State> state, SharedPtr<Reactor> reactor,
+                      SharedPtr<Logger> logger, SharedPtr<net::Transport> txp) {
+        SharedPtr<ndt::Context> ctx{std::make_shared<ndt::Context>()};
+        ctx->logger = logger;
+        ctx->reactor = reactor;
+        ctx->txp = txp;
+        ndt::messages::read_json(ctx, [=](Error err, uint8_t type,
+                                          nlohmann::json m) {
+            int tests = 0;
+            if (!err && type == MSG_EXTENDED_LOGIN) {
+                try {
+                    tests = lexical_cast<int>(m.at("tests").get<std::string>());
+                } catch (const std::exception &) {
+                    /* nothing */
+                }
+            }
+            if (tests == 0) {
+                logger->warn("ndt_server: invalid login");
+                txp->close([]() {});
+                return;
+            }
+            std::list<int> granted;
+            for (int id : {TEST_C2S_EXT, TEST_C2S, TEST_S2C_EXT, TEST_S2C}) {
+                // Grant the extended test in place of the plain one
+                if ((tests & id) != 0 &&
+                    (id != TEST_C2S || (tests & TEST_C2S_EXT) == 0) &&
+                    (id != TEST_S2C || (tests & TEST_S2C_EXT) == 0)) {
+                    granted.push_back(id);
+                }
+            }
+            std::string ids;
+            for (int id : granted) {
+                ids += (ids.empty() ? "" : " ") + std::to_string(id);
+            }
+            txp->write(std::string{KICKOFF_MESSAGE});
+            send(ctx, SRV_QUEUE, {{"msg", "0"}});
+            send(ctx, MSG_LOGIN, {{"msg", MSG_NDT_VERSION " (loopback)"}});
+            send(ctx, MSG_LOGIN, {{"msg", ids}});
+            run_tests(state, ctx, granted);
+        }, reactor);
+    }
+
+    static void run_tests(SharedPtr<State> state, SharedPtr<ndt::Context> ctx,
+                          std::list<int> tests) {
+        if (tests.empty()) {
+            ErrorOr<net::Buffer> out = ndt::messages::format_any(
+                  MSG_LOGOUT, {{"msg", ""}});
+            ndt::messages::write(ctx, *out, [=](Error) {
+                ctx->txp->close([]() {});
+            });
+            return;
+        }
+        int id = tests.front();
+        tests.pop_front();
+        auto next = [=]() { run_tests(state, ctx, tests); };
+        if (id == TEST_C2S || id == TEST_C2S_EXT) {
+            run_c2s(state, ctx, id == TEST_C2S_EXT, next);
+        } else {
+            run_s2c(state, ctx, id == TEST_S2C_EXT, next);
+        }
+    }
+
+    // Tells the client to connect to a new listener and calls back once all
+    // the streams it should open are connected. Note that the test does not
+    // own the streams, which are destroyed as soon as they are closed.
+    static void prepare(SharedPtr<State> state, SharedPtr<ndt::Context> ctx,
+                        bool ext, double duration, Callback<SharedPtr<Test>,
+                        std::vector<SharedPtr<net::Transport>>> &&cb) {
+        SharedPtr<Test> test{std::make_shared<Test>()};
+        test->num_streams = ext ? state->config.num_streams : 1;
+        SharedPtr<std::vector<SharedPtr<net::Transport>>> streams{
+              std::make_shared<std::vector<SharedPtr<net::Transport>>>()};
+        test->listener.reset(new Listener(
+              ctx->reactor, ctx->logger, [=](SharedPtr<net::Transport> txp) {
+                  streams->push_back(txp);
+                  if (streams->size() == test->num_streams) {
+                      test->listener = nullptr;
+                      cb(test, std::move(*streams));
+                  }
+              }));
+        std::string msg = std::to_string(test->listener->port());
+        if (ext) {
+            msg += " " + std::to_string((int)(duration * 1000.0)) +
+                   " 0 500 0 " + std::to_string(test->num_streams);
+        }
+        send(ctx, TEST_PREPARE, {{"msg", msg}});
+    }
+
+    static double record(SharedPtr<State> state, Stats &stats,
+                         SharedPtr<Test> test) {
+        double seconds = time_now() - test->begin;
+        std::unique_lock<std::mutex> _{state->mutex};
+        stats.bytes = test->bytes;
+        stats.seconds = seconds;
+        return (seconds > 0.0) ? (test->bytes * 8.0 / 1000.0 / seconds) : 0.0;
+    }
+
+    // Discards what the client sends until it closes all the streams
+    static void run_c2s(SharedPtr<State> state, SharedPtr<ndt::Context> ctx,
+                        bool ext, Callback<> cb) {
+        prepare(state, ctx, ext, state->config.c2s_duration,
+                [=](SharedPtr<Test> test,
+                    std::vector<SharedPtr<net::Transport>> streams) {
+            auto closed = [=]() {
+                if (++test->closed < test->num_streams) {
+                    return;
+                }
+                double speed = record(state, state->c2s, test);
+                send(ctx, TEST_MSG, {{"msg", std::to_string(speed)}});
+                send(ctx, TEST_FINALIZE, {{"msg", ""}});
+                cb();
+            };
+            for (auto txp : streams) {
+                txp->on_data([=](net::Buffer data) {
+                    test->bytes += data.length();
+                });
+                txp->on_error([=](Error) { txp->close(closed); });
+            }
+            test->begin = time_now();
+            send(ctx, TEST_START, {{"msg", ""}});
+        });
+    }
+
+    // Sends to the client for the configured duration, then closes all the
+    // streams and exchanges the measured speed with the client
+    static void run_s2c(SharedPtr<State> state, SharedPtr<ndt::Context> ctx,
+                        bool ext, Callback<> cb) {
+        prepare(state, ctx, ext, state->config.s2c_duration,
+                [=](SharedPtr<Test> test,
+                    std::vector<SharedPtr<net::Transport>> streams) {
+            double duration = state->config.s2c_duration;
+            SharedPtr<std::string> chunk = state->chunk;
+            auto closed = [=]() {
+                if (++test->closed < test->num_streams) {
+                    return;
+                }
+                double speed = record(state, state->s2c, test);
+                send(ctx, TEST_MSG, {{"ThroughputValue", speed},
+                                     {"UnsentDataAmount", 0},
+                                     {"TotalSentByte", test->bytes}});
+                ndt::messages::read_msg(ctx, [=](Error err, uint8_t type,
+                                                 std::string) {
+                    if (err || type != TEST_MSG) {
+                        ctx->logger->warn("ndt_server: no client speed");
+                        ctx->txp->close([]() {});
+                        return;
+                    }
+                    send(ctx, TEST_FINALIZE, {{"msg", ""}});
+                    cb();
+                }, ctx->reactor);
+            };
+            send(ctx, TEST_START, {{"msg", ""}});
+            test->begin = time_now();
+            for (auto txp : streams) {
+                set_write_low_watermark(txp);
+                txp->on_flush([=]() {
+                    test->bytes += chunk_size;
+                    if (time_now() - test->begin < duration) {
+                        write_chunk(txp, chunk);
+                        return;
+                    }
+                    txp->close(closed);
+                });
+                txp->on_error([=](Error) { txp->close(closed); });
+                write_chunk(txp, chunk);
+                write_chunk(txp, chunk);
+            }
+        });
+    }
+
+    SharedPtr<State> state_;
+    UniquePtr<Listener> listener_;
+};
+
+} // namespace bench
+} // namespace mk
+#endif
@@ -0,0 +1,41 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef TEST_BENCH_TIMING_HPP
+#define TEST_BENCH_TIMING_HPP
+
+/*
+ * Compares the wall clock time of a new implementation with the one of the
+ * implementation it replaced, in hidden "[.][benchmark]" test cases that
+ * only `make bench` runs. Unlike bench.hpp, it does not replace the global
+ * allocation functions, so unit tests can also include it.
+ */
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <stdio.h>
+
+#include <iostream>
+#include <string>
+
+namespace mk {
+namespace bench {
+
+template <typename Func> double seconds_for(Func &&func) {
+    double begin = time_now();
+    func();
+    return time_now() - begin;
+}
+
+static inline void report_speedup(std::string name, double old_seconds,
+                                  double new_seconds) {
+    char line[256];
+    snprintf(line, sizeof(line), "%-48s %9.6f s -> %9.6f s (%.1fx)",
+             name.c_str(), old_seconds, new_seconds,
+             (new_seconds > 0.0) ? old_seconds / new_seconds : 0.0);
+    std::cout << line << std::endl;
+}
+
+} // namespace bench
+} // namespace mk
+#endif
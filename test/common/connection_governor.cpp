@@ -0,0 +1,141 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/connection_governor.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace mk;
+
+using Slot = ConnectionGovernor::Slot;
+using Priority = ConnectionGovernor::Priority;
+
+TEST_CASE("ConnectionGovernor parses the priority") {
+    REQUIRE(ConnectionGovernor::priority_from_string("control") ==
+            Priority::control);
+    REQUIRE(ConnectionGovernor::priority_from_string("measurement") ==
+            Priority::measurement);
+    REQUIRE(ConnectionGovernor::priority_from_string("") ==
+            Priority::measurement);
+}
+
+TEST_CASE("ConnectionGovernor grants slots immediately without limits") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<ConnectionGovernor> governor = ConnectionGovernor::make();
+    std::vector<SharedPtr<Slot>> slots;
+    for (size_t i = 0; i < 100; ++i) {
+        governor->acquire(Priority::measurement, reactor,
+                          [&](SharedPtr<Slot> slot) { slots.push_back(slot); });
+    }
+    REQUIRE(slots.size() == 100);
+    REQUIRE(governor->stats().connecting == 100);
+    REQUIRE(governor->stats().waited == 0);
+    slots.clear();
+    REQUIRE(governor->stats().connecting == 0);
+}
+
+TEST_CASE("ConnectionGovernor serves control before measurements") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<ConnectionGovernor> governor = ConnectionGovernor::make();
+    governor->set_limits(1, 0);
+    std::vector<std::string> order;
+    std::vector<SharedPtr<Slot>> slots;
+    auto acquire = [&](Priority priority, std::string name) {
+        governor->acquire(priority, reactor, [&, name](SharedPtr<Slot> slot) {
+            order.push_back(name);
+            slots.push_back(slot);
+        });
+    };
+    reactor->run_with_initial_event([&]() {
+        acquire(Priority::measurement, "m0");
+        acquire(Priority::measurement, "m1");
+        acquire(Priority::measurement, "m2");
+        acquire(Priority::control, "c0");
+        REQUIRE(order == std::vector<std::string>{"m0"});
+        REQUIRE(governor->stats().queued == 3);
+        // Each connect that completes lets the next request go
+        reactor->call_later(0.1, [&]() {
+            slots.front()->connected();
+            reactor->call_later(0.1, [&]() {
+                slots.back()->connected();
+                reactor->call_later(0.1, [&]() {
+                    slots.back()->connected();
+                    reactor->call_soon([&]() { reactor->stop(); });
+                });
+            });
+        });
+    });
+    REQUIRE((order == std::vector<std::string>{"m0", "c0", "m1", "m2"}));
+    ConnectionGovernor::Stats stats = governor->stats();
+    REQUIRE(stats.granted == 4);
+    REQUIRE(stats.waited == 3);
+    REQUIRE(stats.queued == 0);
+    REQUIRE(stats.connecting == 1);
+    REQUIRE(stats.open == 3);
+    REQUIRE(stats.max_wait >= 0.2);
+    REQUIRE(stats.total_wait >= 0.1 + 0.2 + 0.3 - 0.05);
+}
+
+TEST_CASE("ConnectionGovernor limits the open sockets") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<ConnectionGovernor> governor = ConnectionGovernor::make();
+    governor->set_limits(0, 2);
+    std::vector<SharedPtr<Slot>> slots;
+    reactor->run_with_initial_event([&]() {
+        for (size_t i = 0; i < 3; ++i) {
+            governor->acquire(Priority::measurement, reactor,
+                              [&](SharedPtr<Slot> slot) {
+                                  slot->connected();
+                                  slots.push_back(slot);
+                              });
+        }
+        REQUIRE(slots.size() == 2);
+        REQUIRE(governor->stats().open == 2);
+        // Being connected does not free the slot, closing does
+        reactor->call_later(0.1, [&]() {
+            REQUIRE(slots.size() == 2);
+            slots.erase(slots.begin());
+            reactor->call_later(0.1, [&]() {
+                REQUIRE(slots.size() == 2);
+                reactor->stop();
+            });
+        });
+    });
+    REQUIRE(governor->stats().open == 2);
+    REQUIRE(governor->stats().waited == 1);
+}
+
+TEST_CASE("ConnectionGovernor lets queued requests go when limits grow") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<ConnectionGovernor> governor = ConnectionGovernor::make();
+    governor->set_limits(1, 1);
+    std::vector<SharedPtr<Slot>> slots;
+    reactor->run_with_initial_event([&]() {
+        for (size_t i = 0; i < 4; ++i) {
+            governor->acquire(Priority::measurement, reactor,
+                              [&](SharedPtr<Slot> slot) {
+                                  slots.push_back(slot);
+                                  if (slots.size() == 4) {
+                                      reactor->stop();
+                                  }
+                              });
+        }
+        REQUIRE(slots.size() == 1);
+        governor->set_limits(0, 0);
+    });
+    REQUIRE(slots.size() == 4);
+}
+
+TEST_CASE("Reactor has a connection governor") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    REQUIRE(!!reactor->connection_governor());
+    REQUIRE(reactor->connection_governor().get() ==
+            reactor->connection_governor().get());
+}
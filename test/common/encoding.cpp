@@ -12,6 +12,8 @@
 
 #include "include/private/catch.hpp"
 
+#include "test/bench/timing.hpp"
+
 #include "src/libmeasurement_kit/common/encoding.hpp"
 
 #ifndef _MSC_VER
@@ -21,6 +23,11 @@
 #include <event2/util.h>
 
 #include <measurement_kit/common.hpp>
+#include <measurement_kit/internal/vendor/mkdata.hpp>
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <random>
 
 TEST_CASE("utf8_parse works") {
 
@@ -46,11 +53,13 @@ TEST_CASE("utf8_parse works") {
     }
 
     SECTION("If there is a null byte in the middle") {
+        // NUL is valid UTF-8 and bodies containing it used to be reported
+        // as strings, hence we accept it, like mk::data does
         std::vector<uint8_t> v{'g', 'o', 'o', 'd', 'b',  'y',  'e',
                                ',', ' ', 'c', 'r', 0x00, 0x00, 'e',
                                'l', ' ', 'w', 'o', 'r',  'l',  'd'};
         std::string s{v.begin(), v.end()};
-        REQUIRE(mk::utf8_parse(s) == mk::UnexpectedNullByteError());
+        REQUIRE(mk::utf8_parse(s) == mk::NoError());
     }
 
     SECTION("If the UTF-8 sequence is not complete") {
@@ -111,4 +120,65 @@ TEST_CASE("base64_encode() works as expected") {
 #endif
 }
 
+TEST_CASE("utf8_parse agrees with mk::data::contains_valid_utf8") {
+    // Valid sequences of each length, including NUL bytes, plus bytes that
+    // may break them
+    std::vector<std::string> pieces{
+            "a", "abcdefgh", std::string(1, '\0'), std::string("abc\0efgh", 8),
+            "\xc3\xa8", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xed\x9f\xbf",
+            "\xf4\x8f\xbf\xbf", "\x80", "\xbf", "\xc0", "\xc1", "\xc2", "\xe0",
+            "\xe0\x9f", "\xed\xa0", "\xf0\x8f", "\xf4\x90", "\xf5", "\xff"};
+    std::mt19937 rng{17};
+    for (size_t i = 0; i < 20000; ++i) {
+        std::string s;
+        size_t count = rng() % 12;
+        for (size_t j = 0; j < count; ++j) {
+            s += pieces[rng() % pieces.size()];
+        }
+        INFO(mk::base64_encode(s));
+        REQUIRE((mk::utf8_parse(s) == mk::NoError()) ==
+                mk::data::contains_valid_utf8(s));
+    }
+}
+
+TEST_CASE("base64_encode agrees with mk::data::base64_encode") {
+    std::mt19937 rng{17};
+    for (size_t len = 0; len < 300; ++len) {
+        std::string s;
+        for (size_t i = 0; i < len; ++i) {
+            s += (char)(rng() & 0xff);
+        }
+        REQUIRE(mk::base64_encode(s) == mk::data::base64_encode(s));
+    }
+}
+
+using mk::bench::seconds_for;
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of utf8_parse and base64_encode against mk::data",
+          "[.][benchmark]") {
+    // A page body that is mostly ASCII markup with some UTF-8 text
+    std::string body;
+    while (body.size() < (1 << 22)) {
+        body += "<div class=\"item\"><a href=\"/x\">" +
+                mk::random_printable(64) + "</a> caff\xc3\xa8 \xe2\x82\xac "
+                "</div>\n";
+    }
+    bool valid = false;
+    double dfa_time = seconds_for(
+            [&]() { valid = mk::data::contains_valid_utf8(body); });
+    mk::Error err;
+    double time = seconds_for([&]() { err = mk::utf8_parse(body); });
+    REQUIRE(valid == true);
+    REQUIRE(err == mk::NoError());
+    mk::bench::report_speedup("utf8_parse (4 MiB)", dfa_time, time);
+
+    std::string expect, result;
+    double b64_old_time =
+            seconds_for([&]() { expect = mk::data::base64_encode(body); });
+    double b64_time = seconds_for([&]() { result = mk::base64_encode(body); });
+    REQUIRE(result == expect);
+    mk::bench::report_speedup("base64_encode (4 MiB)", b64_old_time, b64_time);
+}
+
 #endif
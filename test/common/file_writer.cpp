@@ -0,0 +1,175 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/file_writer.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace mk;
+
+static const char *path = "file_writer.txt";
+
+static std::string read_file() {
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE("FileWriter deals with open errors") {
+    FileWriter writer;
+    REQUIRE(writer.open("/nonexistent/foobar.txt") == FileIoError());
+    REQUIRE(!writer.is_open());
+    writer << "foo";
+    REQUIRE(writer.end_record() == FileIoError());
+    REQUIRE(writer.commit() == FileIoError());
+    REQUIRE(writer.close() == NoError());
+}
+
+TEST_CASE("FileWriter commits every record by default") {
+    FileWriter writer;
+    REQUIRE(writer.open(path) == NoError());
+    writer << "foo\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "foo\n");
+    writer << "bar\n";
+    REQUIRE(read_file() == "foo\n");
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "foo\nbar\n");
+    REQUIRE(writer.close() == NoError());
+}
+
+TEST_CASE("FileWriter commits every N records") {
+    FileWriter writer;
+    writer.flush_every = 3;
+    writer.fsync = true;
+    REQUIRE(writer.open(path) == NoError());
+    for (int i = 0; i < 2; ++i) {
+        writer << i << "\n";
+        REQUIRE(writer.end_record() == NoError());
+    }
+    REQUIRE(read_file() == "");
+    writer << 2 << "\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "0\n1\n2\n");
+    writer << 3 << "\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "0\n1\n2\n");
+    REQUIRE(writer.close() == NoError());
+    REQUIRE(read_file() == "0\n1\n2\n3\n");
+}
+
+TEST_CASE("FileWriter commits a record ending after the minimum interval") {
+    FileWriter writer;
+    writer.flush_every = 0;
+    writer.min_flush_interval = 0.1;
+    REQUIRE(writer.open(path) == NoError());
+    writer << "foo\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "");
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    // Without a new record the data is still buffered
+    REQUIRE(read_file() == "");
+    writer << "bar\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(read_file() == "foo\nbar\n");
+}
+
+TEST_CASE("FileWriter deals with records larger than its buffer") {
+    std::string big(100000, 'x');
+    {
+        FileWriter writer;
+        writer.flush_every = 0;
+        REQUIRE(writer.open(path) == NoError());
+        writer << "foo\n";
+        writer << big;
+        REQUIRE(writer.end_record() == NoError());
+        REQUIRE(read_file() == "foo\n" + big);
+        writer << "\n";
+        // Destructor should commit and close
+    }
+    REQUIRE(read_file() == "foo\n" + big + "\n");
+}
+
+#ifndef MK_WITHOUT_ZLIB
+
+static std::string gunzip_file(const char *p) {
+    std::string out;
+    gzFile file = gzopen(p, "rb");
+    REQUIRE(file != nullptr);
+    char buf[1024];
+    int n = 0;
+    while ((n = gzread(file, buf, sizeof(buf))) > 0) {
+        out.append(buf, (size_t)n);
+    }
+    gzclose(file);
+    return out;
+}
+
+TEST_CASE("FileWriter writes a gzip member on each commit") {
+    static const char *gz_path = "file_writer.txt.gz";
+    std::string big(100000, 'x');
+    FileWriter writer;
+    writer.gzip = true;
+    writer.flush_every = 2;
+    REQUIRE(writer.open(gz_path) == NoError());
+    for (int i = 0; i < 3; ++i) {
+        writer << i << "\n";
+        REQUIRE(writer.end_record() == NoError());
+    }
+    writer << big << "\n";
+    REQUIRE(writer.end_record() == NoError());
+    REQUIRE(writer.close() == NoError());
+    REQUIRE(gunzip_file(gz_path) == "0\n1\n2\n" + big + "\n");
+
+    SECTION("Each member is independently decodable") {
+        std::string data;
+        {
+            std::ifstream file(gz_path, std::ios::binary);
+            std::stringstream ss;
+            ss << file.rdbuf();
+            data = ss.str();
+        }
+        // The first member only contains the first two records
+        z_stream stream{};
+        REQUIRE(inflateInit2(&stream, MAX_WBITS + 16) == Z_OK);
+        std::string out(1024, '\0');
+        stream.next_in = (Bytef *)data.data();
+        stream.avail_in = (uInt)data.size();
+        stream.next_out = (Bytef *)&out[0];
+        stream.avail_out = (uInt)out.size();
+        REQUIRE(inflate(&stream, Z_NO_FLUSH) == Z_STREAM_END);
+        out.resize(out.size() - stream.avail_out);
+        REQUIRE(out == "0\n1\n");
+        // Losing the tail of the file only loses the last records
+        size_t first_member = data.size() - stream.avail_in;
+        inflateEnd(&stream);
+        {
+            std::ofstream file(gz_path, std::ios::binary);
+            file.write(data.data(), (std::streamsize)first_member + 10);
+        }
+        REQUIRE(gunzip_file(gz_path) == "0\n1\n");
+    }
+}
+
+#else
+
+TEST_CASE("FileWriter fails to open gzip files without zlib") {
+    FileWriter writer;
+    writer.gzip = true;
+    REQUIRE(writer.open(path) == NotImplementedError());
+}
+
+#endif
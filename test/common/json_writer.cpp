@@ -0,0 +1,41 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/json_writer.hpp"
+
+using namespace mk;
+
+TEST_CASE("json_dump() writes what dump() would write") {
+    nlohmann::json doc = {
+        {"array", {1, -2, 3.5, true, false, nullptr}},
+        {"empty_array", nlohmann::json::array()},
+        {"empty_object", nlohmann::json::object()},
+        {"nested", {{"a", {{"b", {"c"}}}}}},
+        {"number", 1.0 / 3.0},
+        {"unsigned", (uint64_t)18446744073709551615ULL},
+    };
+    std::string s;
+    for (int i = 0; i < 0x80; ++i) {
+        s += (char)i;
+    }
+    s += "\xc3\xa8\xe2\x82\xac\xf0\x9f\x98\x80"; // Multibyte sequences
+    doc["string"] = s;
+    doc[s] = "key with weird chars";
+    REQUIRE(json_dump(doc) == doc.dump());
+}
+
+TEST_CASE("json_dump() rejects invalid UTF-8 like dump()") {
+    const char *bad[] = {
+        "\xff", "\xc0\x80", "\xc3", "\xe0\x80\x80", "\xed\xa0\x80",
+        "\xf4\x90\x80\x80", "\xf0\x9f\x98",
+    };
+    for (auto s : bad) {
+        REQUIRE_THROWS(nlohmann::json(s).dump());
+        REQUIRE_THROWS_AS(json_dump(nlohmann::json(s)), JsonProcessingError);
+    }
+}
@@ -12,6 +12,7 @@
 
 #include <string>
 #include <fstream>
+#include <sstream>
 
 using namespace mk;
 
@@ -84,6 +85,41 @@ TEST_CASE("We can log on a logfile") {
     REQUIRE(whole_file == "foo\nfoobar\nbar\n");
 }
 
+TEST_CASE("The logfile is written when a warning is logged") {
+    std::string whole_file;
+    auto read_logfile = [&]() {
+        std::ifstream file("logfile.log");
+        std::stringstream ss;
+        ss << file.rdbuf();
+        whole_file = ss.str();
+    };
+    SharedPtr<Logger> logger = Logger::make();
+    logger->set_logfile("logfile.log");
+    logger->set_verbosity(MK_LOG_DEBUG);
+    logger->on_log(nullptr);
+    logger->info("foo");
+    logger->debug("foobar");
+    read_logfile();
+    REQUIRE(whole_file == "");
+    logger->warn("bar");
+    read_logfile();
+    REQUIRE(whole_file == "foo\nfoobar\nbar\n");
+}
+
+TEST_CASE("flush() writes the buffered lines into the logfile") {
+    SharedPtr<Logger> logger = Logger::make();
+    logger->set_logfile("logfile.log");
+    logger->set_verbosity(MK_LOG_DEBUG);
+    logger->on_log(nullptr);
+    logger->info("foo");
+    logger->debug("foobar");
+    logger->flush();
+    std::ifstream file("logfile.log");
+    std::stringstream ss;
+    ss << file.rdbuf();
+    REQUIRE(ss.str() == "foo\nfoobar\n");
+}
+
 TEST_CASE("A logger without file and without callback works") {
     SharedPtr<Logger> logger = Logger::make();
     logger->set_verbosity(MK_LOG_DEBUG);
@@ -162,3 +198,35 @@ TEST_CASE("The logsv API works as expected") {
     logger->logsv(MK_LOG_INFO, foobar);
     REQUIRE(buffer == "Foo\nBar\nFoo\nBar\n");
 }
+
+TEST_CASE("The log_lazy API works as expected") {
+    std::string buffer;
+    auto called = 0;
+    auto logger = mk::Logger::make();
+    logger->on_log([&buffer](uint32_t, const char *s) {
+        buffer += s;
+        buffer += "\n";
+    });
+    auto mkmsg = [&called](std::string s) {
+        return [&called, s]() {
+            ++called;
+            return s;
+        };
+    };
+    logger->set_verbosity(MK_LOG_INFO);
+    logger->log_lazy(MK_LOG_DEBUG, mkmsg("Antani"));
+    logger->log_lazy(MK_LOG_INFO, mkmsg("Foo"));
+    logger->log_lazy(MK_LOG_DEBUG2, mkmsg("Antani"));
+    logger->log_lazy(MK_LOG_WARNING, mkmsg("Bar %s"));  // not a format string
+    REQUIRE(buffer == "Foo\nBar %s\n");
+    REQUIRE(called == 2);
+}
+
+TEST_CASE("increase_verbosity() saturates") {
+    auto logger = mk::Logger::make();
+    logger->set_verbosity(MK_LOG_VERBOSITY_MASK - 1);
+    logger->increase_verbosity();
+    REQUIRE(logger->get_verbosity() == MK_LOG_VERBOSITY_MASK);
+    logger->increase_verbosity();
+    REQUIRE(logger->get_verbosity() == MK_LOG_VERBOSITY_MASK);
+}
@@ -0,0 +1,59 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/reactor_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+
+using namespace mk;
+
+TEST_CASE("ReactorPool runs each reactor in its own thread") {
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    size_t called = 0;
+    {
+        ReactorPool pool{4};
+        REQUIRE(pool.size() == 4);
+        for (size_t i = 0; i < pool.size(); ++i) {
+            // Let the reactors be idle for a while before using them
+            pool.at(i)->call_later(0.5, [&]() {
+                std::unique_lock<std::mutex> _{mutex};
+                threads.insert(std::this_thread::get_id());
+                called += 1;
+            });
+        }
+        // The destructor waits for the reactors to run what we scheduled
+    }
+    REQUIRE(called == 4);
+    REQUIRE(threads.size() == 4);
+    REQUIRE(threads.count(std::this_thread::get_id()) == 0);
+}
+
+TEST_CASE("ReactorPool can be stopped before being destroyed") {
+    ReactorPool pool{2};
+    pool.stop();
+}
+
+TEST_CASE("KeepAlive keeps an idle reactor running until released") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    KeepAlive keep_alive{reactor};
+    std::atomic_bool returned{false};
+    std::thread thread{[&]() {
+        reactor->run();
+        returned = true;
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    REQUIRE(!returned);
+    keep_alive.release(); // From another thread, it wakes up the reactor
+    thread.join();
+    REQUIRE(returned);
+    keep_alive.release(); // Releasing again has no effect
+}
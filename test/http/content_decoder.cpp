@@ -0,0 +1,133 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/http/content_decoder.hpp"
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace mk;
+using namespace mk::http;
+
+TEST_CASE("ContentDecoder::make() works as expected") {
+    SECTION("With the identity encoding") {
+        auto maybe_decoder = ContentDecoder::make("identity");
+        REQUIRE(!!maybe_decoder);
+        REQUIRE(!*maybe_decoder);
+    }
+
+    SECTION("With an empty encoding") {
+        auto maybe_decoder = ContentDecoder::make(" ");
+        REQUIRE(!!maybe_decoder);
+        REQUIRE(!*maybe_decoder);
+    }
+
+    SECTION("With an unsupported encoding") {
+        auto maybe_decoder = ContentDecoder::make("br");
+        REQUIRE(!maybe_decoder);
+        REQUIRE(maybe_decoder.as_error() == UnsupportedContentEncodingError());
+    }
+
+#ifndef MK_WITHOUT_ZLIB
+    SECTION("With supported encodings") {
+        for (auto s : {"gzip", "GZip", "x-gzip", " deflate "}) {
+            auto maybe_decoder = ContentDecoder::make(s);
+            REQUIRE(!!maybe_decoder);
+            REQUIRE(!!*maybe_decoder);
+        }
+    }
+#endif
+}
+
+#ifndef MK_WITHOUT_ZLIB
+
+static std::string compress_with(int window_bits, std::string input) {
+    z_stream stream{};
+    REQUIRE(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits,
+                         8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string output(deflateBound(&stream, input.size()), '\0');
+    stream.next_in = (Bytef *)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef *)&output[0];
+    stream.avail_out = output.size();
+    REQUIRE(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return output;
+}
+
+static ErrorOr<std::string> decode_all(std::string encoding, std::string input,
+                                       size_t chunk_size) {
+    auto decoder = *ContentDecoder::make(encoding);
+    std::string output;
+    for (size_t off = 0; off < input.size(); off += chunk_size) {
+        size_t n = std::min(chunk_size, input.size() - off);
+        Error err = decoder->decode(input.data() + off, n, output);
+        if (err) {
+            return {err, {}};
+        }
+    }
+    return {NoError(), output};
+}
+
+TEST_CASE("ContentDecoder decodes gzip and deflate bodies") {
+    auto maybe_fixture = slurp("./test/fixtures/gzipped.gz");
+    REQUIRE(!!maybe_fixture);
+    // Generate a body larger than the size of the decoder internal buffer
+    std::string large;
+    for (auto i = 0; i < 10000; ++i) {
+        large += "{\"input\": \"http://www.example.com/" + std::to_string(i) +
+                 "\"},\n";
+    }
+
+    for (size_t chunk_size : {1, 7, 512, 1 << 20}) {
+        SECTION("With the gzip fixture and chunk " +
+                std::to_string(chunk_size)) {
+            auto res = decode_all("gzip", *maybe_fixture, chunk_size);
+            REQUIRE(!!res);
+            REQUIRE(res->size() == 522);
+            REQUIRE(startswith(*res, "TODO\n====\n"));
+        }
+
+        SECTION("With zlib deflate and chunk " + std::to_string(chunk_size)) {
+            auto res = decode_all("deflate", compress_with(MAX_WBITS, large),
+                                  chunk_size);
+            REQUIRE(!!res);
+            REQUIRE(*res == large);
+        }
+
+        SECTION("With raw deflate and chunk " + std::to_string(chunk_size)) {
+            auto res = decode_all("deflate", compress_with(-MAX_WBITS, large),
+                                  chunk_size);
+            REQUIRE(!!res);
+            REQUIRE(*res == large);
+        }
+    }
+
+    SECTION("With multiple gzip members") {
+        auto res = decode_all("gzip", *maybe_fixture + *maybe_fixture, 64);
+        REQUIRE(!!res);
+        REQUIRE(res->size() == 2 * 522);
+    }
+
+    SECTION("With trailing garbage after the gzip stream") {
+        auto res = decode_all("gzip", *maybe_fixture + "garbage", 64);
+        REQUIRE(!!res);
+        REQUIRE(res->size() == 522);
+    }
+
+    SECTION("With invalid data") {
+        auto res = decode_all("gzip", "this is not gzip", 64);
+        REQUIRE(!res);
+        REQUIRE(res.as_error() == ContentDecodingError());
+    }
+}
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "include/private/catch.hpp"
 
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/http/content_decoder.hpp"
 #include "src/libmeasurement_kit/http/request_impl.hpp"
 #include "src/libmeasurement_kit/net/error.hpp"
 
@@ -103,6 +105,35 @@ TEST_CASE("HTTP Request class works as expected with explicit path") {
     REQUIRE(serialized == expect);
 }
 
+TEST_CASE("HTTP Request class adds Accept-Encoding when needed") {
+    Settings settings{
+        {"http/url", "http://www.example.com/"},
+        {"http/decode_content", true},
+    };
+    std::string accept_encoding = ContentDecoder::accept_encoding();
+
+    SECTION("When no Accept-Encoding header is set") {
+        Request request;
+        REQUIRE(request.init(settings, {}, "") == NoError());
+        REQUIRE(headers_find_first(request.headers, "Accept-Encoding") ==
+                accept_encoding);
+    }
+
+    SECTION("When the caller has set Accept-Encoding") {
+        Request request;
+        REQUIRE(request.init(settings, {{"accept-encoding", "identity"}}, "") ==
+                NoError());
+        REQUIRE(request.headers.size() == 1);
+    }
+
+    SECTION("When http/decode_content is false") {
+        settings["http/decode_content"] = false;
+        Request request;
+        REQUIRE(request.init(settings, {}, "") == NoError());
+        REQUIRE(request.headers.size() == 0);
+    }
+}
+
 /*
  _             _
 | | ___   __ _(_) ___
@@ -243,6 +274,59 @@ TEST_CASE("http::request_recv_response() behaves correctly when EOF "
     REQUIRE(called == 1);
 }
 
+static void recv_gzipped_response(bool decode) {
+    auto maybe_body = slurp("./test/fixtures/gzipped.gz");
+    REQUIRE(!!maybe_body);
+    std::string body = *maybe_body;
+    auto called = 0;
+
+    SharedPtr<Logger> logger = Logger::make();
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        connect("www.example.com", 80,
+                [&](Error err, SharedPtr<Transport> transport) {
+                    REQUIRE(!err);
+
+                    request_recv_response(transport,
+                                          [&](Error e, SharedPtr<Response> r) {
+                                              REQUIRE(e == NoError());
+                                              REQUIRE(r->encoded_body_length ==
+                                                      body.size());
+                                              if (decode) {
+                                                  REQUIRE(r->body.size() == 522);
+                                              } else {
+                                                  REQUIRE(r->body == body);
+                                              }
+                                              ++called;
+                                              reactor->stop();
+                                          }, {{"http/decode_content", decode}},
+                                          reactor, logger);
+
+                    Buffer data;
+                    data << "HTTP/1.1 200 Ok\r\n";
+                    data << "Content-Encoding: gzip\r\n";
+                    data << "Content-Length: " << std::to_string(body.size())
+                         << "\r\n";
+                    data << "\r\n";
+                    data << body;
+                    transport->emit_data(data);
+                },
+                {{"net/dumb_transport", true}}, reactor, logger);
+    });
+    REQUIRE(called == 1);
+}
+
+TEST_CASE("http::request_recv_response() decodes the body when asked") {
+    SECTION("When http/decode_content is false") {
+        recv_gzipped_response(false);
+    }
+#ifndef MK_WITHOUT_ZLIB
+    SECTION("When http/decode_content is true") {
+        recv_gzipped_response(true);
+    }
+#endif
+}
+
 TEST_CASE("http::request_recv_response() deals with immediate EOF") {
     SharedPtr<Reactor> reactor = Reactor::make();
     reactor->run_with_initial_event([=]() {
@@ -209,3 +209,48 @@ TEST_CASE("ResponseParserNg eof() works as expected") {
 
     REQUIRE(called);
 }
+
+TEST_CASE("ResponseParserNg passes body data without copying it") {
+    ResponseParserNg parser{Logger::make()};
+    Buffer buffer;
+    std::string body;
+    std::string value;
+    bool called = false;
+
+    buffer << "HTTP/1.1 200 Ok\r\n";
+    buffer << "Content-Type: text/plain\r\n";
+    buffer << "X-Antani: 1\r\n";
+    buffer << "x-antani: 2\r\n";
+    buffer << "Content-Length: 4096\r\n";
+    buffer << "\r\n";
+    for (auto i = 0; i < 64; ++i) {
+        buffer << std::string(64, 'A' + (i % 26));
+    }
+
+    parser.on_response([&](Response r) {
+        REQUIRE(r.headers.size() == 4);
+        REQUIRE(parser.headers().size() == 4);
+        size_t len = 0;
+        const char *p = parser.headers().find_first("X-ANTANI", &len);
+        REQUIRE(p != nullptr);
+        value.assign(p, len);
+        REQUIRE(parser.headers().find_first("Server", &len) == nullptr);
+        REQUIRE(len == 0);
+    });
+    parser.on_body_data([&](const char *s, size_t n) { body.append(s, n); });
+    parser.on_end([&]() { called = true; });
+    parser.feed(buffer);
+
+    REQUIRE(called);
+    REQUIRE(value == "1");
+    REQUIRE(body.size() == 4096);
+    REQUIRE(body.substr(0, 64) == std::string(64, 'A'));
+    REQUIRE(buffer.length() == 0);
+}
+
+TEST_CASE("HeaderArena::hash() is case insensitive") {
+    REQUIRE(HeaderArena::hash("Content-Type", 12) ==
+            HeaderArena::hash("cOnTeNt-tYpE", 12));
+    REQUIRE(HeaderArena::hash("Content-Type", 12) !=
+            HeaderArena::hash("Content-Typo", 12));
+}
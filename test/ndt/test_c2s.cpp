@@ -7,23 +7,75 @@
 #include "include/private/catch.hpp"
 
 #include "src/libmeasurement_kit/ndt/test_c2s_impl.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
 
 using namespace mk;
 using namespace mk::ndt;
 
-static void fail(std::string, int, Callback<Error, SharedPtr<Transport>> cb, Settings,
+static void fail(std::string, int, int, ConnectManyCb cb, Settings,
                  SharedPtr<Reactor>, SharedPtr<Logger>) {
-    cb(MockedError(), nullptr);
+    cb(MockedError(), {});
 }
 
 TEST_CASE("coroutine() is robust to connect error") {
     SharedPtr<nlohmann::json> entry{new nlohmann::json};
     test_c2s::coroutine_impl<fail>(
-        entry, "www.google.com", 3301, 10.0,
+        entry, "www.google.com", 3301,
         [](Error err, Continuation<Error>) { REQUIRE(err == MockedError()); },
         2.0, {}, Reactor::make(), Logger::make());
 }
 
+// XXX: static test function with a state is not good
+static std::vector<SharedPtr<Transport>> streams;
+
+static void connect_streams(std::string, int, int num, ConnectManyCb cb,
+                            Settings, SharedPtr<Reactor> reactor,
+                            SharedPtr<Logger> logger) {
+    for (int i = 0; i < num; ++i) {
+        streams.push_back(SharedPtr<Transport>{new Emitter(reactor, logger)});
+    }
+    cb(NoError(), streams);
+}
+
+TEST_CASE("coroutine() uploads using all the streams") {
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    auto sent = [&]() {
+        uint64_t up = 0;
+        reactor->with_current_data_usage([&](DataUsage &du) { up = du.up; });
+        return up;
+    };
+    Params params{3010};
+    params.num_streams = 3;
+    bool done = false;
+    test_c2s::coroutine_impl<connect_streams>(
+        entry, "127.0.0.1", params,
+        [&](Error err, Continuation<Error> cc) {
+            REQUIRE(err == NoError());
+            cc([&](Error err) {
+                REQUIRE(err == NoError());
+                done = true;
+            });
+        },
+        2.0, {}, reactor, Logger::make());
+    REQUIRE((*entry)["connect_times"].size() == 3);
+    REQUIRE((*entry)["params"]["num_streams"] == 3);
+
+    // Each stream queues two chunks and then one more for each chunk sent
+    REQUIRE(sent() == 3 * 2 * test_c2s::chunk_size);
+    streams[1]->emit_flush();
+    REQUIRE(sent() == 7 * test_c2s::chunk_size);
+
+    // We are done when all the streams have been closed
+    for (auto &txp : streams) {
+        txp->emit_error(NoError());
+    }
+    streams.resize(1);
+    REQUIRE(!done);
+    streams.clear();
+    REQUIRE(done);
+}
+
 static void fail(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
                  SharedPtr<Reactor> = Reactor::make()) {
     cb(MockedError(), 0, "");
@@ -86,7 +138,7 @@ static void test_prepare(SharedPtr<Context>,
     cb(NoError(), TEST_PREPARE, "3010");
 }
 
-static void fail(SharedPtr<nlohmann::json>, std::string, int, double,
+static void fail(SharedPtr<nlohmann::json>, std::string, Params,
                  Callback<Error, Continuation<Error>> cb, double, Settings,
                  SharedPtr<Reactor>, SharedPtr<Logger>) {
     cb(MockedError(), [](Callback<Error>) {
@@ -100,7 +152,57 @@ TEST_CASE("run() deals with coroutine fail") {
         ctx, [](Error err) { REQUIRE(err == ConnectTestConnectionError()); });
 }
 
-static void connect_but_fail_later(SharedPtr<nlohmann::json>, std::string, int, double,
+static void test_prepare_ext(SharedPtr<Context>,
+                             Callback<Error, uint8_t, std::string> cb,
+                             SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "3010 5000 0 1000 0 4");
+}
+
+static void check_params_ext(SharedPtr<nlohmann::json> entry, std::string,
+                             Params params,
+                             Callback<Error, Continuation<Error>> cb, double,
+                             Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(params.port == 3010);
+    REQUIRE(params.duration == 5.0);
+    REQUIRE(params.num_streams == 4);
+    REQUIRE((*entry)["params"]["num_streams"] == 4);
+    cb(MockedError(), nullptr);
+}
+
+TEST_CASE("run() passes the C2S_EXT parameters to the coroutine") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<test_prepare_ext, check_params_ext>(
+        ctx, [](Error err) { REQUIRE(err == ConnectTestConnectionError()); });
+}
+
+static void check_params(SharedPtr<nlohmann::json>, std::string, Params params,
+                         Callback<Error, Continuation<Error>> cb, double,
+                         Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(params.port == 3010);
+    REQUIRE(params.duration == TEST_C2S_DURATION);
+    REQUIRE(params.num_streams == 1);
+    cb(MockedError(), nullptr);
+}
+
+TEST_CASE("run() uses a single stream for plain C2S") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<test_prepare, check_params>(
+        ctx, [](Error err) { REQUIRE(err == ConnectTestConnectionError()); });
+}
+
+static void too_many_streams(SharedPtr<Context>,
+                             Callback<Error, uint8_t, std::string> cb,
+                             SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "3010 5000 0 1000 0 9");
+}
+
+TEST_CASE("run() deals with receiving too many streams") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<too_many_streams>(
+        ctx, [](Error err) { REQUIRE(err == InvalidNumStreamsError()); });
+}
+
+static void connect_but_fail_later(SharedPtr<nlohmann::json>, std::string, Params,
                                    Callback<Error, Continuation<Error>> cb,
                                    double, Settings, SharedPtr<Reactor>,
                                    SharedPtr<Logger>) {
@@ -130,7 +232,7 @@ TEST_CASE("run() deals with coroutine terminating with error") {
         ctx, [](Error err) { REQUIRE(err == MockedError()); });
 }
 
-static void coro_ok(SharedPtr<nlohmann::json>, std::string, int, double,
+static void coro_ok(SharedPtr<nlohmann::json>, std::string, Params,
                     Callback<Error, Continuation<Error>> cb, double, Settings,
                     SharedPtr<Reactor>, SharedPtr<Logger>) {
     cb(NoError(), [](Callback<Error> cb) { cb(NoError()); });
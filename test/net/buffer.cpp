@@ -117,6 +117,40 @@ TEST_CASE("Foreach is robust to corner cases and errors") {
      */
 }
 
+TEST_CASE("Foreach walks buffers with many extents") {
+    Buffer buff;
+    std::string expect;
+
+    /* Adding buffers moves their chains, hence we get many small extents */
+    for (auto i = 0; i < 64; ++i) {
+        Buffer small;
+        small << std::string(7, 'a' + (i % 26));
+        expect += std::string(7, 'a' + (i % 26));
+        buff << small;
+    }
+    REQUIRE(evbuffer_peek(buff.evbuf.get(), -1, nullptr, nullptr, 0) > 16);
+
+    SECTION("We visit all the extents in order") {
+        std::string r;
+        buff.for_each([&](const void *p, size_t n) {
+            r.append((const char *)p, n);
+            return true;
+        });
+        REQUIRE(r == expect);
+    }
+
+    SECTION("We can stop after the first batch of extents") {
+        std::string r;
+        auto counter = 0;
+        buff.for_each([&](const void *p, size_t n) {
+            r.append((const char *)p, n);
+            return ++counter < 20;
+        });
+        REQUIRE(counter == 20);
+        REQUIRE(expect.substr(0, r.length()) == r);
+    }
+}
+
 TEST_CASE("Foreach works correctly") {
 
     Buffer buff;
@@ -464,3 +498,32 @@ TEST_CASE("Write into works correctly") {
         });
     }
 }
+
+TEST_CASE("Write reference shares the bytes rather than copying them") {
+    SharedPtr<std::string> data{std::make_shared<std::string>("foobar")};
+    {
+        Buffer first, second;
+        first.write_reference(data);
+        first.write_reference(data);
+        second.write_reference(data);
+        REQUIRE(data.use_count() == 4);
+        first.for_each([&](const void *p, size_t n) {
+            REQUIRE(p == data->data());
+            REQUIRE(n == data->size());
+            return true;
+        });
+        REQUIRE(first.read(9) == "foobarfoo");
+        REQUIRE(data.use_count() == 3);
+        second >> first;
+        REQUIRE(first.read() == "barfoobar");
+        REQUIRE(data.use_count() == 1);
+        second.write_reference(data);
+    }
+    REQUIRE(data.use_count() == 1);
+
+    SECTION("Writing an empty string is a no-op") {
+        Buffer buff;
+        buff.write_reference(SharedPtr<std::string>{std::make_shared<std::string>()});
+        REQUIRE(buff.length() == 0);
+    }
+}
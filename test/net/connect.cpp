@@ -6,10 +6,13 @@
 
 #include "include/private/catch.hpp"
 
+#include "src/libmeasurement_kit/common/unique_ptr.hpp"
 #include "src/libmeasurement_kit/net/connect_impl.hpp"
 #include "src/libmeasurement_kit/net/error.hpp"
 #include "src/libmeasurement_kit/net/emitter.hpp"
 
+#include "test/bench/listener.hpp"
+
 #include <event2/bufferevent.h>
 
 #include <iostream>
@@ -432,3 +435,47 @@ TEST_CASE("net::connect() works in case of error") {
                 reactor, Logger::make());
     });
 }
+
+TEST_CASE("net::connect() keeps counting a socket until it is closed") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    // Like "max_open_sockets": 1
+    reactor->connection_governor()->set_limits(0, 1);
+    std::vector<SharedPtr<Transport>> accepted;
+    UniquePtr<bench::Listener> listener{new bench::Listener(
+          reactor, Logger::make(),
+          [&](SharedPtr<Transport> txp) { accepted.push_back(txp); })};
+    auto port = listener->port();
+    auto first_closed = false;
+    auto second_connected = false;
+    reactor->run_with_initial_event([&]() {
+        connect("127.0.0.1", port,
+                [&](Error error, SharedPtr<Transport> txp) {
+                    REQUIRE(!error);
+                    // Give the second connect all the time it needs
+                    reactor->call_later(0.5, [&, txp]() {
+                        REQUIRE(!second_connected);
+                        auto stats = reactor->connection_governor()->stats();
+                        REQUIRE(stats.open == 1);
+                        REQUIRE(stats.queued == 1);
+                        first_closed = true;
+                        txp->close([]() {});
+                    });
+                },
+                {}, reactor, Logger::make());
+        connect("127.0.0.1", port,
+                [&](Error error, SharedPtr<Transport> txp) {
+                    REQUIRE(!error);
+                    REQUIRE(first_closed);
+                    second_connected = true;
+                    txp->close([&]() {
+                        listener.reset();
+                        for (auto &t : accepted) {
+                            t->close([]() {});
+                        }
+                        reactor->stop();
+                    });
+                },
+                {}, reactor, Logger::make());
+    });
+    REQUIRE(second_connected);
+}
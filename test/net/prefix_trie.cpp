@@ -0,0 +1,81 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/net/prefix_trie.hpp"
+#include "src/libmeasurement_kit/ooni/whatsapp.hpp"
+
+#include <random>
+
+using namespace mk;
+
+TEST_CASE("PrefixTrie rejects invalid networks") {
+    net::PrefixTrie trie;
+    for (auto s : {"", "/8", "10.0.0.0/", "10.0.0.0/33", "::/129",
+                   "10.0.0.0/-1", "10.0.0.0/8/8", "10.0.0.0/a", "example.com",
+                   "10.0.0/8"}) {
+        INFO(s);
+        REQUIRE(trie.add(s) == ValueError());
+    }
+    REQUIRE(trie.size() == 0);
+    REQUIRE(trie.contains("10.0.0.1") == false);
+}
+
+TEST_CASE("PrefixTrie finds the longest prefix") {
+    net::PrefixTrie trie;
+    REQUIRE(trie.add("10.0.0.0/8") == NoError());
+    REQUIRE(trie.add("10.1.0.0/16") == NoError());
+    REQUIRE(trie.add("10.1.2.3") == NoError());
+    REQUIRE(trie.add("10.1.0.0/16") == NoError()); // Duplicate
+    REQUIRE(trie.add("2a03:2880::/32") == NoError());
+    REQUIRE(trie.size() == 4);
+
+    REQUIRE(trie.longest_prefix("10.2.0.1") == 8);
+    REQUIRE(trie.longest_prefix("10.1.0.1") == 16);
+    REQUIRE(trie.longest_prefix("10.1.2.3") == 32);
+    REQUIRE(trie.longest_prefix("11.0.0.1") == -1);
+    REQUIRE(trie.longest_prefix("2a03:2880:f227::1") == 32);
+    REQUIRE(trie.longest_prefix("2a03:2881::1") == -1);
+    REQUIRE(trie.longest_prefix("::ffff:10.0.0.1") == -1);
+    REQUIRE(trie.longest_prefix("example.com") == -1);
+
+    SECTION("The default route contains all addresses of its family") {
+        REQUIRE(trie.add("0.0.0.0/0") == NoError());
+        REQUIRE(trie.longest_prefix("11.0.0.1") == 0);
+        REQUIRE(trie.longest_prefix("10.1.0.1") == 16);
+        REQUIRE(trie.contains("::1") == false);
+    }
+}
+
+TEST_CASE("PrefixTrie agrees with ooni::ip_in_nets") {
+    std::vector<std::string> nets{
+            "31.13.64.51/32",    "50.22.210.32/30",  "50.22.210.128/27",
+            "108.168.176.192/26", "158.85.58.0/25",  "169.44.36.0/25",
+            "173.193.205.0/27",  "184.173.136.64/27", "2a03:2880:f200::/40",
+            "2a03:2880:f227:c5:face:b00c::167/128"};
+    net::PrefixTrie trie;
+    for (auto &n : nets) {
+        REQUIRE(trie.add(n) == NoError());
+    }
+    std::mt19937 rng{17};
+    for (size_t i = 0; i < 5000; ++i) {
+        // Pick an address near one of the networks, so that some are in
+        std::string base = nets[rng() % nets.size()];
+        base = base.substr(0, base.find('/'));
+        std::string ip;
+        if (base.find(':') == std::string::npos) {
+            size_t last_dot = base.rfind('.');
+            ip = base.substr(0, last_dot + 1) + std::to_string(rng() % 256);
+        } else {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "%x", (unsigned)(rng() % 0x10000));
+            ip = "2a03:2880:f2" + std::string(buf).substr(0, 2) + "::" + buf;
+        }
+        INFO(ip);
+        REQUIRE(trie.contains(ip) == ooni::ip_in_nets(ip, nets));
+    }
+}
@@ -0,0 +1,105 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/nettests/checkpoint.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace mk::nettests;
+using namespace mk;
+
+static const char *path = "./checkpoint_test.njson.checkpoint";
+
+TEST_CASE("Checkpoint::path_for() works") {
+    REQUIRE(Checkpoint::path_for("report.njson.gz") ==
+            "report.njson.gz.checkpoint");
+}
+
+TEST_CASE("Checkpoint works as expected") {
+    (void)std::remove(path);
+
+    SECTION("A missing checkpoint is not resumed") {
+        Checkpoint checkpoint;
+        REQUIRE(!checkpoint.load(path, "web_connectivity", Logger::make()));
+        REQUIRE(!checkpoint.resumed);
+    }
+
+    SECTION("We can resume where we stopped") {
+        {
+            Checkpoint checkpoint;
+            REQUIRE(!checkpoint.load(path, "web_connectivity",
+                                     Logger::make()));
+            checkpoint.report_id = "20180101T000000Z_AS0_antani";
+            checkpoint.seed = 17;
+            REQUIRE(checkpoint.open(path, "web_connectivity", false) ==
+                    NoError());
+            REQUIRE(checkpoint.mark_done(3) == NoError());
+            REQUIRE(checkpoint.mark_done(0) == NoError());
+        }
+        {
+            // Emulate a crash while writing a line
+            std::ofstream file(path, std::ios::app);
+            file << "{\"done\": 1";
+        }
+        {
+            Checkpoint checkpoint;
+            REQUIRE(checkpoint.load(path, "web_connectivity", Logger::make()));
+            REQUIRE(checkpoint.resumed);
+            REQUIRE(checkpoint.report_id == "20180101T000000Z_AS0_antani");
+            REQUIRE(checkpoint.seed == 17);
+            REQUIRE(checkpoint.done_count() == 2);
+            REQUIRE(checkpoint.is_done(0));
+            REQUIRE(!checkpoint.is_done(1));
+            REQUIRE(checkpoint.is_done(3));
+            checkpoint.report_id = "20180102T000000Z_AS0_mascetti";
+            REQUIRE(checkpoint.open(path, "web_connectivity", true) ==
+                    NoError());
+            REQUIRE(checkpoint.mark_done(1) == NoError());
+        }
+        {
+            Checkpoint checkpoint;
+            REQUIRE(checkpoint.load(path, "web_connectivity", Logger::make()));
+            REQUIRE(checkpoint.report_id == "20180102T000000Z_AS0_mascetti");
+            REQUIRE(checkpoint.done_count() == 3);
+            REQUIRE(checkpoint.is_done(1));
+            REQUIRE(checkpoint.open(path, "web_connectivity", false) ==
+                    NoError());
+            REQUIRE(checkpoint.remove() == NoError());
+        }
+        REQUIRE(!std::ifstream(path).good());
+    }
+
+    SECTION("The checkpoint of another test is ignored") {
+        {
+            Checkpoint checkpoint;
+            REQUIRE(checkpoint.open(path, "ndt", false) == NoError());
+            REQUIRE(checkpoint.mark_done(0) == NoError());
+        }
+        Checkpoint checkpoint;
+        REQUIRE(!checkpoint.load(path, "web_connectivity", Logger::make()));
+        REQUIRE(checkpoint.done_count() == 0);
+    }
+
+    SECTION("A checkpoint without header is ignored") {
+        {
+            std::ofstream file(path);
+            file << "{\"done\": 0}\n";
+        }
+        Checkpoint checkpoint;
+        REQUIRE(!checkpoint.load(path, "web_connectivity", Logger::make()));
+        REQUIRE(checkpoint.done_count() == 0);
+    }
+
+    SECTION("We cannot write before opening") {
+        Checkpoint checkpoint;
+        REQUIRE(checkpoint.mark_done(0) == FileIoError());
+    }
+
+    (void)std::remove(path);
+}
@@ -0,0 +1,93 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/nettests/concurrency.hpp"
+
+using namespace mk::nettests;
+
+TEST_CASE("ConcurrencyController clamps the initial parallelism") {
+    REQUIRE(ConcurrencyController(3, 1, 3, 1).limit() == 3);
+    REQUIRE(ConcurrencyController(8, 1, 3, 1).limit() == 3);
+    REQUIRE(ConcurrencyController(1, 2, 3, 1).limit() == 2);
+    REQUIRE(ConcurrencyController(0, 0, 0, 1).limit() == 1);
+}
+
+TEST_CASE("ConcurrencyController follows an AIMD policy") {
+    ConcurrencyController cc(2, 1, 4, 0);
+    auto run = [&](bool timed_out) {
+        REQUIRE(cc.can_start());
+        cc.started("");
+        return cc.completed("", timed_out);
+    };
+
+    SECTION("The limit grows by one after a limit's worth of successes") {
+        REQUIRE(!run(false));
+        REQUIRE(run(false));
+        REQUIRE(cc.limit() == 3);
+        REQUIRE(!run(false));
+        REQUIRE(!run(false));
+        REQUIRE(run(false));
+        REQUIRE(cc.limit() == 4);
+        for (int i = 0; i < 16; ++i) {
+            REQUIRE(!run(false)); // Never above the maximum
+        }
+        REQUIRE(cc.limit() == 4);
+    }
+
+    SECTION("The limit is halved on timeout but not below the minimum") {
+        REQUIRE(run(true));
+        REQUIRE(cc.limit() == 1);
+        REQUIRE(!run(true));
+        REQUIRE(cc.limit() == 1);
+    }
+
+    SECTION("We ignore the timeouts of measurements already in flight") {
+        ConcurrencyController cc(4, 1, 4, 0);
+        for (int i = 0; i < 4; ++i) {
+            cc.started("");
+        }
+        REQUIRE(!cc.can_start());
+        REQUIRE(cc.completed("", true));
+        REQUIRE(cc.limit() == 2);
+        REQUIRE(!cc.completed("", true));
+        REQUIRE(!cc.completed("", true));
+        REQUIRE(!cc.completed("", true));
+        REQUIRE(cc.limit() == 2);
+        REQUIRE(cc.in_flight() == 0);
+    }
+}
+
+TEST_CASE("ConcurrencyController limits measurements per host") {
+    ConcurrencyController cc(3, 1, 3, 1);
+    REQUIRE(cc.can_start("a.org"));
+    cc.started("a.org");
+    REQUIRE(!cc.can_start("a.org"));
+    REQUIRE(cc.can_start("b.org"));
+    REQUIRE(cc.can_start("")); // No input means no host
+    cc.completed("a.org", false);
+    REQUIRE(cc.can_start("a.org"));
+}
+
+TEST_CASE("input_host() works as expected") {
+    REQUIRE(input_host("") == "");
+    REQUIRE(input_host("http://www.x.org/robots.txt") == "www.x.org");
+    REQUIRE(input_host("https://www.x.org:8443/") == "www.x.org");
+    REQUIRE(input_host("1.2.3.4:80") == "1.2.3.4");
+    REQUIRE(input_host("[::1]:443") == "::1");
+    REQUIRE(input_host("www.x.org") == "www.x.org");
+}
+
+TEST_CASE("measurement_timed_out() works as expected") {
+    REQUIRE(!measurement_timed_out(nullptr));
+    REQUIRE(!measurement_timed_out({{"failure", nullptr}}));
+    REQUIRE(!measurement_timed_out({{"failure", "connection_refused"}}));
+    REQUIRE(measurement_timed_out({{"failure", "generic_timeout_error"}}));
+    REQUIRE(measurement_timed_out(
+        {{"http_experiment_failure", "generic_timeout_error"}}));
+    REQUIRE(!measurement_timed_out({{"timeouts", "generic_timeout_error"}}));
+}
@@ -0,0 +1,123 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
+#include "src/libmeasurement_kit/ooni/error.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+using namespace mk::nettests;
+using namespace mk;
+
+static const char *urls = "./test/fixtures/urls.txt";
+
+static std::vector<std::string> read_urls() {
+    std::vector<std::string> result;
+    std::ifstream file(urls);
+    std::string line;
+    while (std::getline(file, line)) {
+        result.push_back(line);
+    }
+    return result;
+}
+
+static std::vector<std::string> drain(InputSource &source) {
+    std::vector<std::string> result;
+    std::string input;
+    while (source.next(input)) {
+        result.push_back(input);
+        REQUIRE(source.estimated_total() >= result.size());
+    }
+    return result;
+}
+
+TEST_CASE("InputSource works as expected") {
+    std::deque<std::string> inputs;
+    InputSource source;
+
+    SECTION("When input is not required, just a single entry is returned") {
+        inputs = {"antani", "mascetti"};
+        REQUIRE(source.open(inputs, false, {urls}, "IT", {},
+                            Logger::make()) == NoError());
+        REQUIRE(drain(source) == std::vector<std::string>{""});
+    }
+
+    SECTION("When input is required but there are no input files") {
+        REQUIRE(source.open(inputs, true, {}, "IT", {}, Logger::make()) ==
+                ooni::MissingRequiredInputFileError());
+    }
+
+    SECTION("When no input file can be read") {
+        REQUIRE(source.open(inputs, true, {"/nonexistent"}, "IT", {},
+                            Logger::make()) ==
+                ooni::CannotReadAnyInputFileError());
+    }
+
+    SECTION("When the randomize_input option is invalid") {
+        REQUIRE(source.open(inputs, true, {urls}, "IT",
+                            {{"randomize_input", "antani"}},
+                            Logger::make()) == ValueError());
+    }
+
+    SECTION("Inputs are read in order when not randomizing") {
+        inputs = {"antani"};
+        REQUIRE(source.open(inputs, true, {"/nonexistent", urls}, "IT",
+                            {{"randomize_input", false}},
+                            Logger::make()) == NoError());
+        REQUIRE(inputs.size() == 0);
+        std::vector<std::string> expect = read_urls();
+        expect.insert(expect.begin(), "antani");
+        REQUIRE(drain(source) == expect);
+        REQUIRE(source.estimated_total() == expect.size());
+    }
+
+    SECTION("Inputs are shuffled using a bounded window") {
+        source.shuffle_window = 3;
+        REQUIRE(source.open(inputs, true, {urls, urls}, "IT", {},
+                            Logger::make()) == NoError());
+        std::vector<std::string> expect = read_urls();
+        std::vector<std::string> once = expect;
+        expect.insert(expect.end(), once.begin(), once.end());
+        std::vector<std::string> result = drain(source);
+        REQUIRE(source.estimated_total() == expect.size());
+        std::sort(expect.begin(), expect.end());
+        std::sort(result.begin(), result.end());
+        REQUIRE(result == expect);
+    }
+}
+
+TEST_CASE("InputSource yields the same order given the same seed") {
+    std::vector<std::string> orders[2];
+    for (auto &order : orders) {
+        std::deque<std::string> inputs;
+        InputSource source;
+        source.shuffle_window = 3;
+        source.set_seed(17);
+        REQUIRE(source.open(inputs, true, {urls, urls}, "IT", {},
+                            Logger::make()) == NoError());
+        REQUIRE(source.seed() == 17);
+        order = drain(source);
+    }
+    REQUIRE(orders[0] == orders[1]);
+}
+
+TEST_CASE("InputSource shuffles small lists like before") {
+    std::vector<std::string> expect = read_urls();
+    for (int count = 0; count < 8; ++count) {
+        std::deque<std::string> inputs;
+        InputSource source;
+        REQUIRE(source.open(inputs, true, {urls}, "IT", {}, Logger::make()) ==
+                NoError());
+        if (drain(source) != expect) {
+            return;
+        }
+    }
+    REQUIRE(false);
+}
@@ -9,6 +9,8 @@
 #include <measurement_kit/common/nlohmann/json.hpp>
 #include <measurement_kit/ffi.h>
 
+#include <set>
+
 //#include <iostream>  // to debug
 
 // TODO(bassosimone): compare options here with with_runnable ones
@@ -239,3 +241,46 @@ TEST_CASE("Make sure that 'randomize_input' works") {
         REQUIRE(repeat(false, 8) == 9);
     }
 }
+
+TEST_CASE("Make sure that 'shards' merges entries into a single report") {
+    nlohmann::json inputs;
+    for (int port = 1; port <= 16; ++port) {
+        inputs.push_back("127.0.0.1:" + std::to_string(port));
+    }
+    nlohmann::json settings{
+            {"name", "TcpConnect"},
+            {"inputs", inputs},
+            {"options", {
+                                {"max_parallelism_per_host", 0},
+                                {"no_bouncer", true},
+                                {"no_collector", true},
+                                {"no_file_report", true},
+                                {"no_geoip", true},
+                                {"no_resolver_lookup", true},
+                                {"parallelism", 6},
+                                {"shards", 3},
+                        }}};
+    mk_unique_task task{mk_task_start(settings.dump().c_str())};
+    REQUIRE(!!task);
+    std::set<uint64_t> indexes;
+    std::set<std::string> measured;
+    while (!mk_task_is_done(task.get())) {
+        mk_unique_event event{mk_task_wait_for_next_event(task.get())};
+        REQUIRE(!!event);
+        auto s = mk_event_serialization(event.get());
+        REQUIRE(!!s);
+        auto doc = nlohmann::json::parse(s);
+        if (doc.at("key") != "measurement") {
+            continue;
+        }
+        REQUIRE(indexes.insert(doc.at("value").at("idx").get<uint64_t>())
+                        .second);
+        auto entry = nlohmann::json::parse(
+                doc.at("value").at("json_str").get<std::string>());
+        REQUIRE((entry.at("test_name") == "tcp_connect"));
+        measured.insert(entry.at("input").get<std::string>());
+    }
+    REQUIRE(indexes.size() == inputs.size());
+    REQUIRE(*indexes.rbegin() == inputs.size() - 1);
+    REQUIRE(measured.size() == inputs.size());
+}
@@ -69,4 +69,13 @@ TEST_CASE("Whatsapp and related utility functions") {
         REQUIRE(!!result);
         REQUIRE(result.as_value() == false);
     }
+
+    SECTION("can tell if an ip is within the whatsapp networks") {
+        REQUIRE(mk::ooni::ip_in_whatsapp_nets("31.13.64.51") == true);
+        REQUIRE(mk::ooni::ip_in_whatsapp_nets("31.13.64.52") == false);
+        REQUIRE(mk::ooni::ip_in_whatsapp_nets(
+                        "2a03:2880:f227:c5:face:b00c::167") == true);
+        REQUIRE(mk::ooni::ip_in_whatsapp_nets("2a03:2880::1") == false);
+        REQUIRE(mk::ooni::ip_in_whatsapp_nets("example.com") == false);
+    }
 }
@@ -6,12 +6,17 @@
 
 #include "include/private/catch.hpp"
 
+#include "src/libmeasurement_kit/common/file_writer.hpp"
 #include "src/libmeasurement_kit/net/emitter.hpp"
 #include "src/libmeasurement_kit/ooni/collector_client_impl.hpp"
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
 #include "src/libmeasurement_kit/common/non_movable.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <limits>
 #include <sstream>
+#include <vector>
 
 using namespace mk::http;
 using namespace mk::net;
@@ -129,6 +134,29 @@ TEST_CASE("collector::post deals with unexpected response") {
     });
 }
 
+static void four_hundred_four(SharedPtr<Transport>, Settings, Headers,
+                              std::string,
+                              Callback<Error, SharedPtr<Response>> cb,
+                              SharedPtr<Reactor>, SharedPtr<Logger>) {
+    SharedPtr<Response> resp(new Response);
+    resp->status_code = 404;
+    cb(NoError(), resp);
+}
+
+TEST_CASE("collector::post deals with a closed report") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        collector::post_impl<four_hundred_four>(
+        nullptr, "/report/rid", "",
+        [=](Error err, nlohmann::json r) {
+            REQUIRE(err == CollectorReportNotFoundError());
+            REQUIRE(r == nullptr);
+            reactor->stop();
+        },
+        SETTINGS, reactor, Logger::make());
+    });
+}
+
 static void empty(SharedPtr<Transport>, Settings, Headers, std::string,
                   Callback<Error, SharedPtr<Response>> cb, SharedPtr<Reactor>,
                   SharedPtr<Logger>) {
@@ -337,6 +365,94 @@ TEST_CASE("collector::update_report deals with entry with missing key") {
     });
 }
 
+static std::string posted_body;
+
+static void record_body(SharedPtr<Transport>, std::string, std::string body,
+                        Callback<Error, nlohmann::json> cb, Settings,
+                        SharedPtr<Reactor>, SharedPtr<Logger>) {
+    posted_body = body;
+    cb(NoError(), nullptr);
+}
+
+static nlohmann::json update_report_raw(std::string entry, Error expected,
+                                        Settings settings = {}) {
+    posted_body = "";
+    collector::update_report_raw_impl<record_body>(
+        nullptr, "rid", entry,
+        [=](Error err) { REQUIRE(err == expected); }, settings,
+        Reactor::make(), Logger::make());
+    if (expected) {
+        REQUIRE(posted_body == "");
+        return nullptr;
+    }
+    return nlohmann::json::parse(posted_body);
+}
+
+TEST_CASE("collector::update_report_raw() works as expected") {
+    nlohmann::json entry = ENTRY;
+    nlohmann::json expected = ENTRY;
+    expected["report_id"] = "rid";
+
+    SECTION("When the entry has a report_id") {
+        entry["report_id"] = "xo";
+        auto body = update_report_raw(entry.dump() + "\r", NoError());
+        REQUIRE((body == nlohmann::json{
+            {"format", "json"}, {"content", entry}}));
+    }
+
+    SECTION("When the entry does not have a report_id") {
+        auto body = update_report_raw(entry.dump(), NoError());
+        REQUIRE((body["content"] == expected));
+    }
+
+    SECTION("When only nested keys and strings look like a report_id") {
+        entry["input"] = "\"report_id\":\"xo\"";
+        entry["test_keys"]["report_id"] = "xo";
+        expected["input"] = entry["input"];
+        expected["test_keys"]["report_id"] = "xo";
+        auto body = update_report_raw(entry.dump(), NoError());
+        REQUIRE((body["content"] == expected));
+    }
+
+    SECTION("When the report_id is null") {
+        entry["report_id"] = nullptr;
+        auto body = update_report_raw(entry.dump(), NoError());
+        REQUIRE((body["content"] == expected));
+    }
+
+    SECTION("When the report_id is empty") {
+        entry["report_id"] = "";
+        auto body = update_report_raw(entry.dump(), NoError());
+        REQUIRE((body["content"] == expected));
+    }
+
+    SECTION("When the report_id is stale and we replace it") {
+        entry["report_id"] = "xo";
+        auto body = update_report_raw(entry.dump(), NoError(),
+                                      {{"collector/replace_report_id", true}});
+        REQUIRE((body["content"] == expected));
+    }
+
+    SECTION("When the report_id is current and we replace it") {
+        entry["report_id"] = "rid";
+        auto body = update_report_raw(entry.dump() + "\r", NoError(),
+                                      {{"collector/replace_report_id", true}});
+        REQUIRE((body == nlohmann::json{
+            {"format", "json"}, {"content", entry}}));
+    }
+
+    SECTION("When the entry is not valid") {
+        update_report_raw("{}", MissingMandatoryKeyError());
+        update_report_raw(BAD_ENTRY.dump(), InvalidMandatoryValueError());
+    }
+
+    SECTION("When the entry is not an object") {
+        update_report_raw("[]", JsonProcessingError());
+        update_report_raw("", JsonProcessingError());
+        update_report_raw(entry.dump() + "}", JsonProcessingError());
+    }
+}
+
 TEST_CASE("collector::get_next_entry() works correctly at EOF") {
     SharedPtr<std::istream> input(new std::istringstream(""));
     ErrorOr<nlohmann::json> entry = collector::get_next_entry(input, Logger::make());
@@ -371,16 +487,24 @@ static void fail(SharedPtr<Transport>, std::string, nlohmann::json, Callback<Err
     cb(MockedError());
 }
 
+static SharedPtr<collector::SubmitContext> make_submit_context(Callback<Error> cb) {
+    SharedPtr<collector::SubmitContext> ctx{
+        std::make_shared<collector::SubmitContext>()};
+    ctx->active = 1;
+    ctx->callback = cb;
+    return ctx;
+}
+
 TEST_CASE("update_and_fetch_next() deals with update_report error") {
     SharedPtr<Reactor> reactor = Reactor::make();
     reactor->run_with_initial_event([=]() {
+        auto ctx = make_submit_context([=](Error err) {
+            REQUIRE(err == MockedError());
+            reactor->stop();
+        });
         collector::update_and_fetch_next_impl<fail>(
-            nullptr, MockConnection::make(reactor), "", 1, {},
-            [=](Error err) {
-                REQUIRE(err == MockedError());
-                reactor->stop();
-            },
-            {}, reactor, Logger::make());
+            ctx, MockConnection::make(reactor), 1, {}, "", {}, reactor,
+            Logger::make());
     });
 }
 
@@ -396,13 +520,13 @@ static ErrorOr<nlohmann::json> fail(SharedPtr<std::istream>, SharedPtr<Logger>)
 TEST_CASE("update_and_fetch_next() deals with get_next_entry error") {
     SharedPtr<Reactor> reactor = Reactor::make();
     reactor->run_with_initial_event([=]() {
+        auto ctx = make_submit_context([=](Error err) {
+            REQUIRE(err == MockedError());
+            reactor->stop();
+        });
         collector::update_and_fetch_next_impl<success, fail>(
-            nullptr, MockConnection::make(reactor), "", 1, {},
-            [=](Error err) {
-                REQUIRE(err == MockedError());
-                reactor->stop();
-            },
-            {}, reactor, Logger::make());
+            ctx, MockConnection::make(reactor), 1, {}, "", {}, reactor,
+            Logger::make());
     });
 }
 
@@ -477,6 +601,259 @@ TEST_CASE("submit_report() deals with collector_create_report error") {
     });
 }
 
+static void success(SharedPtr<Transport>, nlohmann::json, Callback<Error, std::string> cb,
+                    Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    cb(NoError(), "20170101T000000Z_AS0_deadbeef");
+}
+
+static int num_closes = 0;
+
+static void success(SharedPtr<Transport>, std::string, Callback<Error> cb,
+                    Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    num_closes += 1;
+    cb(NoError());
+}
+
+static int inflight = 0;
+static int max_inflight = 0;
+static int num_updates = 0;
+static int fail_update_after = -1;
+
+static void slow(SharedPtr<Transport>, std::string, nlohmann::json, Callback<Error> cb,
+                 Settings, SharedPtr<Reactor> reactor, SharedPtr<Logger>) {
+    if (num_updates == fail_update_after) {
+        cb(MockedError());
+        return;
+    }
+    max_inflight = std::max(max_inflight, ++inflight);
+    // Use different delays so that entries are acknowledged out of order
+    double delay = 0.01 * (num_updates++ % 3);
+    reactor->call_later(delay, [=]() {
+        --inflight;
+        cb(NoError());
+    });
+}
+
+static std::vector<std::string> raw_entries;
+
+static void slow(SharedPtr<Transport> txp, std::string rid, std::string entry,
+                 Callback<Error> cb, Settings settings,
+                 SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    raw_entries.push_back(entry);
+    slow(txp, rid, nlohmann::json{}, cb, settings, reactor, logger);
+}
+
+static void reset_submit_counters() {
+    raw_entries.clear();
+    num_closes = 0;
+    inflight = 0;
+    max_inflight = 0;
+    num_updates = 0;
+    fail_update_after = -1;
+}
+
+static void run_submit_report(Settings settings, Error expected_error,
+                              std::vector<int> &acked,
+                              std::string path = "test/fixtures/report.njson") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Logger> logger = Logger::make();
+    logger->on_event_ex("status.report_submit", [&](nlohmann::json &&ev) {
+        acked.push_back(ev.at("value").at("acked_entries").get<int>());
+    });
+    reactor->run_with_initial_event([&]() {
+        collector::submit_report_impl<collector::get_next_entry, success,
+                                      success, slow, success, slow>(
+            path, "", "",
+            [=](Error err) {
+                REQUIRE(err == expected_error);
+                reactor->stop();
+            },
+            settings, reactor, logger);
+    });
+}
+
+TEST_CASE("submit_report() keeps many entries in flight") {
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/max_inflight_entries"] = 4;
+    std::vector<int> acked;
+    run_submit_report(settings, NoError(), acked);
+    REQUIRE(num_updates == 9);
+    REQUIRE(max_inflight == 4);
+    REQUIRE(num_closes == 1);
+    REQUIRE(acked.size() > 0);
+    REQUIRE(acked.back() == 9);
+    REQUIRE(std::is_sorted(acked.begin(), acked.end()));
+}
+
+TEST_CASE("submit_report() reports acknowledged entries on failure") {
+    reset_submit_counters();
+    fail_update_after = 5;
+    std::vector<int> acked;
+    run_submit_report({}, MockedError(), acked);
+    REQUIRE(max_inflight == 1);
+    REQUIRE(num_closes == 0);
+    REQUIRE((acked == std::vector<int>{1, 2, 3, 4, 5}));
+}
+
+TEST_CASE("submit_report() resumes a report") {
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/max_inflight_entries"] = 2;
+    settings["collector/report_id"] = "20170101T000000Z_AS0_deadbeef";
+    settings["collector/acked_entries"] = 6;
+    std::vector<int> acked;
+    run_submit_report(settings, NoError(), acked);
+    REQUIRE(num_updates == 3);
+    REQUIRE(num_closes == 1);
+    REQUIRE(acked.back() == 9);
+}
+
+TEST_CASE("submit_report() resumes a report from an offset") {
+    reset_submit_counters();
+    std::ifstream file("test/fixtures/report.njson");
+    for (int i = 0; i < 6; ++i) {
+        file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    int64_t offset = (int64_t)file.tellg();
+    file.seekg(0, std::ios::end);
+    int64_t size = (int64_t)file.tellg();
+    Settings settings;
+    settings["collector/raw_entries"] = true;
+    settings["collector/report_id"] = "20170101T000000Z_AS0_deadbeef";
+    settings["collector/acked_entries"] = 6;
+    settings["collector/acked_offset"] = offset;
+    std::vector<int> acked;
+    std::vector<int64_t> offsets;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Logger> logger = Logger::make();
+    logger->on_event_ex("status.report_submit", [&](nlohmann::json &&ev) {
+        acked.push_back(ev.at("value").at("acked_entries").get<int>());
+        offsets.push_back(ev.at("value").at("acked_offset").get<int64_t>());
+    });
+    reactor->run_with_initial_event([&]() {
+        collector::submit_report_impl<collector::get_next_entry, success,
+                                      success, slow, success, slow>(
+            "test/fixtures/report.njson", "", "",
+            [=](Error err) {
+                REQUIRE(err == NoError());
+                reactor->stop();
+            },
+            settings, reactor, logger);
+    });
+    REQUIRE(num_updates == 3);
+    REQUIRE(num_closes == 1);
+    REQUIRE((acked == std::vector<int>{7, 8, 9}));
+    REQUIRE(offsets.back() == size);
+    REQUIRE(std::is_sorted(offsets.begin(), offsets.end()));
+    REQUIRE(offsets.front() > offset);
+    // The first entry to send is the one following the offset
+    std::string line;
+    file.clear();
+    file.seekg(offset);
+    REQUIRE(!!std::getline(file, line));
+    REQUIRE(raw_entries.size() == 3);
+    REQUIRE(raw_entries[0] == line);
+}
+
+TEST_CASE("submit_report() moves the remaining entries into a new report") {
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/raw_entries"] = true;
+    settings["collector/acked_entries"] = 6;
+    std::vector<int> acked;
+    run_submit_report(settings, NoError(), acked);
+    REQUIRE(num_updates == 3);
+    REQUIRE(num_closes == 1);
+    REQUIRE((acked == std::vector<int>{7, 8, 9}));
+    std::ifstream file("test/fixtures/report.njson");
+    std::string line;
+    for (int i = 0; i < 7; ++i) {
+        REQUIRE(!!std::getline(file, line));
+    }
+    REQUIRE(raw_entries.size() == 3);
+    REQUIRE(raw_entries[0] == line);
+}
+
+TEST_CASE("submit_report() can send the lines of the file as they are") {
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/raw_entries"] = true;
+    std::vector<int> acked;
+    run_submit_report(settings, NoError(), acked);
+    REQUIRE(num_updates == 9);
+    REQUIRE(num_closes == 1);
+    REQUIRE(raw_entries.size() == 9);
+    std::ifstream file("test/fixtures/report.njson");
+    std::string line;
+    for (auto &entry : raw_entries) {
+        REQUIRE(!!std::getline(file, line));
+        REQUIRE(entry == line);
+    }
+}
+
+#ifndef MK_WITHOUT_ZLIB
+
+TEST_CASE("submit_report() reads gzip compressed reports") {
+    static const char *gz_path = "collector_client.njson.gz";
+    {
+        FileWriter writer;
+        writer.gzip = true;
+        writer.flush_every = 4;
+        REQUIRE(writer.open(gz_path) == NoError());
+        std::ifstream file("test/fixtures/report.njson");
+        std::string line;
+        while (std::getline(file, line)) {
+            writer << line << "\n";
+            REQUIRE(writer.end_record() == NoError());
+        }
+    }
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/raw_entries"] = true;
+    std::vector<int> acked;
+
+    SECTION("When the file is complete") {
+        run_submit_report(settings, NoError(), acked, gz_path);
+        REQUIRE(num_updates == 9);
+        REQUIRE(num_closes == 1);
+        REQUIRE(acked.back() == 9);
+    }
+
+    SECTION("When the last gzip member is truncated") {
+        std::string data;
+        {
+            std::ifstream file(gz_path, std::ios::binary);
+            std::stringstream ss;
+            ss << file.rdbuf();
+            data = ss.str();
+        }
+        // Keep just the beginning of the member containing the last entry
+        size_t last_member = data.rfind("\x1f\x8b\x08");
+        REQUIRE(last_member != std::string::npos);
+        REQUIRE(last_member > 0);
+        {
+            std::ofstream file(gz_path, std::ios::binary);
+            file.write(data.data(), (std::streamsize)last_member + 30);
+        }
+        run_submit_report(settings, NoError(), acked, gz_path);
+        REQUIRE(num_updates == 8);
+        REQUIRE(num_closes == 1);
+        REQUIRE(acked.back() == 8);
+    }
+}
+
+#endif
+
+TEST_CASE("submit_report() deals with invalid max_inflight_entries") {
+    reset_submit_counters();
+    Settings settings;
+    settings["collector/max_inflight_entries"] = 0;
+    std::vector<int> acked;
+    run_submit_report(settings, ValueError(), acked);
+    REQUIRE(num_updates == 0);
+}
+
 /*
  _       _                       _   _
 (_)_ __ | |_ ___  __ _ _ __ __ _| |_(_) ___  _ __
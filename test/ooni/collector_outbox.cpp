@@ -0,0 +1,243 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/ooni/collector_outbox_impl.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace mk::ooni;
+using namespace mk;
+
+static const char *dir = ".";
+
+static void clear_outbox() {
+    ErrorOr<nlohmann::json> index = collector::outbox_read_index(dir);
+    REQUIRE(!!index);
+    for (auto it = index->begin(); it != index->end(); ++it) {
+        REQUIRE(collector::outbox_remove(dir, it.key()) == NoError());
+    }
+}
+
+static std::string read_file(std::string path) {
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE("outbox_append() saves entries and the index") {
+    clear_outbox();
+    SharedPtr<Logger> logger = Logger::make();
+    REQUIRE(collector::outbox_append(dir, "foo", "", R"({"input":"a"})",
+                                     logger) == NoError());
+    REQUIRE(collector::outbox_append(dir, "foo", "", R"({"input":"b"})",
+                                     logger) == NoError());
+    REQUIRE(collector::outbox_append(dir, "bar", "rid", R"({"input":"c"})",
+                                     logger) == NoError());
+    REQUIRE(read_file(collector::outbox_path(dir, "foo")) ==
+            "{\"input\":\"a\"}\n{\"input\":\"b\"}\n");
+    REQUIRE(read_file(collector::outbox_path(dir, "bar")) ==
+            "{\"input\":\"c\"}\n");
+    ErrorOr<nlohmann::json> index = collector::outbox_read_index(dir);
+    REQUIRE(!!index);
+    REQUIRE(index->size() == 2);
+    REQUIRE((*index)["foo"]["report_id"] == "");
+    REQUIRE((*index)["bar"]["report_id"] == "rid");
+    REQUIRE((*index)["bar"]["acked_entries"] == 0);
+    clear_outbox();
+    REQUIRE(collector::outbox_read_index(dir)->size() == 0);
+    std::ifstream file(collector::outbox_path(dir, "foo"));
+    REQUIRE(!file.good());
+}
+
+TEST_CASE("outbox_read_index() deals with a corrupt index") {
+    clear_outbox();
+    {
+        std::ofstream file("./outbox.json");
+        file << "[]\n";
+    }
+    REQUIRE(collector::outbox_read_index(dir).as_error() ==
+            JsonProcessingError());
+    {
+        std::ofstream file("./outbox.json");
+        file << "{\n";
+    }
+    REQUIRE(collector::outbox_read_index(dir).as_error() ==
+            JsonProcessingError());
+    REQUIRE(std::remove("./outbox.json") == 0);
+}
+
+static std::vector<Settings> submitted;
+static Error submit_error;
+
+static void submit(std::string filepath, std::string, std::string,
+                   Callback<Error> cb, Settings settings,
+                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    REQUIRE(filepath == collector::outbox_path(dir, "foo"));
+    submitted.push_back(settings);
+    logger->emit_event_ex("status.report_submit", {
+        {"report_id", "rid"},
+        {"acked_entries", 1},
+        {"acked_offset", 14},
+    });
+    reactor->call_soon([=]() { cb(submit_error); });
+}
+
+static void run_outbox_submit(Error expected_error) {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Logger> logger = Logger::make();
+    int events = 0;
+    logger->on_event_ex("status.report_submit", [&](nlohmann::json &&) {
+        events += 1;
+    });
+    reactor->run_with_initial_event([&]() {
+        collector::outbox_submit_impl<submit>(
+            dir, "https://collector.example.com",
+            [=](Error err) {
+                REQUIRE(err == expected_error);
+                reactor->stop();
+            },
+            {}, reactor, logger);
+    });
+    REQUIRE(events == 1);
+}
+
+TEST_CASE("outbox_submit() resumes from where it stopped") {
+    clear_outbox();
+    SharedPtr<Logger> logger = Logger::make();
+    REQUIRE(collector::outbox_append(dir, "foo", "", R"({"input":"a"})",
+                                     logger) == NoError());
+    REQUIRE(collector::outbox_append(dir, "foo", "", R"({"input":"b"})",
+                                     logger) == NoError());
+    submitted.clear();
+
+    submit_error = MockedError();
+    run_outbox_submit(MockedError());
+    REQUIRE(submitted.size() == 1);
+    REQUIRE(submitted[0].count("collector/report_id") == 0);
+    REQUIRE(submitted[0].get("collector/raw_entries", false) == true);
+    ErrorOr<nlohmann::json> index = collector::outbox_read_index(dir);
+    REQUIRE(!!index);
+    REQUIRE((*index)["foo"]["report_id"] == "rid");
+    REQUIRE((*index)["foo"]["acked_entries"] == 1);
+    REQUIRE((*index)["foo"]["acked_offset"] == 14);
+
+    submit_error = NoError();
+    run_outbox_submit(NoError());
+    REQUIRE(submitted.size() == 2);
+    REQUIRE(submitted[1].get("collector/report_id", std::string{}) == "rid");
+    REQUIRE(submitted[1].get("collector/acked_entries", 0) == 1);
+    REQUIRE(submitted[1].get("collector/acked_offset", (int64_t)0) == 14);
+    REQUIRE(collector::outbox_read_index(dir)->size() == 0);
+    std::ifstream file(collector::outbox_path(dir, "foo"));
+    REQUIRE(!file.good());
+}
+
+TEST_CASE("outbox_submit() removes empty new reports") {
+    clear_outbox();
+    REQUIRE(collector::outbox_write_index(dir, {{"foo", {
+        {"report_id", ""},
+        {"acked_entries", 0},
+        {"acked_offset", 0},
+    }}}) == NoError());
+    submitted.clear();
+    submit_error = FileEofError();
+    run_outbox_submit(NoError());
+    REQUIRE(submitted.size() == 1);
+    REQUIRE(collector::outbox_read_index(dir)->size() == 0);
+}
+
+static void submit_to_closed_report(std::string, std::string, std::string,
+                                    Callback<Error> cb, Settings settings,
+                                    SharedPtr<Reactor> reactor,
+                                    SharedPtr<Logger> logger) {
+    submitted.push_back(settings);
+    if (settings.get("collector/report_id", std::string{}) == "rid") {
+        reactor->call_soon([=]() { cb(CollectorReportNotFoundError()); });
+        return;
+    }
+    logger->emit_event_ex("status.report_submit", {
+        {"report_id", "rid2"},
+        {"acked_entries", 2},
+        {"acked_offset", 28},
+    });
+    reactor->call_soon([=]() { cb(NoError()); });
+}
+
+template <collector::SubmitReport *submit_report>
+static void run_outbox_submit_with(Settings settings, Error expected_error) {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        collector::outbox_submit_impl<submit_report>(
+            dir, "https://collector.example.com",
+            [=](Error err) {
+                REQUIRE(err == expected_error);
+                reactor->stop();
+            },
+            settings, reactor, Logger::make());
+    });
+}
+
+TEST_CASE("outbox_submit() opens a new report if the collector closed it") {
+    clear_outbox();
+    SharedPtr<Logger> logger = Logger::make();
+    REQUIRE(collector::outbox_append(dir, "foo", "rid", R"({"input":"a"})",
+                                     logger) == NoError());
+    REQUIRE(collector::outbox_append(dir, "foo", "rid", R"({"input":"b"})",
+                                     logger) == NoError());
+    REQUIRE(collector::outbox_update_index(dir, "foo", {
+        {"report_id", "rid"},
+        {"acked_entries", 1},
+        {"acked_offset", 14},
+    }) == NoError());
+    submitted.clear();
+    run_outbox_submit_with<submit_to_closed_report>({}, NoError());
+    REQUIRE(submitted.size() == 2);
+    REQUIRE(submitted[0].get("collector/report_id", std::string{}) == "rid");
+    // We continue from the last acknowledged entry, using a new report
+    REQUIRE(submitted[1].count("collector/report_id") == 0);
+    REQUIRE(submitted[1].get("collector/acked_entries", 0) == 1);
+    REQUIRE(submitted[1].get("collector/acked_offset", (int64_t)0) == 14);
+    REQUIRE(submitted[1].get("collector/replace_report_id", false) == true);
+    REQUIRE(collector::outbox_read_index(dir)->size() == 0);
+}
+
+static void submit_rejected(std::string, std::string, std::string,
+                            Callback<Error> cb, Settings settings,
+                            SharedPtr<Reactor> reactor, SharedPtr<Logger>) {
+    submitted.push_back(settings);
+    reactor->call_soon([=]() { cb(submit_error); });
+}
+
+TEST_CASE("outbox_submit() drops reports that the collector keeps rejecting") {
+    clear_outbox();
+    SharedPtr<Logger> logger = Logger::make();
+    REQUIRE(collector::outbox_append(dir, "foo", "rid", R"({"input":"a"})",
+                                     logger) == NoError());
+    submitted.clear();
+    Settings settings{{"collector/outbox_max_failures", 2}};
+
+    // Network errors do not tell anything about the report
+    submit_error = MockedError();
+    run_outbox_submit_with<submit_rejected>(settings, MockedError());
+    run_outbox_submit_with<submit_rejected>(settings, MockedError());
+    REQUIRE((*collector::outbox_read_index(dir))["foo"]["failures"] == 0);
+
+    submit_error = http::HttpRequestFailedError();
+    run_outbox_submit_with<submit_rejected>(settings,
+                                            http::HttpRequestFailedError());
+    REQUIRE((*collector::outbox_read_index(dir))["foo"]["failures"] == 1);
+    run_outbox_submit_with<submit_rejected>(settings,
+                                            http::HttpRequestFailedError());
+    REQUIRE(submitted.size() == 4);
+    REQUIRE(collector::outbox_read_index(dir)->size() == 0);
+    std::ifstream file(collector::outbox_path(dir, "foo"));
+    REQUIRE(!file.good());
+}
@@ -0,0 +1,184 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/ooni/control_batcher.hpp"
+#include "src/libmeasurement_kit/ooni/nettests.hpp"
+
+using namespace mk;
+
+static size_t helper_calls = 0;
+
+// Stand-in for a test helper supporting batches, which pretends that every
+// endpoint is reachable and every page is empty
+static void stand_in_helper(Settings settings, http::Headers,
+                            std::string body,
+                            Callback<Error, SharedPtr<http::Response>> cb,
+                            SharedPtr<Reactor> reactor = Reactor::make(),
+                            SharedPtr<Logger> = Logger::make(),
+                            SharedPtr<http::Response> = nullptr, int = 0) {
+    helper_calls += 1;
+    REQUIRE(settings["http/method"] == "POST");
+    REQUIRE(settings["http/url"] == "https://helper.example.com");
+    nlohmann::json request = nlohmann::json::parse(body);
+    nlohmann::json reply;
+    reply["responses"] = nlohmann::json::array();
+    for (auto &r : request.at("requests")) {
+        nlohmann::json response;
+        response["tcp_connect"] = nlohmann::json::object();
+        for (auto &endpoint : r.at("tcp_connect")) {
+            response["tcp_connect"][endpoint.get<std::string>()] = {
+                {"status", true},
+                {"failure", nullptr},
+            };
+        }
+        response["http_request"] = {
+            {"body_length", 0},
+            {"failure", nullptr},
+            {"headers", nlohmann::json::object()},
+            {"status_code", 200},
+            {"title", ""},
+            {"url", r.at("http_request")},
+        };
+        response["dns"] = {
+            {"addrs", nlohmann::json::array()},
+            {"failure", nullptr},
+        };
+        reply["responses"].push_back(response);
+    }
+    SharedPtr<http::Response> response{new http::Response};
+    response->status_code = 200;
+    response->body = reply.dump();
+    // Like a real request, do not call back immediately
+    reactor->call_soon([=]() { cb(NoError(), response); });
+}
+
+static void garbage_helper(Settings, http::Headers, std::string,
+                           Callback<Error, SharedPtr<http::Response>> cb,
+                           SharedPtr<Reactor> reactor = Reactor::make(),
+                           SharedPtr<Logger> = Logger::make(),
+                           SharedPtr<http::Response> = nullptr, int = 0) {
+    SharedPtr<http::Response> response{new http::Response};
+    response->body = "{\"responses\": []}";
+    reactor->call_soon([=]() { cb(NoError(), response); });
+}
+
+static void failing_helper(Settings, http::Headers, std::string,
+                           Callback<Error, SharedPtr<http::Response>> cb,
+                           SharedPtr<Reactor> reactor = Reactor::make(),
+                           SharedPtr<Logger> = Logger::make(),
+                           SharedPtr<http::Response> = nullptr, int = 0) {
+    reactor->call_soon([=]() { cb(MockedError(), nullptr); });
+}
+
+static nlohmann::json make_request(std::string url) {
+    return {
+        {"http_request", url},
+        {"http_request_headers", nlohmann::json::object()},
+        {"tcp_connect", {"1.1.1.1:80"}},
+    };
+}
+
+template <typename Batcher>
+static std::vector<Error> run_queries(SharedPtr<Reactor> reactor,
+                                      SharedPtr<Batcher> batcher,
+                                      size_t count) {
+    std::vector<Error> errors;
+    reactor->run_with_initial_event([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            std::string url = "http://www.example.com/" + std::to_string(i);
+            batcher->query(make_request(url),
+                           [&, url](Error err, nlohmann::json response) {
+                               if (!err) {
+                                   REQUIRE(response.at("http_request")
+                                                   .at("url") == url);
+                               }
+                               errors.push_back(err);
+                           });
+        }
+    });
+    return errors;
+}
+
+TEST_CASE("ControlBatcher works as expected") {
+    auto reactor = Reactor::make();
+    Settings settings{{"backend", "https://helper.example.com"}};
+    helper_calls = 0;
+
+    SECTION("Requests are sent in batches of the given size") {
+        auto batcher = ooni::ControlBatcherImpl<stand_in_helper>::make(
+            4, 10.0, settings, reactor, Logger::make());
+        auto errors = run_queries(reactor, batcher, 8);
+        REQUIRE(errors == std::vector<Error>(8, NoError()));
+        REQUIRE(helper_calls == 2);
+    }
+
+    SECTION("A partial batch is sent after the delay") {
+        auto batcher = ooni::ControlBatcherImpl<stand_in_helper>::make(
+            4, 0.1, settings, reactor, Logger::make());
+        auto errors = run_queries(reactor, batcher, 6);
+        REQUIRE(errors == std::vector<Error>(6, NoError()));
+        REQUIRE(helper_calls == 2);
+    }
+
+    SECTION("A reply with the wrong number of responses is an error") {
+        auto batcher = ooni::ControlBatcherImpl<garbage_helper>::make(
+            2, 0.1, settings, reactor, Logger::make());
+        auto errors = run_queries(reactor, batcher, 2);
+        REQUIRE(errors == std::vector<Error>(2, JsonProcessingError()));
+    }
+
+    SECTION("Network errors are passed to all the requests of the batch") {
+        auto batcher = ooni::ControlBatcherImpl<failing_helper>::make(
+            2, 0.1, settings, reactor, Logger::make());
+        auto errors = run_queries(reactor, batcher, 3);
+        REQUIRE(errors == std::vector<Error>(3, MockedError()));
+    }
+}
+
+TEST_CASE("web_connectivity uses the control batcher") {
+    auto reactor = Reactor::make();
+    Settings settings{{"backend", "https://helper.example.com"}};
+    helper_calls = 0;
+    auto batcher = ooni::ControlBatcherImpl<stand_in_helper>::make(
+        2, 0.1, settings, reactor, Logger::make());
+    std::vector<SharedPtr<nlohmann::json>> entries;
+    reactor->run_with_initial_event([&]() {
+        // Note: using closed local ports, so we do not need the network
+        for (auto input : {"http://127.0.0.1:1/", "http://127.0.0.1:2/"}) {
+            ooni::web_connectivity(
+                input, settings,
+                [&](SharedPtr<nlohmann::json> entry) {
+                    entries.push_back(entry);
+                },
+                batcher.as<ooni::ControlBatcher>(), reactor, Logger::make());
+        }
+    });
+    REQUIRE(helper_calls == 1);
+    REQUIRE(entries.size() == 2);
+    for (auto entry : entries) {
+        REQUIRE((*entry)["control_failure"] == nullptr);
+        REQUIRE((*entry)["control"]["http_request"]["status_code"] == 200);
+        REQUIRE((*entry)["http_experiment_failure"] != nullptr);
+    }
+}
+
+TEST_CASE("web_connectivity reports invalid batch replies like single ones") {
+    auto reactor = Reactor::make();
+    Settings settings{{"backend", "https://helper.example.com"}};
+    auto batcher = ooni::ControlBatcherImpl<garbage_helper>::make(
+        1, 0.1, settings, reactor, Logger::make());
+    SharedPtr<nlohmann::json> entry;
+    reactor->run_with_initial_event([&]() {
+        ooni::web_connectivity(
+            "http://127.0.0.1:1/", settings,
+            [&](SharedPtr<nlohmann::json> e) { entry = e; },
+            batcher.as<ooni::ControlBatcher>(), reactor, Logger::make());
+    });
+    REQUIRE(!!entry);
+    REQUIRE((*entry)["control_failure"] == "json_parse_error");
+}
@@ -6,6 +6,7 @@
 
 #include "include/private/catch.hpp"
 
+#include "src/libmeasurement_kit/common/json_writer.hpp"
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/ooni/templates.hpp"
 #include "src/libmeasurement_kit/ooni/templates_impl.hpp"
@@ -139,6 +140,73 @@ TEST_CASE("tcp connect returns error if port is invalid") {
     });
 }
 
+static std::map<templates::TcpEndpoint, int> tcp_connect_calls;
+
+static void tcp_connect_count(Settings options,
+                              Callback<Error, SharedPtr<net::Transport>> cb,
+                              SharedPtr<Reactor> reactor,
+                              SharedPtr<Logger> logger) {
+    templates::TcpEndpoint endpoint{options["host"],
+                                    options["port"].as<int>()};
+    tcp_connect_calls[endpoint] += 1;
+    // Even ports fail, so we can tell that results are not mixed up
+    Error error = (endpoint.second % 2 == 0) ? Error{ValueError()}
+                                              : Error{NoError()};
+    reactor->call_soon([=]() {
+        cb(error, SharedPtr<net::Transport>{
+                          std::make_shared<net::Emitter>(reactor, logger)});
+    });
+}
+
+TEST_CASE("tcp connect many connects once to each distinct endpoint") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    std::map<templates::TcpEndpoint, Error> results;
+    std::vector<templates::TcpEndpoint> endpoints{
+            {"127.0.0.1", 1}, {"127.0.0.1", 2}, {"127.0.0.1", 1},
+            {"127.0.0.1", 3}, {"127.0.0.1", 2}, {"::1", 1}};
+    tcp_connect_calls.clear();
+    reactor->run_with_initial_event([&]() {
+        templates::tcp_connect_many_impl<tcp_connect_count>(
+                endpoints, 2, {},
+                [&](std::map<templates::TcpEndpoint, Error> r) {
+                    results = std::move(r);
+                },
+                reactor, Logger::make());
+    });
+    REQUIRE(tcp_connect_calls.size() == 4);
+    for (auto &p : tcp_connect_calls) {
+        REQUIRE(p.second == 1);
+    }
+    REQUIRE(results.size() == 4);
+    for (auto &endpoint : endpoints) {
+        REQUIRE(results.count(endpoint) == 1);
+        if (endpoint.second % 2 == 0) {
+            REQUIRE(results.at(endpoint) == ValueError());
+        } else {
+            REQUIRE(results.at(endpoint) == NoError());
+        }
+    }
+}
+
+TEST_CASE("tcp connect many reports a missing host") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    std::map<templates::TcpEndpoint, Error> results;
+    // Note: using closed local ports, so we do not need the network
+    std::vector<templates::TcpEndpoint> endpoints{
+            {"127.0.0.1", 1}, {"", 4}, {"", 4}};
+    reactor->run_with_initial_event([&]() {
+        templates::tcp_connect_many(
+                endpoints, 2, {},
+                [&](std::map<templates::TcpEndpoint, Error> r) {
+                    results = std::move(r);
+                },
+                reactor, Logger::make());
+    });
+    REQUIRE(results.size() == 2);
+    REQUIRE(results.at({"127.0.0.1", 1}) != NoError());
+    REQUIRE(results.at({"", 4}) == MissingRequiredHostError());
+}
+
 TEST_CASE("http requests template works as expected") {
     SharedPtr<nlohmann::json> entry(new nlohmann::json);
     SharedPtr<Reactor> reactor = Reactor::make();
@@ -256,3 +324,29 @@ TEST_CASE("Http template scrubs IP addresses") {
         });
     }
 }
+
+TEST_CASE("Http template entries are written by json_dump() like dump()") {
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    Settings settings;
+    settings["real_probe_ip_"] = "1.1.1.1";
+    settings["save_real_probe_ip"] = true;
+    templates::http_request_impl<mocked_request>(
+        entry, settings, {}, "", [](Error error, SharedPtr<http::Response>) {
+            REQUIRE(error == NoError());
+        }, Reactor::make(), Logger::make());
+    std::string serialized = json_dump(*entry);
+    REQUIRE(serialized == entry->dump());
+    nlohmann::json root = nlohmann::json::parse(serialized);
+    nlohmann::json req = root["requests"][0];
+    REQUIRE(req["failure"] == nullptr);
+    REQUIRE(req["request"]["body"] == "");
+    REQUIRE(req["request"].count("headers") == 0);
+    REQUIRE(req["request"]["tor"]["is_tor"] == false);
+    REQUIRE(req["response"]["body"] == "<HTML><BODY>1.1.1.1</BODY></HTML>");
+    REQUIRE(req["response"]["code"] == 200);
+    REQUIRE(req["response"]["headers"] == nlohmann::json({
+        {"Content-Type", "text/html"},
+        {"X-IP-Address", "aaa 1.1.1.1 aaa"},
+    }));
+    REQUIRE(req["response"]["response_line"] == "HTTP/1.1 200 Ok");
+}
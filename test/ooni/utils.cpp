@@ -18,6 +18,14 @@ TEST_CASE("is_private_ipv4_addr works") {
     REQUIRE(ooni::is_private_ipv4_addr("127.0.0.1") == true);
 }
 
+TEST_CASE("is_private_ip_addr works") {
+    REQUIRE(ooni::is_private_ip_addr("192.168.1.1") == true);
+    REQUIRE(ooni::is_private_ip_addr("::1") == true);
+    REQUIRE(ooni::is_private_ip_addr("fd00::1") == true);
+    REQUIRE(ooni::is_private_ip_addr("8.8.8.8") == false);
+    REQUIRE(ooni::is_private_ip_addr("2001:4860:4860::8888") == false);
+}
+
 TEST_CASE("extract_html_title works") {
     SECTION("For a simple string") {
         std::string body = "<html>\n"
@@ -44,6 +52,16 @@ TEST_CASE("extract_html_title works") {
     }
 }
 
+TEST_CASE("scrub works") {
+    REQUIRE(ooni::scrub("1.2.3.4", "1.2.3.4") == "[REDACTED]");
+    REQUIRE(ooni::scrub("a 1.2.3.4 b 1.2.3.4", "1.2.3.4") ==
+            "a [REDACTED] b [REDACTED]");
+    REQUIRE(ooni::scrub("1.2.3.41.2.3.4", "1.2.3.4") ==
+            "[REDACTED][REDACTED]");
+    REQUIRE(ooni::scrub("1.2.3.5", "1.2.3.4") == "1.2.3.5");
+    REQUIRE(ooni::scrub("1.2.3.4", "") == "1.2.3.4");
+}
+
 TEST_CASE("represent_string works") {
     SECTION("For an ASCII body") {
         std::string s = "an ASCII body";
@@ -0,0 +1,280 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "test/bench/timing.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/regexp/regexp.hpp"
+
+#include <functional>
+#include <random>
+#include <regex>
+
+using namespace mk;
+
+// What html_extract_title() used to do, which we use as the reference
+static std::string regex_extract_title(const std::string &input) {
+    std::smatch match;
+    std::regex re{R"(<title>([^<]{1,128})<\/title>)", std::regex::icase};
+    if (std::regex_search(input, match, re) == false) {
+        return "";
+    }
+    return (match.size() >= 2) ? match[1] : std::string{};
+}
+
+TEST_CASE("html_extract_title works") {
+    SECTION("For simple pages") {
+        REQUIRE(regexp::html_extract_title("<title>a</title>") == "a");
+        REQUIRE(regexp::html_extract_title("<TiTlE>a b</tItLe>") == "a b");
+        REQUIRE(regexp::html_extract_title("<title>\nx\n</title>") == "\nx\n");
+        REQUIRE(regexp::html_extract_title("<title></title>") == "");
+        REQUIRE(regexp::html_extract_title("<title>a</titl") == "");
+        REQUIRE(regexp::html_extract_title("<title>a<b></title>") == "");
+        REQUIRE(regexp::html_extract_title("<title ></title>") == "");
+        REQUIRE(regexp::html_extract_title("<title>") == "");
+        REQUIRE(regexp::html_extract_title("") == "");
+    }
+
+    SECTION("When the first candidate is not a title") {
+        REQUIRE(regexp::html_extract_title(
+                        "<title></title><title><title>x</title>") == "x");
+        REQUIRE(regexp::html_extract_title(
+                        "<title>" + std::string(129, 'a') +
+                        "</title><title>y</title>") == "y");
+    }
+
+    SECTION("With titles at the length limit") {
+        std::string t128(128, 'a');
+        REQUIRE(regexp::html_extract_title("<title>" + t128 + "</title>") ==
+                t128);
+        REQUIRE(regexp::html_extract_title("<title>" + t128 + "a</title>") ==
+                "");
+    }
+
+    SECTION("Only within the prefix") {
+        std::string body = std::string(100, ' ') + "<title>x</title>";
+        REQUIRE(regexp::html_extract_title(body, body.size()) == "x");
+        REQUIRE(regexp::html_extract_title(body, body.size() - 1) == "");
+        REQUIRE(regexp::html_extract_title(body, 10) == "");
+    }
+}
+
+TEST_CASE("html_extract_title is equivalent to the regular expression") {
+    // Pages made of fragments that are likely to confuse a scanner
+    std::vector<std::string> fragments{
+            "<title>", "<TITLE>", "<Title>", "</title>", "</TiTlE>", "<",
+            "</",      "<titl",   "</titl",  "title>",   ">",        "a",
+            "bc",      " ",       "\n",      "\xc3\xa8", "<t>",      "</t>",
+            std::string(64, 'x'), std::string(100, 'y')};
+    std::mt19937 rng{17};
+    for (size_t i = 0; i < 20000; ++i) {
+        std::string body;
+        size_t count = rng() % 16;
+        for (size_t j = 0; j < count; ++j) {
+            body += fragments[rng() % fragments.size()];
+        }
+        INFO(body);
+        REQUIRE(regexp::html_extract_title(body) == regex_extract_title(body));
+    }
+}
+
+using bench::seconds_for;
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of html_extract_title against the regular expression",
+          "[.][benchmark]") {
+    // A large page where the title is not at the beginning. Without a
+    // title, the regular expression would scan the whole page.
+    std::string body = "<html><head>";
+    body += "<script>" + random_printable(1 << 21) + "</script>";
+    body += "<title>A large page</title></head><body>";
+    body += random_printable(1 << 21);
+    body += "</body></html>";
+
+    std::string regex_title, title, bounded_title;
+    double regex_time = seconds_for(
+            [&]() { regex_title = regex_extract_title(body); });
+    double scan_time = seconds_for([&]() {
+        title = regexp::html_extract_title(body, body.size());
+    });
+    double bounded_time = seconds_for([&]() {
+        bounded_title = regexp::html_extract_title(body, 1 << 16);
+    });
+
+    // Note: random_printable() may emit `<`, but never a whole title
+    REQUIRE(title == "A large page");
+    REQUIRE(title == regex_title);
+    REQUIRE(bounded_title == "");
+    std::string size = " (" + std::to_string(body.size() >> 20) + " MiB)";
+    bench::report_speedup("html_extract_title" + size, regex_time, scan_time);
+    bench::report_speedup("html_extract_title bounded to 64 KiB" + size,
+                          regex_time, bounded_time);
+}
+
+// Randomly mutates the valid `samples` and checks that `func` agrees with
+// the regular expression `pattern` that it used to be implemented with
+static void check_equivalence(std::function<bool(const std::string &)> func,
+                              const char *pattern,
+                              std::vector<std::string> samples) {
+    static const std::string charset = "ASasv09.-_+: \n${}";
+    std::regex re{pattern};
+    std::mt19937 rng{17};
+    for (size_t i = 0; i < 5000; ++i) {
+        std::string s = samples[rng() % samples.size()];
+        size_t mutations = rng() % 4;
+        for (size_t j = 0; j < mutations; ++j) {
+            size_t pos = (s.empty()) ? 0 : rng() % s.size();
+            char c = charset[rng() % charset.size()];
+            switch (rng() % 3) {
+            case 0:
+                s.insert(pos, 1, c);
+                break;
+            case 1:
+                if (!s.empty()) {
+                    s.erase(pos, 1);
+                }
+                break;
+            default:
+                if (!s.empty()) {
+                    s[pos] = c;
+                }
+                break;
+            }
+        }
+        INFO(s);
+        REQUIRE(func(s) == std::regex_match(s, re));
+    }
+}
+
+TEST_CASE("The validators are equivalent to the regular expressions") {
+    check_equivalence(regexp::valid_country_code, R"(^[A-Z]{2}$)",
+                      {"IT", "US", "", "A"});
+    check_equivalence(regexp::valid_airport_iata_code, R"(^[a-z]{3}$)",
+                      {"trn", "mxp", "", "ab"});
+    check_equivalence(regexp::lowercase_letters_only, R"(^[a-z]+$)",
+                      {"ndt", "neubot", "", "a"});
+    check_equivalence(regexp::valid_nettest_name, R"(^[A-Za-z0-9._-]+$)",
+                      {"web_connectivity", "measurement_kit", "a.b-c", ""});
+    check_equivalence(
+            regexp::valid_nettest_version,
+            R"(^v?[0-9]{1,8}\.[0-9]{1,8}\.[0-9]{1,8}[a-z0-9-+.]{0,32}$)",
+            {"0.1.0", "v0.10.0-alpha.1", "1.2.123456789", "0.2.0-dev"});
+    check_equivalence(regexp::valid_probe_asn, R"(^AS[0-9]+$)",
+                      {"AS30722", "AS0", "AS", "A"});
+    check_equivalence(
+            regexp::valid_test_start_time,
+            R"(^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}$)",
+            {"2018-01-01 12:00:00", "1970-12-31 00:59:59"});
+}
+
+TEST_CASE("replace_probe_cc works") {
+    REQUIRE(regexp::replace_probe_cc("x/${probe_cc}.txt", "IT") == "x/IT.txt");
+    REQUIRE(regexp::replace_probe_cc("${probe_cc}${probe_cc}", "IT") ==
+            "ITIT");
+    REQUIRE(regexp::replace_probe_cc("${probe_cc}", "${probe_cc}") ==
+            "${probe_cc}");
+    REQUIRE(regexp::replace_probe_cc("${probe_cc", "IT") == "${probe_cc");
+}
+
+// What private_ipv4() used to do
+static const char *private_ipv4_pattern =
+        R"(^(?:(?:127\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:192\.168\.[0-9]{1,3}\.[0-9]{1,3})|(?:10\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.1[6-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.2[0-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.3[0-1]\.[0-9]{1,3}\.[0-9]{1,3})|localhost)$)";
+
+static const std::regex &private_ipv4_regex() {
+    static const std::regex re{private_ipv4_pattern};
+    return re;
+}
+
+static std::vector<std::string> random_ipv4_addrs(size_t count) {
+    // Bias the first octets towards the private ranges
+    static const std::vector<std::string> prefixes{
+            "10.", "127.", "172.15.", "172.16.", "172.31.", "172.32.",
+            "192.168.", "192.169.", "8.", "1."};
+    std::mt19937 rng{17};
+    std::vector<std::string> addrs;
+    for (size_t i = 0; i < count; ++i) {
+        std::string addr = prefixes[rng() % prefixes.size()];
+        while (std::count(addr.begin(), addr.end(), '.') < 3) {
+            addr += std::to_string(rng() % 256) + ".";
+        }
+        addr += std::to_string(rng() % 256);
+        addrs.push_back(addr);
+    }
+    return addrs;
+}
+
+TEST_CASE("private_ipv4 works") {
+    SECTION("It is equivalent to the regular expression for valid addrs") {
+        for (auto &addr : random_ipv4_addrs(10000)) {
+            INFO(addr);
+            REQUIRE(regexp::private_ipv4(addr) ==
+                    std::regex_match(addr, private_ipv4_regex()));
+        }
+        REQUIRE(regexp::private_ipv4("localhost") == true);
+    }
+
+    SECTION("It rejects what is not an IPv4 address") {
+        for (auto s : {"", "10", "10.0.0", "10.0.0.0.", "10.0.0.256",
+                       "10.00.0.1", "10.0.0.1234", "10.0.0.a", " 10.0.0.1",
+                       "127.0.0.1\n", "localhost.", "::1"}) {
+            INFO(s);
+            REQUIRE(regexp::private_ipv4(s) == false);
+        }
+    }
+}
+
+TEST_CASE("private_ipv6 works") {
+    for (auto s : {"::1", "fc00::1", "fdff:ffff::1", "fe80::1", "febf::1",
+                   "::ffff:127.0.0.1", "::ffff:192.168.1.1"}) {
+        INFO(s);
+        REQUIRE(regexp::private_ipv6(s) == true);
+    }
+    for (auto s : {"", "::", "::2", "fe00::1", "fec0::1", "2001:db8::1",
+                   "::ffff:8.8.8.8", "127.0.0.1", "localhost"}) {
+        INFO(s);
+        REQUIRE(regexp::private_ipv6(s) == false);
+    }
+}
+
+// Run with `make bench`, which runs the hidden test cases
+TEST_CASE("Benchmark of the validators against the regular expressions",
+          "[.][benchmark]") {
+    auto addrs = random_ipv4_addrs(1000);
+    size_t regex_count = 0, count = 0;
+    double regex_time = seconds_for([&]() {
+        // Like the old code, which compiled the regex on each call
+        for (auto &addr : addrs) {
+            regex_count += std::regex_match(
+                    addr, std::regex{private_ipv4_pattern});
+        }
+    });
+    double time = seconds_for([&]() {
+        for (auto &addr : addrs) {
+            count += regexp::private_ipv4(addr);
+        }
+    });
+    REQUIRE(count == regex_count);
+    bench::report_speedup("private_ipv4 x " + std::to_string(addrs.size()),
+                          regex_time, time);
+
+    std::string ts = "2018-01-01 12:00:00";
+    double ts_regex_time = seconds_for([&]() {
+        for (size_t i = 0; i < 2000; ++i) {
+            REQUIRE(std::regex_match(
+                    ts, std::regex{R"(^[0-9]{4}-[0-9]{2}-[0-9]{2} )"
+                                   R"([0-9]{2}:[0-9]{2}:[0-9]{2}$)"}));
+        }
+    });
+    double ts_time = seconds_for([&]() {
+        for (size_t i = 0; i < 2000; ++i) {
+            REQUIRE(regexp::valid_test_start_time(ts));
+        }
+    });
+    bench::report_speedup("valid_test_start_time x 2000", ts_regex_time,
+                          ts_time);
+}
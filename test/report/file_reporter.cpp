@@ -10,6 +10,8 @@
 
 #include "src/libmeasurement_kit/report/file_reporter.hpp"
 
+#include <fstream>
+
 using namespace mk::report;
 using namespace mk;
 
@@ -80,3 +82,33 @@ TEST_CASE(
             }, Logger::make());
         });
     }
+
+TEST_CASE("The report is written on close if we don't flush every entry") {
+    ReportLegacy report;
+    report.options["report_flush_every"] = 0;
+    mk::utc_time_now(&report.test_start_time);
+    std::string filename("example_test_report.njson");
+    report.add_reporter(FileReporter::make(filename));
+    auto count_lines = [&]() {
+        std::ifstream infile(filename);
+        int count = 0;
+        for (std::string line; getline(infile, line);) {
+            ++count;
+        }
+        return count;
+    };
+    report.open([&](Error err) {
+        REQUIRE(!err);
+        for (int i = 0; i < 3; ++i) {
+            nlohmann::json entry{{"idx", i}};
+            report.write_entry(entry, [&](Error err) {
+                REQUIRE(!err);
+            }, Logger::make());
+        }
+        REQUIRE(count_lines() == 0);
+        report.close([&](Error err) {
+            REQUIRE(!err);
+            REQUIRE(count_lines() == 3);
+        });
+    });
+}
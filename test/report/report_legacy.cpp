@@ -11,6 +11,8 @@
 #include "src/libmeasurement_kit/report/error.hpp"
 #include "src/libmeasurement_kit/report/report_legacy.hpp"
 
+#include <deque>
+
 using namespace mk;
 using namespace mk::report;
 
@@ -29,9 +31,10 @@ class CountedReporter : public BaseReporter {
         });
     }
 
-    Continuation<Error> write_entry(nlohmann::json e) override {
+    Continuation<Error> write_entry(SerializedEntry e) override {
         return do_write_entry_(e, [=](Callback<Error> cb) {
             ++write_count;
+            last_entry = e;
             return cb(NoError());
         });
     }
@@ -46,6 +49,7 @@ class CountedReporter : public BaseReporter {
     int close_count = 0;
     int open_count = 0;
     int write_count = 0;
+    SerializedEntry last_entry;
 };
 
 CountedReporter::~CountedReporter() {}
@@ -68,7 +72,7 @@ class FailingReporter : public BaseReporter {
         });
     }
 
-    Continuation<Error> write_entry(nlohmann::json e) override {
+    Continuation<Error> write_entry(SerializedEntry e) override {
         return do_write_entry_(e, [=](Callback<Error> cb) {
             if (write_count++ == 0) {
                 cb(MockedError());
@@ -95,6 +99,33 @@ class FailingReporter : public BaseReporter {
 
 FailingReporter::~FailingReporter() {}
 
+class SlowReporter : public BaseReporter {
+  public:
+    static SharedPtr<SlowReporter> make() {
+        return SharedPtr<SlowReporter>(new SlowReporter);
+    }
+
+    ~SlowReporter() override;
+
+    Continuation<Error> write_entry(SerializedEntry e) override {
+        return do_write_entry_(e, [=](Callback<Error> cb) {
+            pending.push_back(cb);
+        });
+    }
+
+    // Completes the oldest pending write
+    void complete_one() {
+        REQUIRE(pending.size() > 0);
+        auto cb = pending.front();
+        pending.pop_front();
+        cb(NoError());
+    }
+
+    std::deque<Callback<Error>> pending;
+};
+
+SlowReporter::~SlowReporter() {}
+
 TEST_CASE("The constructor works correctly") {
     REQUIRE_NOTHROW(ReportLegacy());
 }
@@ -220,6 +251,136 @@ TEST_CASE("We can retry a partially successful write_entry()") {
     REQUIRE(failing_reporter->write_count == 2);
 }
 
+TEST_CASE("write_entry() tells us whether the entry has been spooled") {
+    class SpoolingReporter : public CountedReporter {
+      public:
+        Continuation<Error> write_entry(SerializedEntry e) override {
+            return do_write_entry_(e, [=](Callback<Error> cb) {
+                cb(NoError(EntrySpooledError()));
+            });
+        }
+    };
+    SharedPtr<CountedReporter> counted_reporter = CountedReporter::make();
+    ReportLegacy report;
+    report.add_reporter(counted_reporter.as<BaseReporter>());
+    nlohmann::json entry;
+    entry["foobar"] = 17;
+
+    SECTION("When no reporter spools the entry") {
+        report.open([&](Error err) {
+            REQUIRE(err == NoError());
+            report.write_entry(entry, [&](Error err) {
+                REQUIRE(err == NoError());
+                REQUIRE(!is_entry_spooled(err));
+            }, Logger::make());
+        });
+    }
+
+    SECTION("When a reporter spools the entry") {
+        report.add_reporter(SharedPtr<BaseReporter>{new SpoolingReporter});
+        report.open([&](Error err) {
+            REQUIRE(err == NoError());
+            report.write_entry(entry, [&](Error err) {
+                REQUIRE(err == NoError());
+                REQUIRE(err.child_errors.size() == 2);
+                REQUIRE(err.child_errors[1].child_errors.size() == 1);
+                REQUIRE(err.child_errors[1].child_errors[0] ==
+                        EntrySpooledError());
+                REQUIRE(is_entry_spooled(err));
+            }, Logger::make());
+        });
+    }
+}
+
+TEST_CASE("The enqueue_entry() method works correctly") {
+    SharedPtr<SlowReporter> reporter = SlowReporter::make();
+    ReportLegacy report;
+    report.add_reporter(reporter.as<BaseReporter>());
+    report.max_queued_entries = 2;
+    report.max_writing_entries = 1;
+    int queued = 0;
+    int written = 0;
+    bool drained = false;
+    report.open([&](Error err) { REQUIRE(!err); });
+    for (int i = 0; i < 4; ++i) {
+        nlohmann::json entry{{"idx", i}};
+        report.enqueue_entry(entry, [&]() { ++queued; }, [&](Error err) {
+            REQUIRE(!err);
+            ++written;
+        }, Logger::make());
+    }
+    // One entry is being written and two wait in the queue, hence the
+    // fourth entry must wait for some room in the queue
+    REQUIRE(queued == 3);
+    REQUIRE(written == 0);
+    REQUIRE(reporter->pending.size() == 1);
+    report.drain([&]() { drained = true; });
+    reporter->complete_one();
+    REQUIRE(queued == 4);
+    REQUIRE(written == 1);
+    REQUIRE(reporter->pending.size() == 1);
+    reporter->complete_one();
+    reporter->complete_one();
+    REQUIRE(!drained);
+    reporter->complete_one();
+    REQUIRE(written == 4);
+    REQUIRE(drained);
+    report.close([&](Error err) { REQUIRE(!err); });
+}
+
+TEST_CASE("enqueue_entry() writes in parallel when asked to do so") {
+    SharedPtr<SlowReporter> reporter = SlowReporter::make();
+    ReportLegacy report;
+    report.add_reporter(reporter.as<BaseReporter>());
+    report.max_queued_entries = 1;
+    report.max_writing_entries = 3;
+    int queued = 0;
+    report.open([&](Error err) { REQUIRE(!err); });
+    for (int i = 0; i < 5; ++i) {
+        nlohmann::json entry{{"idx", i}};
+        report.enqueue_entry(entry, [&]() { ++queued; },
+                             [&](Error err) { REQUIRE(!err); },
+                             Logger::make());
+    }
+    REQUIRE(reporter->pending.size() == 3);
+    REQUIRE(queued == 4);
+}
+
+TEST_CASE("enqueue_entry() without queue works like write_entry()") {
+    SharedPtr<SlowReporter> reporter = SlowReporter::make();
+    ReportLegacy report;
+    report.add_reporter(reporter.as<BaseReporter>());
+    std::vector<std::string> events;
+    report.open([&](Error err) { REQUIRE(!err); });
+    report.enqueue_entry(nlohmann::json::object(),
+                         [&]() { events.push_back("queued"); },
+                         [&](Error err) {
+                             REQUIRE(!err);
+                             events.push_back("written");
+                         }, Logger::make());
+    REQUIRE(events.size() == 0);
+    reporter->complete_one();
+    REQUIRE((events == std::vector<std::string>{"written", "queued"}));
+}
+
+TEST_CASE("close() waits for the queue to drain") {
+    SharedPtr<SlowReporter> reporter = SlowReporter::make();
+    ReportLegacy report;
+    report.add_reporter(reporter.as<BaseReporter>());
+    report.max_queued_entries = 4;
+    bool closed = false;
+    report.open([&](Error err) { REQUIRE(!err); });
+    report.enqueue_entry(nlohmann::json::object(), []() {},
+                         [](Error err) { REQUIRE(!err); }, Logger::make());
+    report.close([&](Error err) {
+        REQUIRE(!err);
+        closed = true;
+    });
+    REQUIRE(!closed);
+    reporter->complete_one();
+    REQUIRE(closed);
+}
+
 TEST_CASE("The close() method works correctly") {
     ReportLegacy report;
     report.add_reporter(BaseReporter::make());
@@ -290,3 +451,21 @@ TEST_CASE("We can override software name and version") {
         REQUIRE(entry["software_version"] == "1.0.1");
     }
 }
+
+TEST_CASE("All reporters share the same serialized entry") {
+    SharedPtr<CountedReporter> first = CountedReporter::make();
+    SharedPtr<CountedReporter> second = CountedReporter::make();
+    ReportLegacy report;
+    report.add_reporter(first.as<BaseReporter>());
+    report.add_reporter(second.as<BaseReporter>());
+    report.open([&](Error err) {
+        REQUIRE(!err);
+        report.write_entry(nlohmann::json{{"input", "foo"}}, [&](Error err) {
+            REQUIRE(!err);
+        }, Logger::make());
+    });
+    REQUIRE(first->write_count == 1);
+    REQUIRE(second->write_count == 1);
+    REQUIRE(first->last_entry.get() == second->last_entry.get());
+    REQUIRE(*first->last_entry == R"({"input":"foo"})");
+}